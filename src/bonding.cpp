@@ -0,0 +1,317 @@
+#include "bonding.h"
+
+#include <QFile>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// REJECT_AFTER_TIME: a session without a handshake for this long is dead.
+constexpr qint64 kHandshakeTimeoutSecs = 180;
+// Polls with outgoing but no incoming traffic before a member is dropped.
+constexpr int    kStalledPollLimit     = 3;
+// Floor for the capacity estimate so idle members still get some buckets.
+constexpr double kMinCapacity          = 125000.0; // 1 Mbit/s
+// Weights closer than this to the applied ones are not worth moving flows.
+constexpr double kWeightHysteresis     = 0.15;
+
+quint64 splitmix64(quint64 x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+quint64 fnv1a(const QString &s)
+{
+    quint64 h = 0xCBF29CE484222325ull;
+    for (QChar c : s) {
+        h ^= c.unicode();
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+QString shellQuote(const QString &s)
+{
+    QString out = s;
+    out.replace('\'', "'\\''");
+    return '\'' + out + '\'';
+}
+
+} // namespace
+
+BondPlanner::BondPlanner(const QString &name, const QList<BondMember> &members)
+    : m_name(name)
+    , m_members(members)
+    , m_buckets(kBuckets, -1)
+{
+    for (int i = 0; i < m_members.size(); ++i)
+        m_members[i].mark = kFirstMark + quint32(i);
+
+    QVector<double> weights(m_members.size(), 1.0);
+    assignBuckets(weights);
+}
+
+QStringList BondPlanner::interfaces() const
+{
+    QStringList out;
+    for (const BondMember &m : m_members)
+        out << m.tunnel;
+    return out;
+}
+
+int BondPlanner::memberIndex(const QString &tunnel) const
+{
+    for (int i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].tunnel == tunnel)
+            return i;
+    }
+    return -1;
+}
+
+bool BondPlanner::updateSample(const QString &tunnel, quint64 rx, quint64 tx,
+                               qint64 latestHandshake, qint64 nowMs)
+{
+    const int idx = memberIndex(tunnel);
+    if (idx < 0)
+        return false;
+    BondMember &m = m_members[idx];
+
+    if (m.lastSampleMs > 0 && nowMs > m.lastSampleMs) {
+        const double dt = (nowMs - m.lastSampleMs) / 1000.0;
+        const quint64 drx = rx >= m.lastRx ? rx - m.lastRx : 0;
+        const quint64 dtx = tx >= m.lastTx ? tx - m.lastTx : 0;
+        const double rate = (drx + dtx) / dt;
+        m.rate = m.rate == 0 ? rate : 0.7 * m.rate + 0.3 * rate;
+        // Flows are spread evenly over buckets, so rate / share does not
+        // depend on how many buckets the member was given until it saturates.
+        if (m.share > 0)
+            m.capacity = std::max(m.rate / m.share, m.capacity * 0.98);
+
+        if (dtx > 0 && drx == 0)
+            ++m.stalledPolls;
+        else if (drx > 0)
+            m.stalledPolls = 0;
+    }
+    m.lastRx = rx;
+    m.lastTx = tx;
+    m.lastSampleMs = nowMs;
+    if (m.firstSampleMs == 0)
+        m.firstSampleMs = nowMs;
+    m.latestHandshake = latestHandshake;
+
+    // Never handshaken counts as old as the member once the grace is over.
+    const qint64 handshakeAge = latestHandshake > 0
+        ? nowMs / 1000 - latestHandshake
+        : ((nowMs - m.firstSampleMs) / 1000 < kHandshakeGraceSecs ? 0 : kHandshakeTimeoutSecs);
+    const bool healthy = m.stalledPolls < kStalledPollLimit
+                      && handshakeAge < kHandshakeTimeoutSecs
+                      && m.loss < 0.5;
+    const bool flipped = healthy != m.healthy;
+    m.healthy = healthy;
+    return flipped;
+}
+
+void BondPlanner::setRtt(const QString &tunnel, double rttMs)
+{
+    const int idx = memberIndex(tunnel);
+    if (idx >= 0)
+        m_members[idx].rttMs = rttMs;
+}
+
+void BondPlanner::setLoss(const QString &tunnel, double loss)
+{
+    const int idx = memberIndex(tunnel);
+    if (idx >= 0)
+        m_members[idx].loss = loss;
+}
+
+bool BondPlanner::rebalance()
+{
+    double minRtt = std::numeric_limits<double>::max();
+    bool anyHealthy = false;
+    for (const BondMember &m : m_members) {
+        if (m.healthy) {
+            anyHealthy = true;
+            if (m.rttMs > 0)
+                minRtt = std::min(minRtt, m.rttMs);
+        }
+    }
+
+    QVector<double> target(m_members.size(), 0.0);
+    bool changed = false;
+    for (int i = 0; i < m_members.size(); ++i) {
+        BondMember &m = m_members[i];
+        // With every member failing, keep spreading rather than black-holing.
+        if (!m.healthy && anyHealthy) {
+            changed |= m.weight != 0;
+            m.weight = 0;
+            continue;
+        }
+        double w = std::max(m.capacity, kMinCapacity);
+        if (m.rttMs > 0 && minRtt < std::numeric_limits<double>::max())
+            w *= minRtt / m.rttMs;
+        if (m.weight <= 0 || std::abs(w - m.weight) / m.weight > kWeightHysteresis) {
+            m.weight = w;
+            changed = true;
+        }
+    }
+    if (!changed)
+        return false;
+
+    for (int i = 0; i < m_members.size(); ++i)
+        target[i] = m_members[i].weight;
+    const QVector<int> before = m_buckets;
+    assignBuckets(target);
+    return m_buckets != before;
+}
+
+void BondPlanner::assignBuckets(const QVector<double> &weights)
+{
+    // Weighted rendezvous hashing: score = -w / ln(u), u uniform in (0, 1).
+    for (int b = 0; b < kBuckets; ++b) {
+        int best = -1;
+        double bestScore = -1;
+        for (int i = 0; i < m_members.size(); ++i) {
+            if (weights[i] <= 0)
+                continue;
+            const quint64 h = splitmix64(fnv1a(m_members[i].tunnel) ^ quint64(b));
+            const double u = (double(h >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+            const double score = -weights[i] / std::log(u);
+            if (score > bestScore) {
+                bestScore = score;
+                best = i;
+            }
+        }
+        m_buckets[b] = best;
+    }
+    for (BondMember &m : m_members)
+        m.share = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        if (m_buckets[b] >= 0)
+            m_members[m_buckets[b]].share += 1.0 / kBuckets;
+    }
+}
+
+QString BondPlanner::nftRuleset() const
+{
+    QStringList bucketMap, liveMarks, outIfs;
+    for (int b = 0; b < kBuckets; ++b) {
+        if (m_buckets[b] >= 0)
+            bucketMap << QString("%1 : %2").arg(b).arg(m_members[m_buckets[b]].mark);
+    }
+    for (int i = 0; i < m_members.size(); ++i) {
+        outIfs << '"' + m_members[i].tunnel + '"';
+        if (m_members[i].weight > 0)
+            liveMarks << QString::number(m_members[i].mark);
+    }
+
+    QString out;
+    out += QString("# DKT VPN bond \"%1\" — generated, do not edit\n").arg(m_name);
+    out += QString("add table inet %1\ndelete table inet %1\n").arg(kNftTable);
+    out += QString("table inet %1 {\n").arg(kNftTable);
+    out += "    chain output {\n"
+           "        type route hook output priority mangle; policy accept;\n";
+    out += QString("        meta mark %1 return\n").arg(kWireGuardMark);
+    out += "        fib daddr type local return\n";
+    if (!liveMarks.isEmpty())
+        out += "        ct mark { " + liveMarks.join(", ") + " } meta mark set ct mark return\n";
+    if (!bucketMap.isEmpty()) {
+        out += QString("        meta mark set symhash mod %1 map { ").arg(kBuckets)
+             + bucketMap.join(", ") + " }\n";
+        out += "        ct mark set meta mark\n";
+    }
+    out += "    }\n"
+           "    chain postrouting {\n"
+           "        type nat hook postrouting priority srcnat; policy accept;\n"
+           "        oifname { " + outIfs.join(", ") + " } masquerade\n"
+           "    }\n"
+           "}\n";
+    return out;
+}
+
+QString BondPlanner::upScript(const QString &wgQuick) const
+{
+    QString s;
+    s += QString("# DKT VPN bond \"%1\"\n").arg(m_name);
+    s += "set -e\n";
+    s += "bond_down() (\nset +e\n" + downScript(wgQuick) + ")\n";
+    s += "trap 'rc=$?; if [ $rc -ne 0 ]; then bond_down >/dev/null 2>&1; fi; exit $rc' EXIT\n";
+    s += "sysctl -q net.ipv4.conf.all.src_valid_mark=1\n";
+    // Ahead of the member rules, so LAN and other specific routes in main
+    // keep winning over the bond's defaults; main's own default is skipped.
+    s += QString("ip -4 rule add table main suppress_prefixlength 0 priority %1\n").arg(kRulePriority);
+    s += QString("ip -6 rule add table main suppress_prefixlength 0 priority %1 2>/dev/null || true\n")
+             .arg(kRulePriority);
+    for (int i = 0; i < m_members.size(); ++i) {
+        const BondMember &m = m_members[i];
+        const quint32 priority = kRulePriority + 1 + quint32(i);
+        s += shellQuote(wgQuick) + " up " + shellQuote(m.configFile) + '\n';
+        s += QString("ip -4 route replace default dev %1 table %2\n").arg(m.tunnel).arg(m.mark);
+        s += QString("ip -6 route replace default dev %1 table %2 2>/dev/null || true\n")
+                 .arg(m.tunnel).arg(m.mark);
+        s += QString("ip -4 rule add fwmark %1 table %1 priority %2\n").arg(m.mark).arg(priority);
+        s += QString("ip -6 rule add fwmark %1 table %1 priority %2 2>/dev/null || true\n")
+                 .arg(m.mark).arg(priority);
+    }
+    s += "nft -f /dev/stdin <<'DKT_NFT'\n" + nftRuleset() + "DKT_NFT\n";
+    return s;
+}
+
+QString BondPlanner::downScript(const QString &wgQuick) const
+{
+    QString s;
+    s += QString("# DKT VPN bond \"%1\"\n").arg(m_name);
+    s += QString("nft delete table inet %1 2>/dev/null\n").arg(kNftTable);
+    s += QString("ip -4 rule del table main suppress_prefixlength 0 priority %1 2>/dev/null\n")
+             .arg(kRulePriority);
+    s += QString("ip -6 rule del table main suppress_prefixlength 0 priority %1 2>/dev/null\n")
+             .arg(kRulePriority);
+    s += "rc=0\n";
+    for (int i = 0; i < m_members.size(); ++i) {
+        const BondMember &m = m_members[i];
+        const quint32 priority = kRulePriority + 1 + quint32(i);
+        s += QString("ip -4 rule del fwmark %1 table %1 priority %2 2>/dev/null\n")
+                 .arg(m.mark).arg(priority);
+        s += QString("ip -6 rule del fwmark %1 table %1 priority %2 2>/dev/null\n")
+                 .arg(m.mark).arg(priority);
+        s += QString("if ip link show dev %1 >/dev/null 2>&1; then ").arg(m.tunnel)
+             + shellQuote(wgQuick) + " down " + shellQuote(m.configFile) + " || rc=1; fi\n";
+    }
+    s += "exit $rc\n";
+    return s;
+}
+
+QList<VpnServer> BondPlanner::loadDefinitions(const QString &path)
+{
+    QList<VpnServer> out;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return out;
+
+    while (!f.atEnd()) {
+        QString line = QString::fromUtf8(f.readLine());
+        const int hash = line.indexOf('#');
+        if (hash >= 0)
+            line.truncate(hash);
+        const int eq = line.indexOf('=');
+        if (eq <= 0)
+            continue;
+
+        VpnServer bond;
+        bond.country = line.left(eq).trimmed();
+        for (const QString &member : line.mid(eq + 1).split(',', Qt::SkipEmptyParts)) {
+            if (!member.trimmed().isEmpty())
+                bond.bondMembers << member.trimmed();
+        }
+        if (bond.country.isEmpty() || bond.bondMembers.size() < 2)
+            continue;
+        bond.code       = "bond";
+        bond.flag       = QString::fromUtf8("⛓");
+        bond.configName = "bond-" + bond.country.toLower().replace(' ', '-');
+        out << bond;
+    }
+    return out;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "tunnelconfig.h"
+#include "vpnserver.h"
+
+/// One tunnel taking part in a bond.
+struct BondMember {
+    QString      tunnel;           ///< interface / config name, e.g. "dkt-de"
+    QString      configFile;       ///< generated config handed to wg-quick
+    TunnelConfig config;
+    quint32      mark = 0;         ///< fwmark, also used as routing table id
+
+    bool         healthy = true;
+    double       weight  = 1.0;    ///< weight currently applied to the bucket map
+    double       rate    = 0;      ///< rx+tx bytes/s, smoothed
+    double       share   = 0;      ///< fraction of the buckets mapped to this member
+    double       capacity = 0;     ///< decaying peak of rate / share, bytes/s
+    double       rttMs   = 0;      ///< 0 = not measured
+    double       loss    = 0;      ///< probe loss ratio, 0..1
+
+    quint64      lastRx = 0;
+    quint64      lastTx = 0;
+    qint64       lastSampleMs = 0;
+    qint64       firstSampleMs = 0;
+    qint64       latestHandshake = 0;
+    int          stalledPolls = 0; ///< consecutive polls with tx but no rx
+};
+
+/**
+ * BondPlanner decides how flows are spread over the tunnels of a bond.
+ *
+ * Flows are hashed by nftables (symhash) into kBuckets buckets, and every
+ * bucket is assigned to a member by weighted rendezvous hashing. A weight
+ * change therefore only moves the buckets whose winner changes. Once a flow
+ * has picked a tunnel, its conntrack mark pins it there for as long as that
+ * tunnel stays in the live set, so TCP sessions are never reordered.
+ *
+ * Weights follow each member's estimated capacity, scaled down by RTT
+ * relative to the fastest member. The estimate is the member's throughput
+ * divided by its bucket share, i.e. what it would carry with all the flows.
+ * Raw throughput would shrink with every bucket taken away and starve the
+ * member. A member that stops answering, or has not completed a handshake
+ * kHandshakeGraceSecs after bring-up, gets weight 0 and its buckets move
+ * within one rebalance.
+ */
+class BondPlanner
+{
+public:
+    static constexpr int     kBuckets       = 256;
+    static constexpr quint32 kFirstMark     = 52001;
+    static constexpr quint32 kWireGuardMark = 51820; ///< FwMark of the members' own UDP packets
+    /// Priority of the suppress rule; member i's fwmark rule follows at
+    /// kRulePriority + 1 + i. All of them must rank ahead of 32766 (main).
+    static constexpr quint32 kRulePriority  = 32000;
+    static constexpr const char *kNftTable  = "dkt_bond";
+    static constexpr qint64  kHandshakeGraceSecs = 20;
+
+    BondPlanner(const QString &name, const QList<BondMember> &members);
+
+    const QString &name() const { return m_name; }
+    const QList<BondMember> &members() const { return m_members; }
+    QStringList interfaces() const;
+
+    /// Feeds one `wg show` sample. Returns true when the member's health flipped.
+    bool updateSample(const QString &tunnel, quint64 rx, quint64 tx,
+                      qint64 latestHandshake, qint64 nowMs);
+    void setRtt(const QString &tunnel, double rttMs);
+    void setLoss(const QString &tunnel, double loss);
+
+    /// Recomputes weights and the bucket map; true if any bucket moved.
+    bool rebalance();
+    const QVector<int> &buckets() const { return m_buckets; }
+
+    /// Shell script bringing every member up and installing the policy
+    /// routing and nftables ruleset; on failure it runs downScript() to roll
+    /// back. Both are self-contained, to be passed to `sh -c` as a whole.
+    QString upScript(const QString &wgQuick) const;
+    QString downScript(const QString &wgQuick) const;
+    /// Complete nftables ruleset for the current bucket map (atomic replace).
+    QString nftRuleset() const;
+
+    /// Parses a bonding.conf: one "Name = member, member, …" per line.
+    static QList<VpnServer> loadDefinitions(const QString &path);
+
+private:
+    int  memberIndex(const QString &tunnel) const;
+    void assignBuckets(const QVector<double> &weights);
+
+    QString           m_name;
+    QList<BondMember> m_members;
+    QVector<int>      m_buckets; ///< bucket → member index
+};
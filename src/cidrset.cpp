@@ -0,0 +1,203 @@
+#include "cidrset.h"
+
+#include <QHostAddress>
+#include <QPair>
+#include <algorithm>
+
+namespace {
+
+inline int bitAt(const std::array<quint8, 16> &addr, int i)
+{
+    return (addr[size_t(i / 8)] >> (7 - i % 8)) & 1;
+}
+
+inline void setBit(std::array<quint8, 16> &addr, int i, int value)
+{
+    const quint8 mask = quint8(1u << (7 - i % 8));
+    if (value)
+        addr[size_t(i / 8)] |= mask;
+    else
+        addr[size_t(i / 8)] &= quint8(~mask);
+}
+
+} // namespace
+
+// ── CidrPrefix ───────────────────────────────────────────────────────────────
+bool CidrPrefix::parse(const QString &text, CidrPrefix *out)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty())
+        return false;
+
+    QPair<QHostAddress, int> subnet;
+    if (trimmed.contains('/')) {
+        subnet = QHostAddress::parseSubnet(trimmed);
+        if (subnet.first.isNull())
+            return false;
+    } else {
+        QHostAddress a(trimmed);
+        if (a.isNull())
+            return false;
+        subnet = { a, a.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32 };
+    }
+
+    CidrPrefix p;
+    if (subnet.first.protocol() == QAbstractSocket::IPv4Protocol) {
+        const quint32 v4 = subnet.first.toIPv4Address();
+        p.addr[0] = quint8(v4 >> 24);
+        p.addr[1] = quint8(v4 >> 16);
+        p.addr[2] = quint8(v4 >> 8);
+        p.addr[3] = quint8(v4);
+    } else {
+        p.v6 = true;
+        const Q_IPV6ADDR v6 = subnet.first.toIPv6Address();
+        for (int i = 0; i < 16; ++i)
+            p.addr[size_t(i)] = v6[i];
+    }
+    p.length = subnet.second;
+    if (p.length < 0 || p.length > p.maxLength())
+        return false;
+
+    for (int i = p.length; i < p.maxLength(); ++i)
+        setBit(p.addr, i, 0);
+    *out = p;
+    return true;
+}
+
+CidrPrefix CidrPrefix::host(const QString &address, bool *ok)
+{
+    CidrPrefix p;
+    *ok = !address.contains('/') && parse(address, &p);
+    return p;
+}
+
+QString CidrPrefix::toString() const
+{
+    QHostAddress a;
+    if (v6) {
+        Q_IPV6ADDR raw;
+        for (int i = 0; i < 16; ++i)
+            raw[i] = addr[size_t(i)];
+        a.setAddress(raw);
+    } else {
+        a.setAddress(quint32(addr[0]) << 24 | quint32(addr[1]) << 16
+                     | quint32(addr[2]) << 8 | quint32(addr[3]));
+    }
+    return a.toString() + '/' + QString::number(length);
+}
+
+// ── CidrSet ──────────────────────────────────────────────────────────────────
+CidrSet::CidrSet()
+    : m_v4(1)
+    , m_v6(1)
+{
+}
+
+bool CidrSet::isEmpty() const
+{
+    auto emptyTrie = [](const std::vector<Node> &t) {
+        return t.size() == 1 && t[0].mark == None;
+    };
+    return emptyTrie(m_v4) && emptyTrie(m_v6);
+}
+
+QStringList CidrSet::include(const QStringList &prefixes)
+{
+    QStringList invalid;
+    for (const QString &s : prefixes) {
+        CidrPrefix p;
+        if (CidrPrefix::parse(s, &p))
+            include(p);
+        else
+            invalid << s;
+    }
+    return invalid;
+}
+
+QStringList CidrSet::exclude(const QStringList &prefixes)
+{
+    QStringList invalid;
+    for (const QString &s : prefixes) {
+        CidrPrefix p;
+        if (CidrPrefix::parse(s, &p))
+            exclude(p);
+        else
+            invalid << s;
+    }
+    return invalid;
+}
+
+void CidrSet::insert(const CidrPrefix &prefix, Mark mark)
+{
+    std::vector<Node> &trie = prefix.v6 ? m_v6 : m_v4;
+    int node = 0;
+    for (int i = 0; i < prefix.length; ++i) {
+        const int bit = bitAt(prefix.addr, i);
+        int next = trie[size_t(node)].child[bit];
+        if (next < 0) {
+            next = int(trie.size());
+            trie.push_back(Node());
+            trie[size_t(node)].child[bit] = next;
+        }
+        node = next;
+    }
+    // Exclude wins when the same prefix is both included and excluded.
+    if (trie[size_t(node)].mark != Exclude)
+        trie[size_t(node)].mark = mark;
+}
+
+CidrSet::Coverage CidrSet::collect(const std::vector<Node> &trie, int node, int depth,
+                                   bool inherited, CidrPrefix &path,
+                                   QList<CidrPrefix> &out) const
+{
+    const Node &n = trie[size_t(node)];
+    const bool covered = n.mark == None ? inherited : n.mark == Include;
+
+    if (n.child[0] < 0 && n.child[1] < 0)
+        return covered ? Full : Empty;
+
+    Coverage sides[2];
+    for (int bit = 0; bit < 2; ++bit) {
+        if (n.child[bit] < 0) {
+            sides[bit] = covered ? Full : Empty;
+            continue;
+        }
+        setBit(path.addr, depth, bit);
+        sides[bit] = collect(trie, n.child[bit], depth + 1, covered, path, out);
+        setBit(path.addr, depth, 0);
+    }
+
+    if (sides[0] == sides[1] && sides[0] != Partial)
+        return sides[0];
+
+    // The halves differ: emit the fully covered ones, partial halves have
+    // already emitted their own pieces.
+    for (int bit = 0; bit < 2; ++bit) {
+        if (sides[bit] != Full)
+            continue;
+        CidrPrefix p = path;
+        setBit(p.addr, depth, bit);
+        p.length = depth + 1;
+        out.append(p);
+    }
+    return Partial;
+}
+
+QList<CidrPrefix> CidrSet::aggregate() const
+{
+    QList<CidrPrefix> out;
+    for (bool v6 : { false, true }) {
+        CidrPrefix path;
+        path.v6 = v6;
+        QList<CidrPrefix> family;
+        if (collect(v6 ? m_v6 : m_v4, 0, 0, false, path, family) == Full) {
+            path.length = 0;
+            family.append(path);
+        }
+        std::sort(family.begin(), family.end(), [](const CidrPrefix &a, const CidrPrefix &b) {
+            return a.addr != b.addr ? a.addr < b.addr : a.length < b.length;
+        });
+        out += family;
+    }
+    return out;
+}
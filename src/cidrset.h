@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <array>
+#include <vector>
+
+/// An IPv4 or IPv6 prefix. Bits past @c length are always zero.
+struct CidrPrefix {
+    bool                    v6     = false;
+    std::array<quint8, 16>  addr   {};     ///< network byte order; IPv4 uses the first 4 bytes
+    int                     length = 0;
+
+    /// Parses "a.b.c.d/n", "x::y/n" or a bare address (host prefix).
+    /// Host bits are cleared. Returns false on malformed input.
+    static bool parse(const QString &text, CidrPrefix *out);
+    static CidrPrefix host(const QString &address, bool *ok);
+
+    int maxLength() const { return v6 ? 128 : 32; }
+    QString toString() const;
+
+    bool operator==(const CidrPrefix &o) const
+    {
+        return v6 == o.v6 && length == o.length && addr == o.addr;
+    }
+};
+
+/**
+ * CidrSet computes the minimal list of prefixes that covers exactly the
+ * addresses selected by a set of include / exclude rules.
+ *
+ * Rules are stored in one binary trie per address family. The most specific
+ * rule wins; an exclude wins over an include of the same prefix. aggregate()
+ * walks each trie once, merging sibling subtrees that are completely covered,
+ * so the result is the canonical (and smallest) CIDR decomposition.
+ * Cost is linear in the number of trie nodes, i.e. O(rules × prefix length).
+ */
+class CidrSet
+{
+public:
+    CidrSet();
+
+    void include(const CidrPrefix &prefix) { insert(prefix, Include); }
+    void exclude(const CidrPrefix &prefix) { insert(prefix, Exclude); }
+
+    /// Parses each entry and adds it as a rule; returns the entries that
+    /// could not be parsed.
+    QStringList include(const QStringList &prefixes);
+    QStringList exclude(const QStringList &prefixes);
+
+    /// Minimal prefix list, IPv4 first, each family in address order.
+    QList<CidrPrefix> aggregate() const;
+
+    bool isEmpty() const;
+
+private:
+    enum Mark : qint8 { None = -1, Exclude = 0, Include = 1 };
+
+    struct Node {
+        int  child[2] = { -1, -1 };
+        Mark mark     = None;
+    };
+
+    enum Coverage { Empty, Full, Partial };
+
+    void insert(const CidrPrefix &prefix, Mark mark);
+    Coverage collect(const std::vector<Node> &trie, int node, int depth, bool inherited,
+                     CidrPrefix &path, QList<CidrPrefix> &out) const;
+
+    std::vector<Node> m_v4;
+    std::vector<Node> m_v6;
+};
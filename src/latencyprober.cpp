@@ -0,0 +1,351 @@
+#include "latencyprober.h"
+#include "metrics.h"
+
+#include <QDateTime>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#  include <arpa/inet.h>
+#  include <fcntl.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace {
+
+constexpr char kMagic[4] = { 'D', 'K', 'T', 'P' };
+
+constexpr quint8 kIcmpEchoRequest   = 8;
+constexpr quint8 kIcmpEchoReply     = 0;
+constexpr quint8 kIcmp6EchoRequest  = 128;
+constexpr quint8 kIcmp6EchoReply    = 129;
+constexpr int    kIcmpHeaderSize    = 8;
+
+// Outer UDP/IP headers plus the WireGuard data header and auth tag.
+constexpr int    kTunnelOverhead    = 20 + 8 + 32;
+
+double percentile(QVector<double> values, double q)
+{
+    if (values.isEmpty())
+        return 0;
+    const qsizetype rank = std::min<qsizetype>(values.size() - 1,
+                                               qsizetype(q * double(values.size())));
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+} // namespace
+
+LatencyProber::LatencyProber(const QString &tunnel, TunnelMetrics *metrics, QObject *parent)
+    : QObject(parent)
+    , m_tunnel(tunnel)
+    , m_metrics(metrics)
+{
+    qRegisterMetaType<LatencyQuality>();
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &LatencyProber::sendProbe);
+    m_recent.reserve(kRecentRtts);
+}
+
+LatencyProber::~LatencyProber()
+{
+    stop();
+}
+
+void LatencyProber::setTarget(const QHostAddress &address, quint16 port)
+{
+    m_target = address;
+    m_port   = port;
+}
+
+void LatencyProber::setBudget(int bytesPerSecond)
+{
+    m_budget = bytesPerSecond;
+}
+
+int LatencyProber::minIntervalMs() const
+{
+    const int ipHeader = m_target.protocol() == QAbstractSocket::IPv6Protocol ? 40 : 20;
+    const int probeHeader = m_port ? 8 : kIcmpHeaderSize;
+    const int roundTripBytes = 2 * (kPayloadSize + probeHeader + ipHeader + kTunnelOverhead);
+    const int budget = m_budget > 0 ? m_budget : 200;
+    return std::clamp(1000 * roundTripBytes / budget, 250, kMaxIntervalMs);
+}
+
+// ── Socket ───────────────────────────────────────────────────────────────────
+bool LatencyProber::start(QString *error)
+{
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0)
+        return true;
+    if (m_target.isNull()) {
+        *error = tr("No probe target");
+        return false;
+    }
+
+    const bool v6 = m_target.protocol() == QAbstractSocket::IPv6Protocol;
+    const int protocol = m_port ? IPPROTO_UDP : (v6 ? IPPROTO_ICMPV6 : IPPROTO_ICMP);
+    m_fd = ::socket(v6 ? AF_INET6 : AF_INET, SOCK_DGRAM, protocol);
+    if (m_fd < 0) {
+        if (!m_port && (errno == EACCES || errno == EPERM))
+            *error = tr("ICMP ping sockets are not permitted (see net.ipv4.ping_group_range); "
+                        "set ProbeTarget to a UDP echo service instead");
+        else
+            *error = QString::fromLocal8Bit(std::strerror(errno));
+        return false;
+    }
+    ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+
+#ifdef SO_BINDTODEVICE
+    // Keeps the probe on this tunnel even when policy routing (bonding)
+    // would send it elsewhere. Unprivileged since Linux 5.7; on older
+    // kernels the route table decides.
+    const QByteArray ifname = m_tunnel.toLocal8Bit();
+    ::setsockopt(m_fd, SOL_SOCKET, SO_BINDTODEVICE, ifname.constData(), socklen_t(ifname.size()));
+#endif
+
+    sockaddr_storage addr {};
+    socklen_t addrLen = 0;
+    if (v6) {
+        auto *sin6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port   = htons(m_port);
+        const Q_IPV6ADDR bytes = m_target.toIPv6Address();
+        std::memcpy(&sin6->sin6_addr, &bytes, sizeof(bytes));
+        addrLen = sizeof(sockaddr_in6);
+    } else {
+        auto *sin = reinterpret_cast<sockaddr_in *>(&addr);
+        sin->sin_family      = AF_INET;
+        sin->sin_port        = htons(m_port);
+        sin->sin_addr.s_addr = htonl(m_target.toIPv4Address());
+        addrLen = sizeof(sockaddr_in);
+    }
+    if (::connect(m_fd, reinterpret_cast<sockaddr *>(&addr), addrLen) < 0) {
+        *error = QString::fromLocal8Bit(std::strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &LatencyProber::onReadable);
+
+    m_clock.start();
+    m_intervalMs = minIntervalMs();
+    m_responding = false;
+    m_silentProbes = 0;
+    m_metrics->probeResponding.store(false, std::memory_order_relaxed);
+    m_timer->start(0);
+    return true;
+#else
+    *error = tr("In-tunnel probing is not supported on this platform");
+    return false;
+#endif
+}
+
+void LatencyProber::stop()
+{
+    m_timer->stop();
+    delete m_notifier;
+    m_notifier = nullptr;
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+    m_fd = -1;
+    m_outstanding.clear();
+}
+
+void LatencyProber::burst()
+{
+    m_steadyProbes = 0;
+    m_intervalMs = minIntervalMs();
+    if (m_fd >= 0)
+        m_timer->start(0);
+}
+
+void LatencyProber::sendProbe()
+{
+#ifdef Q_OS_UNIX
+    if (m_fd < 0)
+        return;
+    const qint64 now = m_clock.nsecsElapsed();
+    expireOutstanding(now);
+
+    const quint16 sequence = m_nextSequence++;
+    const bool v6 = m_target.protocol() == QAbstractSocket::IPv6Protocol;
+
+    // [ICMP echo header] "DKTP" seq(2) reserved(2) send-time-ns(8)
+    quint8 packet[kIcmpHeaderSize + kPayloadSize] = {};
+    quint8 *payload = packet;
+    if (!m_port) {
+        packet[0] = v6 ? kIcmp6EchoRequest : kIcmpEchoRequest;
+        packet[6] = quint8(sequence >> 8); // id and checksum are filled in by the kernel
+        packet[7] = quint8(sequence);
+        payload += kIcmpHeaderSize;
+    }
+    std::memcpy(payload, kMagic, sizeof(kMagic));
+    payload[4] = quint8(sequence >> 8);
+    payload[5] = quint8(sequence);
+    std::memcpy(payload + 8, &now, sizeof(now));
+
+    // A failed send (no route yet, interface going down) simply expires as lost.
+    const size_t length = size_t(payload - packet) + kPayloadSize;
+    ::send(m_fd, packet, length, 0);
+    m_outstanding.insert(sequence, now);
+    m_metrics->probesSent.fetch_add(1, std::memory_order_relaxed);
+
+    QTimer::singleShot(timeoutNs() / 1000000 + 10, this, [this]() {
+        expireOutstanding(m_clock.nsecsElapsed());
+    });
+    m_timer->start(m_intervalMs);
+#endif
+}
+
+void LatencyProber::onReadable()
+{
+#ifdef Q_OS_UNIX
+    const bool v6 = m_target.protocol() == QAbstractSocket::IPv6Protocol;
+    quint8 buffer[512];
+    for (;;) {
+        const ssize_t n = ::recv(m_fd, buffer, sizeof(buffer), 0);
+        if (n < 0)
+            break; // EAGAIN, or an ICMP error queued for a UDP probe
+        const qint64 now = m_clock.nsecsElapsed();
+
+        const quint8 *payload = buffer;
+        ssize_t payloadSize = n;
+        if (!m_port) {
+            if (n < kIcmpHeaderSize || buffer[0] != (v6 ? kIcmp6EchoReply : kIcmpEchoReply))
+                continue;
+            payload += kIcmpHeaderSize;
+            payloadSize -= kIcmpHeaderSize;
+        }
+        if (payloadSize < kPayloadSize || std::memcmp(payload, kMagic, sizeof(kMagic)) != 0)
+            continue;
+        handleReply(quint16((payload[4] << 8) | payload[5]), now);
+    }
+#endif
+}
+
+// ── Statistics ───────────────────────────────────────────────────────────────
+qint64 LatencyProber::timeoutNs() const
+{
+    // RFC 6298 retransmission timeout, bounded to 1 … 5 s.
+    const double rtoMs = m_srtt > 0 ? m_srtt + 4 * m_rttvar : 1000;
+    return qint64(std::clamp(rtoMs, 1000.0, 5000.0) * 1e6);
+}
+
+void LatencyProber::handleReply(quint16 sequence, qint64 nowNs)
+{
+    const auto it = m_outstanding.find(sequence);
+    if (it == m_outstanding.end())
+        return; // duplicate, or too late and already counted as lost
+    const double rttMs = (nowNs - it.value()) / 1e6;
+    m_outstanding.erase(it);
+    recordOutcome(false, rttMs);
+}
+
+void LatencyProber::expireOutstanding(qint64 nowNs)
+{
+    const qint64 timeout = timeoutNs();
+    for (auto it = m_outstanding.begin(); it != m_outstanding.end();) {
+        if (nowNs - it.value() > timeout) {
+            it = m_outstanding.erase(it);
+            recordOutcome(true, 0);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LatencyProber::recordOutcome(bool lost, double rttMs)
+{
+    if (!m_responding) {
+        if (lost) {
+            // Nothing has answered yet: most likely the target does not exist
+            // or drops echo requests, so this says nothing about the path.
+            // Say so once, then keep asking at the slow rate.
+            if (++m_silentProbes == kSilentProbes) {
+                m_intervalMs = kMaxIntervalMs;
+                LatencyQuality quality;
+                quality.tunnel      = m_tunnel;
+                quality.responding  = false;
+                quality.sampledAtMs = QDateTime::currentMSecsSinceEpoch();
+                emit qualityUpdated(quality);
+            }
+            return;
+        }
+        m_responding = true;
+        m_intervalMs = minIntervalMs();
+        if (m_timer->isActive() && m_timer->remainingTime() > m_intervalMs)
+            m_timer->start(m_intervalMs);
+        m_metrics->probeResponding.store(true, std::memory_order_relaxed);
+    }
+
+    if (m_lossFilled == kLossWindow)
+        m_lossCount -= m_lossRing[m_lossPos];
+    else
+        ++m_lossFilled;
+    m_lossRing[m_lossPos] = lost;
+    m_lossCount += lost;
+    m_lossPos = (m_lossPos + 1) % kLossWindow;
+
+    bool steady = !lost;
+    if (lost) {
+        m_metrics->probesLost.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        m_metrics->rtt.record(quint64(rttMs * 1000));
+        if (m_srtt == 0) {
+            m_srtt = rttMs;
+            m_rttvar = rttMs / 2;
+        } else {
+            steady = rttMs <= m_srtt + 4 * m_rttvar;
+            m_rttvar = 0.75 * m_rttvar + 0.25 * std::abs(m_srtt - rttMs);
+            m_srtt   = 0.875 * m_srtt + 0.125 * rttMs;
+        }
+        if (m_lastRtt >= 0)
+            m_jitter += (std::abs(rttMs - m_lastRtt) - m_jitter) / 16;
+        m_lastRtt = rttMs;
+        m_metrics->jitterMicros.store(quint64(m_jitter * 1000), std::memory_order_relaxed);
+
+        if (m_recent.size() < kRecentRtts)
+            m_recent.append(rttMs);
+        else
+            m_recent[m_recentPos] = rttMs;
+        m_recentPos = (m_recentPos + 1) % kRecentRtts;
+    }
+
+    // Back off while the path is steady; go back to full rate on trouble.
+    if (steady) {
+        if (++m_steadyProbes >= 10) {
+            m_steadyProbes = 0;
+            m_intervalMs = std::min(kMaxIntervalMs, m_intervalMs * 3 / 2);
+        }
+    } else {
+        m_steadyProbes = 0;
+        m_intervalMs = minIntervalMs();
+        if (m_timer->isActive() && m_timer->remainingTime() > m_intervalMs)
+            m_timer->start(m_intervalMs);
+    }
+
+    LatencyQuality quality;
+    quality.tunnel      = m_tunnel;
+    quality.lost        = lost;
+    quality.rttMs       = rttMs;
+    quality.srttMs      = m_srtt;
+    quality.p50Ms       = percentile(m_recent, 0.5);
+    quality.p99Ms       = percentile(m_recent, 0.99);
+    quality.jitterMs    = m_jitter;
+    quality.loss        = double(m_lossCount) / m_lossFilled;
+    quality.sampledAtMs = QDateTime::currentMSecsSinceEpoch();
+    emit qualityUpdated(quality);
+}
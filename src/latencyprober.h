@@ -0,0 +1,125 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMap>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QSocketNotifier;
+class QTimer;
+struct TunnelMetrics;
+
+/// Tunnel quality after one probe result, delivered by value across threads.
+struct LatencyQuality {
+    QString tunnel;
+    bool    responding = true; ///< false: the target has never answered, nothing below is measured
+    bool    lost     = false; ///< this probe timed out; rttMs is then 0
+    double  rttMs    = 0;
+    double  srttMs   = 0;     ///< smoothed RTT (RFC 6298)
+    double  p50Ms    = 0;     ///< over the last kRecentRtts replies
+    double  p99Ms    = 0;
+    double  jitterMs = 0;     ///< RFC 3550 interarrival jitter
+    double  loss     = 0;     ///< 0..1 over the last kLossWindow probes
+    qint64  sampledAtMs = 0;  ///< ms since the epoch
+};
+Q_DECLARE_METATYPE(LatencyQuality)
+
+/**
+ * LatencyProber measures round-trip time, jitter and loss inside a tunnel.
+ *
+ * It sends small timestamped probes to a target reachable only through the
+ * tunnel: an ICMP echo through an unprivileged ping socket, or a UDP
+ * datagram to an echo service when a port is given. The probe socket is
+ * bound to the tunnel interface (Linux), so each member of a bond is
+ * measured on its own path.
+ *
+ * The probe rate adapts. It starts at the fastest rate the bandwidth budget
+ * allows and backs off to one probe every 10 s while results are steady.
+ * Any loss or RTT outlier, or a burst() request, returns it to the fastest
+ * rate. Every probe result is recorded in the tunnel's TunnelMetrics and
+ * reported through qualityUpdated().
+ *
+ * The default target is a guess, and a host that drops echo requests looks
+ * exactly like a dead path. Until the first reply arrives, timeouts are
+ * therefore not counted as loss: after kSilentProbes of them the prober
+ * reports a single quality with `responding` false and keeps probing at
+ * the backed-off rate until the target answers.
+ *
+ * Supported on POSIX systems; start() returns false elsewhere.
+ */
+class LatencyProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kPayloadSize  = 16;
+    static constexpr int kLossWindow   = 100;
+    static constexpr int kRecentRtts   = 128;
+    static constexpr int kMaxIntervalMs = 10000;
+    static constexpr int kSilentProbes = 5;
+
+    LatencyProber(const QString &tunnel, TunnelMetrics *metrics, QObject *parent = nullptr);
+    ~LatencyProber() override;
+
+    /// @p port 0 probes with ICMP echo, otherwise with UDP echo.
+    void setTarget(const QHostAddress &address, quint16 port = 0);
+    /// Upper bound for probe traffic in both directions, bytes per second.
+    void setBudget(int bytesPerSecond);
+
+    bool start(QString *error);
+    void stop();
+    /// Probes at the fastest allowed rate again, e.g. after a network change.
+    void burst();
+
+    const QString &tunnel() const { return m_tunnel; }
+    const QHostAddress &target() const { return m_target; }
+
+signals:
+    void qualityUpdated(const LatencyQuality &quality);
+
+private slots:
+    void sendProbe();
+    void onReadable();
+
+private:
+    int  minIntervalMs() const;
+    void handleReply(quint16 sequence, qint64 nowNs);
+    void expireOutstanding(qint64 nowNs);
+    void recordOutcome(bool lost, double rttMs);
+    qint64 timeoutNs() const;
+
+    QString          m_tunnel;
+    TunnelMetrics   *m_metrics;
+    QHostAddress     m_target;
+    quint16          m_port   = 0;
+    int              m_budget = 200;
+
+    int              m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer          *m_timer = nullptr;
+    QElapsedTimer    m_clock;
+
+    quint16              m_nextSequence = 0;
+    QMap<quint16, qint64> m_outstanding;   ///< sequence → send time (ns on m_clock)
+
+    int     m_intervalMs = 1000;
+    int     m_steadyProbes = 0;
+    bool    m_responding = false;          ///< a reply has arrived since start()
+    int     m_silentProbes = 0;            ///< timeouts before the first reply
+
+    // RFC 6298 smoothing and RFC 3550 jitter, in ms
+    double  m_srtt = 0;
+    double  m_rttvar = 0;
+    double  m_jitter = 0;
+    double  m_lastRtt = -1;
+
+    bool            m_lossRing[kLossWindow] = {};
+    int             m_lossPos = 0;
+    int             m_lossFilled = 0;
+    int             m_lossCount = 0;
+    QVector<double> m_recent;              ///< ring of the last kRecentRtts RTTs
+    int             m_recentPos = 0;
+};
@@ -0,0 +1,377 @@
+#include "logger.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+
+// ── Per-thread ring buffer ───────────────────────────────────────────────────
+class Logger::Buffer
+{
+public:
+    static constexpr size_t kCapacity = 1024; // power of two
+
+    /// Producer side; only ever called by the owning thread.
+    bool push(LogRecord &&record, bool *halfFull)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        if (head - tail >= kCapacity)
+            return false;
+        m_slots[head & (kCapacity - 1)] = std::move(record);
+        m_head.store(head + 1, std::memory_order_release);
+        *halfFull = head - tail + 1 >= kCapacity / 2;
+        return true;
+    }
+
+    /// Consumer side; only ever called by the writer thread.
+    template <typename F>
+    size_t drain(F &&consume)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t count = head - tail;
+        for (; tail != head; ++tail) {
+            LogRecord &slot = m_slots[tail & (kCapacity - 1)];
+            consume(slot);
+            slot = LogRecord(); // release shared strings on this thread
+        }
+        m_tail.store(tail, std::memory_order_release);
+        return count;
+    }
+
+    bool isEmpty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    std::atomic<bool> orphaned { false }; ///< owning thread has exited
+
+private:
+    std::array<LogRecord, kCapacity> m_slots;
+    alignas(64) std::atomic<size_t>  m_head { 0 };
+    alignas(64) std::atomic<size_t>  m_tail { 0 };
+};
+
+struct Logger::BufferHandle
+{
+    std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+
+    BufferHandle()
+    {
+        Logger &logger = Logger::instance();
+        QMutexLocker lock(&logger.m_buffersMutex);
+        logger.m_buffers.push_back(buffer);
+    }
+    ~BufferHandle() { buffer->orphaned.store(true, std::memory_order_release); }
+};
+
+// ── Formatting helpers ───────────────────────────────────────────────────────
+namespace {
+
+/// Backslash-escapes what would break the one-record-per-line format.
+QString escaped(const QString &s)
+{
+    const auto special = [](QChar c) {
+        return c == '\\' || c == '"' || c == '\n' || c == '\r';
+    };
+    if (std::none_of(s.begin(), s.end(), special))
+        return s;
+    QString out;
+    out.reserve(s.size() + 8);
+    for (const QChar c : s) {
+        switch (c.unicode()) {
+        case '\\': out += QLatin1String("\\\\"); break;
+        case '"':  out += QLatin1String("\\\""); break;
+        case '\n': out += QLatin1String("\\n");  break;
+        case '\r': out += QLatin1String("\\r");  break;
+        default:   out += c;                     break;
+        }
+    }
+    return out;
+}
+
+QString formatValue(const QString &value)
+{
+    const bool quote = value.isEmpty()
+        || std::any_of(value.begin(), value.end(), [](QChar c) {
+               return c == ' ' || c == '=' || c == '"' || c == '\\' || c == '\n' || c == '\r';
+           });
+    return quote ? '"' + escaped(value) + '"' : value;
+}
+
+QString formatLine(const LogRecord &r, const QString &text)
+{
+    QString line = QDateTime::fromMSecsSinceEpoch(r.timestampMs, Qt::UTC)
+                       .toString(Qt::ISODateWithMs);
+    line += ' ';
+    line += QLatin1String(Logger::levelName(r.level));
+    line += ' ';
+    line += QLatin1String(r.source ? r.source : "-");
+    if (!r.tunnel.isEmpty())
+        line += " tunnel=" + formatValue(r.tunnel);
+    line += ' ';
+    line += escaped(text);
+    for (int i = 0; i < r.fieldCount; ++i) {
+        line += ' ';
+        line += QLatin1String(r.fields[i].key);
+        line += '=';
+        line += formatValue(r.fields[i].value.toString());
+    }
+    return line;
+}
+
+} // namespace
+
+// ── Sinks ────────────────────────────────────────────────────────────────────
+RotatingFileSink::RotatingFileSink(const QString &path, qint64 maxBytes, int maxFiles)
+    : m_path(path)
+    , m_maxBytes(maxBytes)
+    , m_maxFiles(qMax(1, maxFiles))
+    , m_file(path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+        m_written = m_file.size();
+}
+
+void RotatingFileSink::write(const LogRecord &, const QString &line, const QString &)
+{
+    if (!m_file.isOpen())
+        return;
+    const QByteArray utf8 = line.toUtf8() + '\n';
+    if (m_written > 0 && m_written + utf8.size() > m_maxBytes) {
+        rotate();
+        if (!m_file.isOpen())
+            return;
+    }
+    m_file.write(utf8);
+    m_written += utf8.size();
+}
+
+void RotatingFileSink::flush()
+{
+    if (m_file.isOpen())
+        m_file.flush();
+}
+
+void RotatingFileSink::rotate()
+{
+    m_file.close();
+    QFile::remove(m_path + '.' + QString::number(m_maxFiles));
+    for (int i = m_maxFiles - 1; i >= 1; --i)
+        QFile::rename(m_path + '.' + QString::number(i), m_path + '.' + QString::number(i + 1));
+    QFile::rename(m_path, m_path + ".1");
+    if (m_file.open(QIODevice::WriteOnly | QIODevice::Append))
+        m_written = m_file.size();
+}
+
+void UiLogSink::write(const LogRecord &record, const QString &, const QString &text)
+{
+    if (record.level >= m_minLevel)
+        emit lineLogged(text);
+}
+
+// ── Logger ───────────────────────────────────────────────────────────────────
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger() = default;
+
+Logger::~Logger()
+{
+    shutdown();
+}
+
+const char *Logger::levelName(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Debug:   return "DEBUG";
+    case LogLevel::Info:    return "INFO";
+    case LogLevel::Warning: return "WARN";
+    case LogLevel::Error:   return "ERROR";
+    }
+    return "INFO";
+}
+
+QString Logger::defaultLogDirectory()
+{
+    QString envDir = qEnvironmentVariable("DKT_VPN_LOG_DIR");
+    if (!envDir.isEmpty())
+        return envDir;
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/logs";
+}
+
+void Logger::start()
+{
+    if (m_running.exchange(true))
+        return;
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->setObjectName("dkt-log-writer");
+    m_writer->start(QThread::LowPriority);
+}
+
+void Logger::shutdown()
+{
+    if (!m_running.exchange(false))
+        return;
+    m_wake.wakeAll();
+    m_writer->wait();
+    delete m_writer;
+    m_writer = nullptr;
+}
+
+void Logger::addSink(std::shared_ptr<LogSink> sink)
+{
+    QMutexLocker lock(&m_sinksMutex);
+    m_sinks.push_back(std::move(sink));
+}
+
+void Logger::removeSink(const LogSink *sink)
+{
+    QMutexLocker lock(&m_sinksMutex);
+    m_sinks.erase(std::remove_if(m_sinks.begin(), m_sinks.end(),
+                                 [sink](const std::shared_ptr<LogSink> &s) {
+                                     return s.get() == sink;
+                                 }),
+                  m_sinks.end());
+}
+
+Logger::Buffer *Logger::localBuffer()
+{
+    thread_local BufferHandle handle;
+    return handle.buffer.get();
+}
+
+void Logger::log(LogLevel level, const char *source, const QString &tunnel,
+                 const QString &message, std::initializer_list<LogField> fields)
+{
+    if (level < m_minLevel.load(std::memory_order_relaxed))
+        return;
+
+    LogRecord r;
+    r.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    r.level       = level;
+    r.source      = source;
+    r.tunnel      = tunnel;
+    r.message     = message;
+    for (const LogField &f : fields) {
+        if (r.fieldCount == LogRecord::kMaxFields)
+            break;
+        r.fields[r.fieldCount++] = f;
+    }
+    submit(std::move(r));
+}
+
+void Logger::logRaw(LogLevel level, const char *source, const QString &tunnel,
+                    const QByteArray &raw)
+{
+    if (raw.isEmpty() || level < m_minLevel.load(std::memory_order_relaxed))
+        return;
+
+    LogRecord r;
+    r.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    r.level       = level;
+    r.source      = source;
+    r.tunnel      = tunnel;
+    r.raw         = raw;
+    submit(std::move(r));
+}
+
+void Logger::submit(LogRecord &&record)
+{
+    const bool urgent = record.level >= LogLevel::Warning;
+    bool halfFull = false;
+    if (!localBuffer()->push(std::move(record), &halfFull)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        m_wake.wakeOne();
+        return;
+    }
+    // The writer also wakes up on its own every few milliseconds; only pay
+    // for an explicit wake-up when someone is likely waiting for the line.
+    if (urgent || halfFull)
+        m_wake.wakeOne();
+}
+
+void Logger::writerLoop()
+{
+    while (m_running.load(std::memory_order_acquire)) {
+        if (!drainOnce()) {
+            QMutexLocker lock(&m_wakeMutex);
+            m_wake.wait(&m_wakeMutex, 50);
+        }
+    }
+    while (drainOnce()) {}
+}
+
+bool Logger::drainOnce()
+{
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    {
+        QMutexLocker lock(&m_buffersMutex);
+        buffers = m_buffers;
+    }
+
+    size_t drained = 0;
+    for (const auto &buffer : buffers)
+        drained += buffer->drain([this](const LogRecord &r) { dispatch(r); });
+
+    if (const quint64 dropped = m_dropped.exchange(0, std::memory_order_relaxed)) {
+        LogRecord r;
+        r.timestampMs = QDateTime::currentMSecsSinceEpoch();
+        r.level       = LogLevel::Warning;
+        r.source      = "logger";
+        r.message     = QStringLiteral("log buffer overflow, records dropped");
+        r.fields[r.fieldCount++] = { "count", dropped };
+        dispatch(r);
+        ++drained;
+    }
+
+    // Forget rings whose threads have exited once they are empty.
+    {
+        QMutexLocker lock(&m_buffersMutex);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                       [](const std::shared_ptr<Buffer> &b) {
+                                           return b->orphaned.load(std::memory_order_acquire)
+                                               && b->isEmpty();
+                                       }),
+                        m_buffers.end());
+    }
+
+    if (drained > 0) {
+        QMutexLocker lock(&m_sinksMutex);
+        for (const auto &sink : m_sinks)
+            sink->flush();
+    }
+    return drained > 0;
+}
+
+void Logger::dispatch(const LogRecord &record)
+{
+    QMutexLocker lock(&m_sinksMutex);
+    if (m_sinks.empty())
+        return;
+
+    auto emitLine = [&](const QString &text) {
+        const QString line = formatLine(record, text);
+        for (const auto &sink : m_sinks)
+            sink->write(record, line, text);
+    };
+
+    if (record.raw.isEmpty()) {
+        emitLine(record.message);
+        return;
+    }
+    const QStringList lines = QString::fromLocal8Bit(record.raw).split('\n');
+    for (const QString &l : lines) {
+        const QString trimmed = l.trimmed();
+        if (!trimmed.isEmpty())
+            emitLine(trimmed);
+    }
+}
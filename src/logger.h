@@ -0,0 +1,161 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVariant>
+#include <QWaitCondition>
+#include <array>
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class QThread;
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+/// One key/value pair attached to a log record. @p key must be a string literal.
+struct LogField {
+    const char *key = nullptr;
+    QVariant    value;
+};
+
+/**
+ * A single structured log record. Everything is captured as-is on the caller
+ * path (implicitly shared Qt types, no formatting); rendering to text happens
+ * on the writer thread.
+ */
+struct LogRecord {
+    static constexpr int kMaxFields = 6;
+
+    qint64      timestampMs = 0;
+    LogLevel    level       = LogLevel::Info;
+    const char *source      = nullptr; ///< string literal, e.g. "vpnmanager"
+    QString     tunnel;
+    QString     message;
+    QByteArray  raw;                   ///< undecoded process output, if any
+    std::array<LogField, kMaxFields> fields;
+    int         fieldCount  = 0;
+};
+
+/// Receives formatted records on the logger's writer thread.
+class LogSink
+{
+public:
+    virtual ~LogSink() = default;
+    /// @p line is the fully formatted record, @p text the bare message.
+    virtual void write(const LogRecord &record, const QString &line, const QString &text) = 0;
+    virtual void flush() {}
+};
+
+/// Appends to a log file and rotates it once it exceeds a size limit:
+/// dkt-vpn.log → dkt-vpn.log.1 → … → dkt-vpn.log.<maxFiles>.
+class RotatingFileSink : public LogSink
+{
+public:
+    RotatingFileSink(const QString &path, qint64 maxBytes, int maxFiles);
+
+    void write(const LogRecord &record, const QString &line, const QString &text) override;
+    void flush() override;
+
+private:
+    void rotate();
+
+    QString m_path;
+    qint64  m_maxBytes;
+    int     m_maxFiles;
+    QFile   m_file;
+    qint64  m_written = 0; ///< size of m_file, tracked so write() needs no fstat
+};
+
+/// Forwards records to the GUI as a queued Qt signal.
+class UiLogSink : public QObject, public LogSink
+{
+    Q_OBJECT
+
+public:
+    explicit UiLogSink(LogLevel minLevel = LogLevel::Info, QObject *parent = nullptr)
+        : QObject(parent), m_minLevel(minLevel) {}
+
+    void write(const LogRecord &record, const QString &line, const QString &text) override;
+
+signals:
+    void lineLogged(const QString &text);
+
+private:
+    LogLevel m_minLevel;
+};
+
+/**
+ * Logger is the process-wide structured logger.
+ *
+ * Each calling thread owns a fixed-size single-producer ring buffer, so
+ * log() never takes a lock; a background writer drains all rings, formats
+ * the records and hands them to the registered sinks (rotating file, UI …).
+ * If a ring is full the record is dropped and counted rather than blocking
+ * the caller.
+ */
+class Logger
+{
+public:
+    static Logger &instance();
+
+    /// Starts the writer thread. Records logged earlier are kept in the
+    /// per-thread rings until then.
+    void start();
+    /// Drains every pending record, flushes the sinks and joins the writer.
+    void shutdown();
+
+    void addSink(std::shared_ptr<LogSink> sink);
+    void removeSink(const LogSink *sink);
+
+    void setMinimumLevel(LogLevel level) { m_minLevel.store(level, std::memory_order_relaxed); }
+
+    void log(LogLevel level, const char *source, const QString &tunnel,
+             const QString &message, std::initializer_list<LogField> fields = {});
+    /// Logs raw process output; it is decoded and split into lines by the writer.
+    void logRaw(LogLevel level, const char *source, const QString &tunnel,
+                const QByteArray &raw);
+
+    /// Default location of the rotating log file.
+    static QString defaultLogDirectory();
+    static const char *levelName(LogLevel level);
+
+private:
+    class Buffer;
+    struct BufferHandle;
+
+    Logger();
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    Buffer *localBuffer();
+    void    submit(LogRecord &&record);
+    void    writerLoop();
+    bool    drainOnce();
+    void    dispatch(const LogRecord &record);
+
+    std::atomic<LogLevel>               m_minLevel { LogLevel::Debug };
+    std::atomic<bool>                   m_running { false };
+    std::atomic<quint64>                m_dropped { 0 };
+
+    QMutex                              m_buffersMutex;
+    std::vector<std::shared_ptr<Buffer>> m_buffers;
+
+    QMutex                              m_sinksMutex;
+    std::vector<std::shared_ptr<LogSink>> m_sinks;
+
+    QMutex                              m_wakeMutex;
+    QWaitCondition                      m_wake;
+    QThread                            *m_writer = nullptr;
+};
@@ -1,5 +1,6 @@
 #include <QApplication>
 #include <QIcon>
+#include "logger.h"
 #include "mainwindow.h"
 
 int main(int argc, char *argv[])
@@ -10,8 +11,19 @@ int main(int argc, char *argv[])
     app.setOrganizationName("DKT");
     app.setOrganizationDomain("dkt.vpn");
 
-    MainWindow window;
-    window.show();
+    // Structured log: 5 × 4 MiB rotating files plus the in-window view
+    Logger &logger = Logger::instance();
+    logger.addSink(std::make_shared<RotatingFileSink>(
+        Logger::defaultLogDirectory() + "/dkt-vpn.log", 4 * 1024 * 1024, 5));
+    logger.start();
 
-    return app.exec();
+    int rc = 0;
+    {
+        MainWindow window;
+        window.show();
+        rc = app.exec();
+    }
+
+    logger.shutdown();
+    return rc;
 }
@@ -1,6 +1,8 @@
 #include "mainwindow.h"
+#include "metricsserver.h"
 
 #include <QApplication>
+#include <QCloseEvent>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
@@ -8,6 +10,7 @@
 #include <QTime>
 #include <QMessageBox>
 #include <QScrollBar>
+#include <QThread>
 #include <QFrame>
 #include <QSizePolicy>
 
@@ -16,31 +19,114 @@ MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
     m_servers    = defaultServers();
-    m_vpnManager = new VpnManager(this);
     m_connTimer  = new QTimer(this);
     m_connTimer->setInterval(1000);
 
     setupUi();
     applyStyles();
 
+    // All tunnel work (processes, file probes, parsing) runs on its own
+    // thread; the signals below arrive queued.
+    m_workerThread = new QThread(this);
+    m_workerThread->setObjectName("vpn-manager");
+    m_vpnManager = new VpnManager;
+    m_vpnManager->moveToThread(m_workerThread);
+    connect(m_workerThread, &QThread::started,
+            m_vpnManager, &VpnManager::initialize);
+    connect(m_workerThread, &QThread::finished, this, [this]() {
+        m_shutdownComplete = true;
+        close();
+    });
+    // Direct: the thread also has to stop while the destructor blocks the
+    // UI thread. QThread::quit() is thread-safe.
+    connect(m_vpnManager, &VpnManager::shutdownFinished,
+            m_workerThread, &QThread::quit, Qt::DirectConnection);
     connect(m_vpnManager, &VpnManager::statusChanged,
             this, &MainWindow::onStatusChanged);
     connect(m_vpnManager, &VpnManager::statsUpdated,
             this, &MainWindow::onStatsUpdated);
-    connect(m_vpnManager, &VpnManager::logMessage,
-            this, &MainWindow::onLogMessage);
+    connect(m_vpnManager, &VpnManager::bondsDiscovered,
+            this, &MainWindow::onBondsDiscovered);
+    connect(m_vpnManager, &VpnManager::qualityUpdated,
+            this, &MainWindow::onQualityUpdated);
+    connect(m_vpnManager, &VpnManager::queueStatsUpdated,
+            this, &MainWindow::onQueueStatsUpdated);
+    m_workerThread->start();
+    // The log view is one more sink of the process-wide logger.
+    m_logSink = std::make_shared<UiLogSink>();
+    connect(m_logSink.get(), &UiLogSink::lineLogged,
+            this, &MainWindow::onLogMessage, Qt::QueuedConnection);
+    Logger::instance().addSink(m_logSink);
     connect(m_connTimer, &QTimer::timeout,
             this, &MainWindow::updateConnectionTime);
     connect(m_connectBtn, &QPushButton::clicked,
             this, &MainWindow::onConnectClicked);
+
+    // Opt-in OpenMetrics endpoint on 127.0.0.1
+    bool portOk = false;
+    const uint metricsPort = qEnvironmentVariable("DKT_VPN_METRICS_PORT").toUInt(&portOk);
+    if (portOk && metricsPort > 0 && metricsPort <= 65535) {
+        m_metricsServer = new MetricsServer(&m_vpnManager->metrics(), this);
+        if (m_metricsServer->listen(quint16(metricsPort)))
+            Logger::instance().log(LogLevel::Info, "metrics", {},
+                                   QString("Metrics available at http://127.0.0.1:%1/metrics")
+                                   .arg(m_metricsServer->port()));
+        else
+            Logger::instance().log(LogLevel::Warning, "metrics", {},
+                                   QString("Could not listen on metrics port %1").arg(metricsPort));
+
+        // UI event-loop lag: how late a 100 ms timer fires.
+        m_lagTimer = new QTimer(this);
+        m_lagTimer->setInterval(100);
+        connect(m_lagTimer, &QTimer::timeout, this, [this]() {
+            const qint64 elapsedMs = m_lagClock.restart();
+            m_vpnManager->metrics().observeUiLag(qMax<qint64>(0, elapsedMs - 100) / 1000.0);
+        });
+        m_lagClock.start();
+        m_lagTimer->start();
+    }
+}
+
+MainWindow::~MainWindow()
+{
+    Logger::instance().removeSink(m_logSink.get());
+    delete m_metricsServer; // it reads the manager's metrics
+    m_metricsServer = nullptr;
+    // Still running without closeEvent (e.g. QApplication::quit()): the
+    // manager kills its commands on its own thread, which then stops.
+    if (m_workerThread->isRunning()) {
+        m_vpnManager->shutdown();
+        m_workerThread->wait();
+    }
+    delete m_vpnManager;
+}
+
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    if (m_shutdownComplete) {
+        QMainWindow::closeEvent(event);
+        return;
+    }
+    // Closing never blocks the UI: the manager kills its commands on its own
+    // thread and the window closes once that thread has finished.
+    event->ignore();
+    if (m_shutdownRequested)
+        return;
+    m_shutdownRequested = true;
+    m_centralWidget->setEnabled(false);
+    if (m_lagTimer)
+        m_lagTimer->stop();
+    delete m_metricsServer; // it reads the manager's metrics
+    m_metricsServer = nullptr;
+    m_vpnManager->shutdown();
 }
 
 // ── UI setup ──────────────────────────────────────────────────────────────────
 void MainWindow::setupUi()
 {
     setWindowTitle("DKT VPN");
-    setMinimumSize(480, 620);
-    resize(480, 620);
+    setMinimumSize(480, 770);
+    resize(480, 770);
 
     m_centralWidget = new QWidget(this);
     setCentralWidget(m_centralWidget);
@@ -142,6 +228,10 @@ void MainWindow::setupUi()
     addStat(0, "Duration",   m_timeLabel);
     addStat(1, "Downloaded", m_rxLabel);
     addStat(2, "Uploaded",   m_txLabel);
+    addStat(3, "Latency",    m_latencyLabel);
+    m_chart = new ThroughputChart;
+    m_chart->setFixedHeight(110);
+    statsGrid->addWidget(m_chart, 4, 0, 1, 2);
     contentLayout->addWidget(statsGroup);
 
     // Log view
@@ -323,6 +413,9 @@ void MainWindow::onStatusChanged(VpnStatus status, const QString &message)
         m_timeLabel->setText("—");
         m_rxLabel->setText("—");
         m_txLabel->setText("—");
+        m_latencyLabel->setText("—");
+        m_latencyLabel->setToolTip({});
+        m_quality.clear();
         m_serverCombo->setEnabled(true);
         break;
 
@@ -331,6 +424,8 @@ void MainWindow::onStatusChanged(VpnStatus status, const QString &message)
         m_connectBtn->setText("Connecting…");
         m_connectBtn->setEnabled(false);
         m_serverCombo->setEnabled(false);
+        m_chart->clear();
+        m_quality.clear();
         break;
 
     case VpnStatus::Connected:
@@ -361,10 +456,63 @@ void MainWindow::onStatusChanged(VpnStatus status, const QString &message)
     }
 }
 
-void MainWindow::onStatsUpdated(quint64 bytesRx, quint64 bytesTx)
+void MainWindow::onStatsUpdated(const VpnStats &stats)
+{
+    m_rxLabel->setText(formatBytes(stats.rxBytes));
+    m_txLabel->setText(formatBytes(stats.txBytes));
+    m_chart->addTrafficSample(stats.sampledAtMs, stats.rxBytes, stats.txBytes);
+}
+
+void MainWindow::onQualityUpdated(const LatencyQuality &quality)
+{
+    m_quality.insert(quality.tunnel, quality);
+
+    // A bond reports every member; show the one with the lowest latency.
+    const LatencyQuality *best = nullptr;
+    for (const LatencyQuality &q : std::as_const(m_quality)) {
+        if (q.srttMs > 0 && (!best || q.srttMs < best->srttMs))
+            best = &q;
+    }
+    if (!best)
+        best = &m_quality[quality.tunnel];
+
+    if (!best->responding) {
+        m_latencyLabel->setText("no probe responder");
+        return;
+    }
+    m_latencyLabel->setText(QString("%1 ms (p99 %2) · ±%3 ms · %4 % loss")
+                            .arg(best->srttMs, 0, 'f', 0)
+                            .arg(best->p99Ms, 0, 'f', 0)
+                            .arg(best->jitterMs, 0, 'f', 1)
+                            .arg(best->loss * 100, 0, 'f', 0));
+    if (!quality.lost && best->tunnel == quality.tunnel)
+        m_chart->addLatencySample(quality.sampledAtMs, quality.rttMs);
+}
+
+void MainWindow::onQueueStatsUpdated(const QueueStats &stats)
 {
-    m_rxLabel->setText(formatBytes(bytesRx));
-    m_txLabel->setText(formatBytes(bytesTx));
+    // Per-class detail is on hover; the label itself stays the probe summary.
+    QStringList lines;
+    lines << (stats.shapeRate ? QString("%1 shaped at %2 Mbit/s").arg(stats.kind)
+                                    .arg(stats.shapeRate * 8 / 1e6, 0, 'f', 1)
+                              : QString("%1, unshaped").arg(stats.kind));
+    for (const QueueClassStats &c : stats.classes) {
+        QString line = QString("%1: %2 dropped, %3 ECN marked, %4 queued")
+                       .arg(c.name).arg(c.drops).arg(c.ecnMarks)
+                       .arg(formatBytes(c.backlogBytes));
+        if (stats.kind == "cake")
+            line += QString(", %1 ms delay").arg(c.avgDelayUs / 1000.0, 0, 'f', 1);
+        lines << line;
+    }
+    m_latencyLabel->setToolTip(lines.join('\n'));
+}
+
+void MainWindow::onBondsDiscovered(const QList<VpnServer> &bonds)
+{
+    for (const VpnServer &bond : bonds) {
+        m_servers << bond;
+        m_serverCombo->addItem(bond.flag + "  " + bond.country);
+    }
 }
 
 void MainWindow::onLogMessage(const QString &line)
@@ -7,21 +7,35 @@
 #include <QTextEdit>
 #include <QTimer>
 #include <QTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <memory>
+#include "logger.h"
+#include "throughputchart.h"
 #include "vpnmanager.h"
 #include "vpnserver.h"
 
+class QThread;
+class MetricsServer;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
 public:
     explicit MainWindow(QWidget *parent = nullptr);
-    ~MainWindow() override = default;
+    ~MainWindow() override;
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
 
 private slots:
     void onConnectClicked();
     void onStatusChanged(VpnStatus status, const QString &message);
-    void onStatsUpdated(quint64 bytesRx, quint64 bytesTx);
+    void onStatsUpdated(const VpnStats &stats);
+    void onBondsDiscovered(const QList<VpnServer> &bonds);
+    void onQualityUpdated(const LatencyQuality &quality);
+    void onQueueStatsUpdated(const QueueStats &stats);
     void onLogMessage(const QString &line);
     void updateConnectionTime();
 
@@ -41,12 +55,22 @@ private:
     QLabel      *m_rxLabel        = nullptr;
     QLabel      *m_txLabel        = nullptr;
     QLabel      *m_timeLabel      = nullptr;
+    QLabel      *m_latencyLabel   = nullptr;
+    ThroughputChart *m_chart      = nullptr;
     QTextEdit   *m_logView        = nullptr;
 
     // Logic
-    VpnManager           *m_vpnManager = nullptr;
+    VpnManager           *m_vpnManager = nullptr; ///< lives on m_workerThread
+    QThread              *m_workerThread = nullptr;
+    bool                  m_shutdownRequested = false;
+    bool                  m_shutdownComplete  = false;
+    MetricsServer        *m_metricsServer = nullptr;
+    QTimer               *m_lagTimer   = nullptr;  ///< event-loop lag probe, with metrics only
+    QElapsedTimer         m_lagClock;
     QList<VpnServer>      m_servers;
     QTimer               *m_connTimer  = nullptr;
     QTime                 m_connStart;
     VpnStatus             m_currentStatus = VpnStatus::Disconnected;
+    QHash<QString, LatencyQuality> m_quality; ///< latest probe result per tunnel
+    std::shared_ptr<UiLogSink> m_logSink;
 };
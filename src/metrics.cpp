@@ -0,0 +1,367 @@
+#include "metrics.h"
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+// ── Formatting helpers ───────────────────────────────────────────────────────
+namespace {
+
+const std::initializer_list<double> kLatencyBounds = {
+    0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0
+};
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray out;
+    const QByteArray utf8 = value.toUtf8();
+    out.reserve(utf8.size());
+    for (char c : utf8) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '"':  out += "\\\""; break;
+        case '\n': out += "\\n";  break;
+        default:   out += c;      break;
+        }
+    }
+    return out;
+}
+
+void appendSample(QByteArray &out, const QByteArray &name, const QByteArray &labels,
+                  const QByteArray &value)
+{
+    out += name;
+    if (!labels.isEmpty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+void appendFamily(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += "\n# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += '\n';
+}
+
+} // namespace
+
+// ── MetricsHistogram ─────────────────────────────────────────────────────────
+MetricsHistogram::MetricsHistogram(std::initializer_list<double> upperBounds)
+    : m_bounds(upperBounds)
+    , m_buckets(new std::atomic<quint64>[upperBounds.size() + 1])
+{
+    for (size_t i = 0; i <= m_bounds.size(); ++i)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::observe(double value)
+{
+    const auto it = std::lower_bound(m_bounds.begin(), m_bounds.end(), value);
+    m_buckets[size_t(it - m_bounds.begin())].fetch_add(1, std::memory_order_relaxed);
+    if (value > 0)
+        m_sumMicros.fetch_add(quint64(value * 1e6), std::memory_order_relaxed);
+}
+
+void MetricsHistogram::format(QByteArray &out, const QByteArray &name,
+                              const QByteArray &labels) const
+{
+    const QByteArray bucketName = name + "_bucket";
+    const QByteArray prefix = labels.isEmpty() ? QByteArray() : labels + ',';
+
+    quint64 cumulative = 0;
+    for (size_t i = 0; i <= m_bounds.size(); ++i) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        const QByteArray le = i < m_bounds.size() ? QByteArray::number(m_bounds[i], 'g', 6)
+                                                  : QByteArray("+Inf");
+        appendSample(out, bucketName, prefix + "le=\"" + le + '"',
+                     QByteArray::number(cumulative));
+    }
+    // Buckets are read one by one without a lock, so report the bucket total
+    // as the count to keep the exposition self-consistent.
+    appendSample(out, name + "_count", labels, QByteArray::number(cumulative));
+    appendSample(out, name + "_sum", labels,
+                 QByteArray::number(m_sumMicros.load(std::memory_order_relaxed) / 1e6, 'f', 6));
+}
+
+// ── LatencyHistogram ─────────────────────────────────────────────────────────
+int LatencyHistogram::bucketFor(quint64 micros)
+{
+    // Values below 2 * kSubBuckets get a bucket each; above that every power
+    // of two is split into kSubBuckets linear steps.
+    if (micros < 2 * kSubBuckets)
+        return int(micros);
+    int msb = 63;
+    while (!(micros >> msb))
+        --msb;
+    const int shift = msb - 4; // log2(kSubBuckets)
+    const int index = 2 * kSubBuckets + (shift - 1) * kSubBuckets
+                    + int((micros >> shift) - kSubBuckets);
+    return std::min(index, kBuckets - 1);
+}
+
+quint64 LatencyHistogram::bucketMidpoint(int index)
+{
+    if (index < 2 * kSubBuckets)
+        return quint64(index);
+    const int shift = (index - 2 * kSubBuckets) / kSubBuckets + 1;
+    const quint64 sub = quint64((index - 2 * kSubBuckets) % kSubBuckets + kSubBuckets);
+    return (sub << shift) + (quint64(1) << (shift - 1));
+}
+
+void LatencyHistogram::record(quint64 micros)
+{
+    m_buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sumMicros.fetch_add(micros, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::quantile(double q) const
+{
+    quint64 total = 0;
+    for (const auto &bucket : m_buckets)
+        total += bucket.load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    const quint64 rank = std::max<quint64>(1, quint64(std::ceil(q * double(total))));
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return bucketMidpoint(i);
+    }
+    return bucketMidpoint(kBuckets - 1);
+}
+
+// ── VpnMetrics ───────────────────────────────────────────────────────────────
+VpnMetrics::VpnMetrics()
+    : m_pollDuration(kLatencyBounds)
+    , m_roamingRecovery({ 0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0, 15.0, 25.0, 60.0 })
+    , m_uiLag({ 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5 })
+{
+    for (auto &h : m_connectPhases)
+        h = std::make_unique<MetricsHistogram>(kLatencyBounds);
+    for (auto &h : m_configApply)
+        h = std::make_unique<MetricsHistogram>(kLatencyBounds);
+}
+
+TunnelMetrics *VpnMetrics::tunnel(const QString &name)
+{
+    QMutexLocker lock(&m_tunnelsMutex);
+    auto &slot = m_tunnels[name];
+    if (!slot)
+        slot = std::make_unique<TunnelMetrics>();
+    return slot.get();
+}
+
+TunnelMetrics *VpnMetrics::bond(const QString &name)
+{
+    QMutexLocker lock(&m_tunnelsMutex);
+    auto &slot = m_bonds[name];
+    if (!slot)
+        slot = std::make_unique<TunnelMetrics>();
+    return slot.get();
+}
+
+void VpnMetrics::observeConnectPhase(ConnectPhase phase, double seconds)
+{
+    if (phase >= 0 && phase < PhaseCount)
+        m_connectPhases[phase]->observe(seconds);
+}
+
+void VpnMetrics::observeConfigApply(ApplyMode mode, double seconds)
+{
+    if (mode >= 0 && mode < ApplyModeCount)
+        m_configApply[mode]->observe(seconds);
+}
+
+QByteArray VpnMetrics::scrape() const
+{
+    static const char *const phaseNames[PhaseCount] = {
+        "resolve_config", "tunnel_up", "first_handshake", "total"
+    };
+
+    QByteArray out;
+    out.reserve(4096);
+
+    // Snapshot the tunnel list so the lock is not held while formatting.
+    using Entries = std::vector<std::pair<QByteArray, const TunnelMetrics *>>;
+    Entries tunnels, bonds;
+    {
+        QMutexLocker lock(&m_tunnelsMutex);
+        tunnels.reserve(m_tunnels.size());
+        for (const auto &entry : m_tunnels)
+            tunnels.emplace_back("tunnel=\"" + escapeLabel(entry.first) + '"', entry.second.get());
+        for (const auto &entry : m_bonds)
+            bonds.emplace_back("bond=\"" + escapeLabel(entry.first) + '"', entry.second.get());
+    }
+
+    auto counter = [&](const Entries &entries, const char *name, const char *help,
+                       const std::atomic<quint64> TunnelMetrics::*field) {
+        appendFamily(out, name, "counter", help);
+        const QByteArray sample = QByteArray(name) + "_total";
+        for (const auto &t : entries)
+            appendSample(out, sample, t.first,
+                         QByteArray::number((t.second->*field).load(std::memory_order_relaxed)));
+    };
+    auto perTunnelCounter = [&](const char *name, const char *help,
+                                const std::atomic<quint64> TunnelMetrics::*field) {
+        counter(tunnels, name, help, field);
+    };
+
+    perTunnelCounter("dkt_vpn_tunnel_rx_bytes", "Bytes received through the tunnel.",
+                     &TunnelMetrics::rxBytes);
+    perTunnelCounter("dkt_vpn_tunnel_tx_bytes", "Bytes sent through the tunnel.",
+                     &TunnelMetrics::txBytes);
+    perTunnelCounter("dkt_vpn_tunnel_connects", "Successful tunnel activations.",
+                     &TunnelMetrics::connects);
+    perTunnelCounter("dkt_vpn_tunnel_reconnects", "Activations after the first one.",
+                     &TunnelMetrics::reconnects);
+    perTunnelCounter("dkt_vpn_tunnel_connect_failures", "Failed tunnel activations.",
+                     &TunnelMetrics::connectFailures);
+
+    counter(bonds, "dkt_vpn_bond_rx_bytes", "Bytes received by all members of the bond.",
+            &TunnelMetrics::rxBytes);
+    counter(bonds, "dkt_vpn_bond_tx_bytes", "Bytes sent by all members of the bond.",
+            &TunnelMetrics::txBytes);
+    counter(bonds, "dkt_vpn_bond_connects", "Successful bond activations.",
+            &TunnelMetrics::connects);
+    counter(bonds, "dkt_vpn_bond_reconnects", "Bond activations after the first one.",
+            &TunnelMetrics::reconnects);
+    counter(bonds, "dkt_vpn_bond_connect_failures", "Failed bond activations.",
+            &TunnelMetrics::connectFailures);
+
+    appendFamily(out, "dkt_vpn_tunnel_handshake_age_seconds", "gauge",
+                 "Seconds since the latest handshake, absent before the first one.");
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    for (const auto &t : tunnels) {
+        const qint64 hs = t.second->latestHandshake.load(std::memory_order_relaxed);
+        if (hs > 0)
+            appendSample(out, "dkt_vpn_tunnel_handshake_age_seconds", t.first,
+                         QByteArray::number(std::max<qint64>(0, now - hs)));
+    }
+
+    appendFamily(out, "dkt_vpn_tunnel_rtt_seconds", "summary",
+                 "Round-trip time of in-tunnel probes.");
+    for (const auto &t : tunnels) {
+        const LatencyHistogram &rtt = t.second->rtt;
+        if (rtt.count() == 0)
+            continue;
+        for (double q : { 0.5, 0.9, 0.99, 0.999 })
+            appendSample(out, "dkt_vpn_tunnel_rtt_seconds",
+                         t.first + ",quantile=\"" + QByteArray::number(q, 'g', 6) + '"',
+                         QByteArray::number(rtt.quantile(q) / 1e6, 'f', 6));
+        appendSample(out, "dkt_vpn_tunnel_rtt_seconds_count", t.first,
+                     QByteArray::number(rtt.count()));
+        appendSample(out, "dkt_vpn_tunnel_rtt_seconds_sum", t.first,
+                     QByteArray::number(rtt.sumMicros() / 1e6, 'f', 6));
+    }
+    perTunnelCounter("dkt_vpn_tunnel_probes_sent", "In-tunnel probes sent.",
+                     &TunnelMetrics::probesSent);
+    perTunnelCounter("dkt_vpn_tunnel_probes_lost",
+                     "In-tunnel probes without a reply, once the target has answered.",
+                     &TunnelMetrics::probesLost);
+    appendFamily(out, "dkt_vpn_tunnel_probe_responding", "gauge",
+                 "1 once the probe target has answered, 0 while no reply has arrived.");
+    for (const auto &t : tunnels) {
+        if (t.second->probesSent.load(std::memory_order_relaxed) > 0)
+            appendSample(out, "dkt_vpn_tunnel_probe_responding", t.first,
+                         t.second->probeResponding.load(std::memory_order_relaxed) ? "1" : "0");
+    }
+    appendFamily(out, "dkt_vpn_tunnel_jitter_seconds", "gauge",
+                 "RFC 3550 jitter of the in-tunnel probe round trips.");
+    for (const auto &t : tunnels) {
+        if (t.second->probesSent.load(std::memory_order_relaxed) > 0)
+            appendSample(out, "dkt_vpn_tunnel_jitter_seconds", t.first,
+                         QByteArray::number(t.second->jitterMicros.load(std::memory_order_relaxed)
+                                            / 1e6, 'f', 6));
+    }
+
+    auto perQueueClass = [&](const char *name, const char *type, const char *help,
+                             const std::atomic<quint64> TunnelMetrics::QueueClass::*field,
+                             double scale) {
+        appendFamily(out, name, type, help);
+        const QByteArray sample = qstrcmp(type, "counter") == 0 ? QByteArray(name) + "_total"
+                                                                : QByteArray(name);
+        for (const auto &t : tunnels) {
+            const quint32 mask = t.second->queueClassMask.load(std::memory_order_relaxed);
+            for (int c = 0; c < TunnelMetrics::kQueueClasses; ++c) {
+                if (!(mask & (1u << c)))
+                    continue;
+                const quint64 value = (t.second->queue[c].*field).load(std::memory_order_relaxed);
+                appendSample(out, sample,
+                             t.first + ",class=\"" + TunnelMetrics::kQueueClassNames[c] + '"',
+                             scale == 1 ? QByteArray::number(value)
+                                        : QByteArray::number(double(value) * scale, 'f', 6));
+            }
+        }
+    };
+    appendFamily(out, "dkt_vpn_queue_shape_rate_bytes_per_second", "gauge",
+                 "Shaping rate of the tunnel's queue discipline, 0 when unshaped.");
+    for (const auto &t : tunnels) {
+        if (t.second->queueClassMask.load(std::memory_order_relaxed))
+            appendSample(out, "dkt_vpn_queue_shape_rate_bytes_per_second", t.first,
+                         QByteArray::number(t.second->queueRate.load(std::memory_order_relaxed)));
+    }
+    perQueueClass("dkt_vpn_queue_sent_bytes", "counter", "Bytes sent by each queue class.",
+                  &TunnelMetrics::QueueClass::sentBytes, 1);
+    perQueueClass("dkt_vpn_queue_drops", "counter", "Packets dropped by each queue class.",
+                  &TunnelMetrics::QueueClass::drops, 1);
+    perQueueClass("dkt_vpn_queue_ecn_marks", "counter", "Packets ECN-marked by each queue class.",
+                  &TunnelMetrics::QueueClass::ecnMarks, 1);
+    perQueueClass("dkt_vpn_queue_backlog_bytes", "gauge", "Bytes waiting in each queue class.",
+                  &TunnelMetrics::QueueClass::backlogBytes, 1);
+    perQueueClass("dkt_vpn_queue_delay_seconds", "gauge",
+                  "Average queueing delay of each class (cake only).",
+                  &TunnelMetrics::QueueClass::delayMicros, 1e-6);
+
+    appendFamily(out, "dkt_vpn_connect_phase_seconds", "histogram",
+                 "Latency of each connect phase.");
+    for (int p = 0; p < PhaseCount; ++p)
+        m_connectPhases[p]->format(out, "dkt_vpn_connect_phase_seconds",
+                                   QByteArray("phase=\"") + phaseNames[p] + '"');
+
+    appendFamily(out, "dkt_vpn_poll_duration_seconds", "histogram",
+                 "Wall time of one statistics poll.");
+    m_pollDuration.format(out, "dkt_vpn_poll_duration_seconds", {});
+
+    appendFamily(out, "dkt_vpn_process_spawns", "counter",
+                 "External processes started by the client.");
+    appendSample(out, "dkt_vpn_process_spawns_total", {},
+                 QByteArray::number(m_processSpawns.load(std::memory_order_relaxed)));
+
+    appendFamily(out, "dkt_vpn_network_changes", "counter",
+                 "Debounced network changes seen while connected.");
+    appendSample(out, "dkt_vpn_network_changes_total", {},
+                 QByteArray::number(m_networkChanges.load(std::memory_order_relaxed)));
+
+    appendFamily(out, "dkt_vpn_roaming_recovery_seconds", "histogram",
+                 "Time from a network change until the tunnel carries traffic again.");
+    m_roamingRecovery.format(out, "dkt_vpn_roaming_recovery_seconds", {});
+
+    static const char *const applyModes[ApplyModeCount] = { "live", "restart" };
+    appendFamily(out, "dkt_vpn_config_apply_seconds", "histogram",
+                 "Time from a config edit being noticed until it is in effect.");
+    for (int m = 0; m < ApplyModeCount; ++m)
+        m_configApply[m]->format(out, "dkt_vpn_config_apply_seconds",
+                                 QByteArray("mode=\"") + applyModes[m] + '"');
+
+    appendFamily(out, "dkt_vpn_ui_event_loop_lag_seconds", "histogram",
+                 "How late a 100 ms UI timer fired; large values are visible stalls.");
+    m_uiLag.format(out, "dkt_vpn_ui_event_loop_lag_seconds", {});
+
+    out += "# EOF\n";
+    return out;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <array>
+#include <atomic>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Fixed-bucket histogram. observe() is a couple of relaxed atomic adds so it
+ * can be called from any thread on the hot path; the cumulative bucket view
+ * is only built when the histogram is formatted.
+ */
+class MetricsHistogram
+{
+public:
+    explicit MetricsHistogram(std::initializer_list<double> upperBounds);
+
+    void observe(double value);
+
+    /// Appends the OpenMetrics samples (`_bucket`, `_count`, `_sum`) for this
+    /// histogram. @p labels is either empty or `key="value"` pairs without braces.
+    void format(QByteArray &out, const QByteArray &name, const QByteArray &labels) const;
+
+private:
+    std::vector<double>                      m_bounds;
+    std::unique_ptr<std::atomic<quint64>[]>  m_buckets; ///< m_bounds.size() + 1 (+Inf)
+    std::atomic<quint64>                     m_sumMicros { 0 };
+};
+
+/**
+ * HDR-style latency histogram: log-linear buckets with 16 sub-buckets per
+ * power of two, so any recorded value is reproduced within ~3 % over the
+ * whole 1 µs … 67 s range. Like MetricsHistogram, record() is lock-free.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBuckets = 16;
+    static constexpr int kBuckets    = 2 * kSubBuckets + 21 * kSubBuckets; ///< up to 2^26 µs
+
+    void    record(quint64 micros);
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 sumMicros() const { return m_sumMicros.load(std::memory_order_relaxed); }
+    /// Value at quantile @p q (0..1) in µs, 0 when empty.
+    quint64 quantile(double q) const;
+
+private:
+    static int     bucketFor(quint64 micros);
+    static quint64 bucketMidpoint(int index);
+
+    std::atomic<quint64> m_buckets[kBuckets] {};
+    std::atomic<quint64> m_count { 0 };
+    std::atomic<quint64> m_sumMicros { 0 };
+};
+
+/// Counters for a single WireGuard interface.
+struct TunnelMetrics {
+    std::atomic<quint64> rxBytes { 0 };            ///< last value reported by wg
+    std::atomic<quint64> txBytes { 0 };
+    std::atomic<qint64>  latestHandshake { 0 };    ///< Unix seconds, 0 = never
+    std::atomic<quint64> connects { 0 };
+    std::atomic<quint64> reconnects { 0 };
+    std::atomic<quint64> connectFailures { 0 };
+
+    // In-tunnel probing (LatencyProber)
+    LatencyHistogram     rtt;
+    std::atomic<quint64> probesSent { 0 };
+    std::atomic<quint64> probesLost { 0 };         ///< counted once the target has answered
+    std::atomic<bool>    probeResponding { false }; ///< the probe target has answered
+    std::atomic<quint64> jitterMicros { 0 };       ///< RFC 3550 interarrival jitter
+
+    // Queue discipline on the tunnel (QueueShaper). Class slots follow
+    // cake's diffserv4 tins; an unclassified qdisc reports best_effort.
+    static constexpr int kQueueClasses = 4;
+    static constexpr const char *kQueueClassNames[kQueueClasses] = {
+        "bulk", "best_effort", "video", "voice"
+    };
+    struct QueueClass {
+        std::atomic<quint64> sentBytes { 0 };
+        std::atomic<quint64> drops { 0 };
+        std::atomic<quint64> ecnMarks { 0 };
+        std::atomic<quint64> backlogBytes { 0 };
+        std::atomic<quint64> delayMicros { 0 };    ///< average queueing delay (cake)
+    };
+    std::array<QueueClass, kQueueClasses> queue;
+    std::atomic<quint32> queueClassMask { 0 };     ///< bit per slot in the latest sample
+    std::atomic<quint64> queueRate { 0 };          ///< shaping rate, bytes/s; 0 = unshaped
+
+    /// Forgets the queue series; called whenever a new qdisc is set up.
+    void resetQueue()
+    {
+        for (QueueClass &q : queue) {
+            q.sentBytes.store(0, std::memory_order_relaxed);
+            q.drops.store(0, std::memory_order_relaxed);
+            q.ecnMarks.store(0, std::memory_order_relaxed);
+            q.backlogBytes.store(0, std::memory_order_relaxed);
+            q.delayMicros.store(0, std::memory_order_relaxed);
+        }
+        queueClassMask.store(0, std::memory_order_relaxed);
+        queueRate.store(0, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * VpnMetrics collects client and per-tunnel performance metrics.
+ *
+ * All updates are lock-free atomics. The only lock guards creation of a
+ * tunnel entry; callers keep the returned TunnelMetrics pointer, which stays
+ * valid for the lifetime of the VpnMetrics object. Text formatting happens
+ * only in scrape().
+ */
+class VpnMetrics
+{
+public:
+    /// Phases of a connect attempt, each with its own latency histogram.
+    enum ConnectPhase {
+        PhaseResolveConfig,   ///< locating / preparing the .conf
+        PhaseTunnelUp,        ///< spawning the tunnel command until it exits
+        PhaseFirstHandshake,  ///< tunnel up until the first handshake is seen
+        PhaseTotal,           ///< connect click until first handshake
+        PhaseCount
+    };
+
+    /// How an edited config was applied to a running tunnel.
+    enum ApplyMode {
+        ApplyLive,            ///< wg syncconf + route delta
+        ApplyRestart,         ///< tunnel down and up again
+        ApplyModeCount
+    };
+
+    VpnMetrics();
+
+    TunnelMetrics *tunnel(const QString &name);
+    /// Aggregate entry of a bond. It is exported as dkt_vpn_bond_*{bond=…},
+    /// apart from the member tunnels, so sums over tunnels count bytes once.
+    TunnelMetrics *bond(const QString &name);
+
+    void observeConnectPhase(ConnectPhase phase, double seconds);
+    void observePollDuration(double seconds) { m_pollDuration.observe(seconds); }
+    void countProcessSpawn() { m_processSpawns.fetch_add(1, std::memory_order_relaxed); }
+    void countNetworkChange() { m_networkChanges.fetch_add(1, std::memory_order_relaxed); }
+    void observeRoamingRecovery(double seconds) { m_roamingRecovery.observe(seconds); }
+    void observeUiLag(double seconds) { m_uiLag.observe(seconds); }
+    void observeConfigApply(ApplyMode mode, double seconds);
+
+    /// Renders every metric as OpenMetrics text, terminated by `# EOF`.
+    QByteArray scrape() const;
+
+private:
+    mutable QMutex                                         m_tunnelsMutex;
+    std::map<QString, std::unique_ptr<TunnelMetrics>>      m_tunnels;
+    std::map<QString, std::unique_ptr<TunnelMetrics>>      m_bonds;
+
+    std::array<std::unique_ptr<MetricsHistogram>, PhaseCount> m_connectPhases;
+    MetricsHistogram     m_pollDuration;
+    MetricsHistogram     m_roamingRecovery;
+    MetricsHistogram     m_uiLag;
+    std::array<std::unique_ptr<MetricsHistogram>, ApplyModeCount> m_configApply;
+    std::atomic<quint64> m_processSpawns { 0 };
+    std::atomic<quint64> m_networkChanges { 0 };
+};
@@ -0,0 +1,74 @@
+#include "metricsserver.h"
+#include "metrics.h"
+
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace {
+constexpr int kMaxRequestSize = 8192;
+}
+
+MetricsServer::MetricsServer(const VpnMetrics *metrics, QObject *parent)
+    : QObject(parent)
+    , m_metrics(metrics)
+    , m_server(new QTcpServer(this))
+{
+    connect(m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+    return m_server->listen(QHostAddress::LocalHost, port);
+}
+
+quint16 MetricsServer::port() const
+{
+    return m_server->serverPort();
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            QByteArray &buf = m_pending[socket];
+            buf += socket->readAll();
+            if (buf.contains("\r\n\r\n") || buf.size() > kMaxRequestSize)
+                handleRequest(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_pending.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket)
+{
+    const QByteArray request = m_pending.take(socket);
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+
+    QByteArray status = "200 OK";
+    QByteArray contentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    QByteArray body;
+
+    if (requestLine.size() < 2 || requestLine[0] != "GET") {
+        status = "405 Method Not Allowed";
+        contentType = "text/plain";
+        body = "Only GET is supported\n";
+    } else if (requestLine[1] != "/metrics") {
+        status = "404 Not Found";
+        contentType = "text/plain";
+        body = "Try /metrics\n";
+    } else {
+        body = m_metrics->scrape();
+    }
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: " + contentType + "\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
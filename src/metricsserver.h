@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QByteArray>
+
+class QTcpServer;
+class QTcpSocket;
+class VpnMetrics;
+
+/**
+ * MetricsServer serves VpnMetrics as OpenMetrics text over plain HTTP on the
+ * loopback interface (`GET /metrics`). It is opt-in: MainWindow only starts it
+ * when DKT_VPN_METRICS_PORT is set.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(const VpnMetrics *metrics, QObject *parent = nullptr);
+
+    /// Binds to 127.0.0.1:@p port. Returns false if the port is unavailable.
+    bool listen(quint16 port);
+    quint16 port() const;
+
+private slots:
+    void onNewConnection();
+
+private:
+    void handleRequest(QTcpSocket *socket);
+
+    const VpnMetrics         *m_metrics = nullptr;
+    QTcpServer               *m_server  = nullptr;
+    QHash<QTcpSocket *, QByteArray> m_pending; ///< partially received requests
+};
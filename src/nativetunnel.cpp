@@ -0,0 +1,1076 @@
+#include "nativetunnel.h"
+#include "cidrset.h"
+
+#include <QFile>
+#include <QHostAddress>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringList>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#  include <linux/capability.h>
+#  include <linux/fib_rules.h>
+#  include <linux/genetlink.h>
+#  include <linux/netlink.h>
+#  include <linux/rtnetlink.h>
+#  include <linux/wireguard.h>
+#  include <net/if.h>
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+// Requests are split well below the default socket buffer sizes; large
+// split-tunnel AllowedIPs lists take several WG_CMD_SET_DEVICE messages.
+constexpr int kMaxRequest = 16384;
+// Messages per batched datagram. Each one is answered by an ack of its own,
+// and a few hundred of those overflow the default receive buffer (ENOBUFS).
+constexpr int kMaxBatch = 64;
+
+/// One netlink request. Nested attributes are opened with begin() and
+/// closed with end().
+class NlRequest
+{
+public:
+    NlRequest(quint16 type, int flags)
+    {
+        nlmsghdr header {};
+        header.nlmsg_type  = type;
+        header.nlmsg_flags = quint16(NLM_F_REQUEST | NLM_F_ACK | flags);
+        append(&header, sizeof(header));
+    }
+
+    /// The family header (ifinfomsg, rtmsg, genlmsghdr …) following nlmsghdr.
+    template <typename T>
+    void payload(const T &value) { append(&value, sizeof(value)); }
+
+    void attr(quint16 type, const void *data, size_t size)
+    {
+        nlattr a {};
+        a.nla_type = type;
+        a.nla_len  = quint16(NLA_HDRLEN + size);
+        append(&a, sizeof(a));
+        append(data, size);
+    }
+    void attrU16(quint16 type, quint16 value) { attr(type, &value, sizeof(value)); }
+    void attrU32(quint16 type, quint32 value) { attr(type, &value, sizeof(value)); }
+    void attrU8(quint16 type, quint8 value)   { attr(type, &value, sizeof(value)); }
+    void attrString(quint16 type, const QByteArray &s)
+    {
+        attr(type, s.constData(), size_t(s.size()) + 1); // with the terminating NUL
+    }
+
+    int begin(quint16 type)
+    {
+        const int offset = size();
+        nlattr a {};
+        a.nla_type = quint16(type | NLA_F_NESTED);
+        append(&a, sizeof(a));
+        return offset;
+    }
+    void end(int offset)
+    {
+        auto *a = reinterpret_cast<nlattr *>(m_buffer.data() + offset);
+        a->nla_len = quint16(size() - offset);
+    }
+
+    int size() const { return int(m_buffer.size()); }
+
+    const QByteArray &finish(quint32 sequence)
+    {
+        auto *header = reinterpret_cast<nlmsghdr *>(m_buffer.data());
+        header->nlmsg_len = quint32(m_buffer.size());
+        header->nlmsg_seq = sequence;
+        return m_buffer;
+    }
+
+private:
+    void append(const void *data, size_t size)
+    {
+        m_buffer.append(static_cast<const char *>(data), qsizetype(size));
+        m_buffer.append(qsizetype(NLA_ALIGN(size) - size), '\0');
+    }
+
+    QByteArray m_buffer;
+};
+
+/// Blocking netlink socket for request / acknowledgement exchanges.
+class NlSocket
+{
+public:
+    explicit NlSocket(int protocol)
+        : m_fd(::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol))
+    {
+        if (m_fd < 0)
+            return;
+        // A kernel that never answers must not hang the manager's thread.
+        timeval timeout { 2, 0 };
+        ::setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    ~NlSocket()
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+    NlSocket(const NlSocket &) = delete;
+    NlSocket &operator=(const NlSocket &) = delete;
+
+    bool isOpen() const { return m_fd >= 0; }
+
+    /// Sends @p request and waits for its acknowledgement. The first reply
+    /// message before it, if any, is stored in @p reply. Returns 0 or a
+    /// negative errno.
+    int transact(NlRequest &request, QByteArray *reply = nullptr)
+    {
+        const quint32 sequence = ++m_sequence;
+        const QByteArray &message = request.finish(sequence);
+        if (::send(m_fd, message.constData(), size_t(message.size()), 0) < 0)
+            return -errno;
+
+        int result = 1;
+        while (result > 0) {
+            const int rc = receive([&](const nlmsghdr *nh) {
+                if (nh->nlmsg_seq != sequence || result <= 0)
+                    return;
+                if (nh->nlmsg_type == NLMSG_ERROR)
+                    result = static_cast<const nlmsgerr *>(NLMSG_DATA(nh))->error;
+                else if (reply && reply->isEmpty())
+                    *reply = QByteArray(reinterpret_cast<const char *>(nh), qsizetype(nh->nlmsg_len));
+            });
+            if (rc < 0)
+                return rc;
+        }
+        return result;
+    }
+
+    /// Sends @p requests packed into as few datagrams as kMaxRequest allows
+    /// and collects every acknowledgement. The kernel handles each message
+    /// on its own, so @p results gets 0 or a negative errno per request.
+    /// Returns 0, or a negative errno if the socket itself failed.
+    int transactAll(std::vector<NlRequest> &requests, std::vector<int> *results)
+    {
+        results->assign(requests.size(), 1); // 1 = not acknowledged yet
+        size_t next = 0;
+        while (next < requests.size()) {
+            // One datagram at a time, so the acks fit in the receive buffer.
+            const size_t first = next;
+            const quint32 firstSequence = m_sequence + 1;
+            QByteArray batch;
+            while (next < requests.size() && next - first < size_t(kMaxBatch)
+                   && (batch.isEmpty() || batch.size() + requests[next].size() <= kMaxRequest))
+                batch += requests[next++].finish(++m_sequence);
+            if (::send(m_fd, batch.constData(), size_t(batch.size()), 0) < 0)
+                return -errno;
+
+            size_t pending = next - first;
+            while (pending > 0) {
+                const int rc = receive([&](const nlmsghdr *nh) {
+                    const quint32 offset = nh->nlmsg_seq - firstSequence;
+                    if (nh->nlmsg_type != NLMSG_ERROR || offset >= next - first)
+                        return;
+                    int &result = (*results)[first + offset];
+                    if (result > 0) {
+                        result = static_cast<const nlmsgerr *>(NLMSG_DATA(nh))->error;
+                        --pending;
+                    }
+                });
+                if (rc < 0)
+                    return rc;
+            }
+        }
+        return 0;
+    }
+
+    /// Sends the dump @p request and calls @p visit(nlmsghdr *) for every
+    /// entry. Returns 0 or a negative errno.
+    template <typename Visit>
+    int dump(NlRequest &request, Visit visit)
+    {
+        const quint32 sequence = ++m_sequence;
+        const QByteArray &message = request.finish(sequence);
+        if (::send(m_fd, message.constData(), size_t(message.size()), 0) < 0)
+            return -errno;
+
+        int result = 1;
+        while (result > 0) {
+            const int rc = receive([&](const nlmsghdr *nh) {
+                if (nh->nlmsg_seq != sequence || result <= 0)
+                    return;
+                if (nh->nlmsg_type == NLMSG_DONE)
+                    result = 0;
+                else if (nh->nlmsg_type == NLMSG_ERROR)
+                    result = static_cast<const nlmsgerr *>(NLMSG_DATA(nh))->error;
+                else
+                    visit(nh);
+            });
+            if (rc < 0)
+                return rc;
+        }
+        return result;
+    }
+
+private:
+    /// Reads one datagram and calls @p handle for each message in it.
+    template <typename Handle>
+    int receive(Handle handle)
+    {
+        alignas(nlmsghdr) char buffer[32768];
+        ssize_t len;
+        do {
+            len = ::recv(m_fd, buffer, sizeof(buffer), 0);
+        } while (len < 0 && errno == EINTR);
+        if (len < 0)
+            return errno == EAGAIN ? -ETIMEDOUT : -errno;
+        int remaining = int(len);
+        for (auto *nh = reinterpret_cast<const nlmsghdr *>(buffer); NLMSG_OK(nh, remaining);
+             nh = NLMSG_NEXT(nh, remaining))
+            handle(nh);
+        return 0;
+    }
+
+    int     m_fd;
+    quint32 m_sequence = 0;
+};
+
+/// Calls @p visit(type, data, size) for every attribute in @p data.
+template <typename Visit>
+void forEachAttr(const char *data, int size, Visit visit)
+{
+    while (size >= int(NLA_HDRLEN)) {
+        const auto *a = reinterpret_cast<const nlattr *>(data);
+        if (a->nla_len < NLA_HDRLEN || int(a->nla_len) > size)
+            break;
+        visit(quint16(a->nla_type & NLA_TYPE_MASK), data + NLA_HDRLEN, int(a->nla_len - NLA_HDRLEN));
+        const int step = int(NLA_ALIGN(a->nla_len));
+        data += step;
+        size -= step;
+    }
+}
+
+/// Attributes of a reply message whose family header is a @p Header.
+template <typename Header, typename Visit>
+void forEachReplyAttr(const QByteArray &reply, Visit visit)
+{
+    const int offset = int(NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(Header)));
+    if (reply.size() > offset)
+        forEachAttr(reply.constData() + offset, int(reply.size()) - offset, visit);
+}
+
+quint32 readU32(const char *data, int size)
+{
+    quint32 value = 0;
+    if (size >= int(sizeof(value)))
+        std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+QString errorText(const char *step, int rc)
+{
+    return QStringLiteral("%1: %2").arg(QLatin1String(step),
+                                        QString::fromLocal8Bit(std::strerror(-rc)));
+}
+
+bool invalid(QString *error, const QString &key, const QString &value)
+{
+    *error = QStringLiteral("Invalid %1: %2").arg(key, value);
+    return false;
+}
+
+// ── Parsed config ────────────────────────────────────────────────────────────
+/// An interface address; unlike CidrPrefix the host bits are kept.
+struct InterfaceAddress {
+    bool                   v6 = false;
+    std::array<quint8, 16> addr {};
+    int                    length = 0;
+};
+
+struct PeerPlan {
+    QByteArray        publicKey;
+    QByteArray        presharedKey;
+    sockaddr_storage  endpoint {};
+    socklen_t         endpointLength = 0;   ///< 0 = no endpoint
+    int               keepalive = -1;       ///< -1 = not set
+    QList<CidrPrefix> allowedIps;
+};
+
+struct DevicePlan {
+    QByteArray              privateKey;
+    int                     listenPort = -1;
+    quint32                 fwMark = 0;     ///< 0 = off
+    QList<InterfaceAddress> addresses;
+    int                     mtu = 0;        ///< 0 = derive from the endpoints
+    quint32                 table = 0;      ///< 0 = auto
+    bool                    tableOff = false;
+    QList<PeerPlan>         peers;
+};
+
+bool decodeKey(const QString &text, QByteArray *out)
+{
+    const auto decoded = QByteArray::fromBase64Encoding(text.trimmed().toLatin1(),
+                                                        QByteArray::AbortOnBase64DecodingErrors);
+    if (!decoded || decoded.decoded.size() != WG_KEY_LEN)
+        return false;
+    *out = decoded.decoded;
+    return true;
+}
+
+/// wg-quick's Table: empty/auto → 0, off, main, or a numeric id.
+/// Names from /etc/iproute2/rt_tables are not resolved.
+bool parseTable(const QString &value, quint32 *table, bool *off)
+{
+    *table = 0;
+    *off = false;
+    if (value.isEmpty() || value.compare("auto", Qt::CaseInsensitive) == 0)
+        return true;
+    if (value.compare("off", Qt::CaseInsensitive) == 0) {
+        *off = true;
+        return true;
+    }
+    if (value.compare("main", Qt::CaseInsensitive) == 0) {
+        *table = RT_TABLE_MAIN;
+        return true;
+    }
+    bool ok = false;
+    *table = value.toUInt(&ok);
+    return ok && *table != 0;
+}
+
+bool parseInterfaceAddress(const QString &text, InterfaceAddress *out)
+{
+    const QString trimmed = text.trimmed();
+    const int slash = trimmed.indexOf('/');
+    bool ok = false;
+    const CidrPrefix host = CidrPrefix::host(slash < 0 ? trimmed : trimmed.left(slash), &ok);
+    if (!ok)
+        return false;
+    out->v6     = host.v6;
+    out->addr   = host.addr;
+    out->length = host.maxLength();
+    if (slash >= 0) {
+        out->length = trimmed.mid(slash + 1).toInt(&ok);
+        if (!ok || out->length < 0 || out->length > host.maxLength())
+            return false;
+    }
+    return true;
+}
+
+bool resolveEndpoint(const QString &endpoint, PeerPlan *peer, QString *error)
+{
+    QString host;
+    quint16 port = 0;
+    if (!TunnelConfig::splitEndpoint(endpoint, &host, &port))
+        return invalid(error, QStringLiteral("Endpoint"), endpoint);
+
+    addrinfo hints {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    addrinfo *result = nullptr;
+    const int rc = ::getaddrinfo(host.toUtf8().constData(), QByteArray::number(port).constData(),
+                                 &hints, &result);
+    if (rc != 0 || !result) {
+        *error = QStringLiteral("Cannot resolve %1: %2")
+                     .arg(host, QString::fromLocal8Bit(::gai_strerror(rc)));
+        return false;
+    }
+    std::memcpy(&peer->endpoint, result->ai_addr, result->ai_addrlen);
+    peer->endpointLength = result->ai_addrlen;
+    ::freeaddrinfo(result);
+    return true;
+}
+
+/// Validates and resolves everything up front, so a bad config fails
+/// before the kernel has been touched.
+bool parsePlan(const TunnelConfig &config, DevicePlan *plan, QString *error)
+{
+    const TunnelConfig::Section *iface = config.interfaceSection();
+    if (!iface || !decodeKey(iface->value("PrivateKey"), &plan->privateKey))
+        return invalid(error, QStringLiteral("PrivateKey"), QStringLiteral("(missing or malformed)"));
+
+    bool ok = true;
+    const QString port = iface->value("ListenPort");
+    if (!port.isEmpty()) {
+        plan->listenPort = port.toUShort(&ok);
+        if (!ok)
+            return invalid(error, QStringLiteral("ListenPort"), port);
+    }
+    const QString mark = iface->value("FwMark");
+    if (!mark.isEmpty() && mark.compare("off", Qt::CaseInsensitive) != 0) {
+        plan->fwMark = mark.toUInt(&ok, 0);
+        if (!ok)
+            return invalid(error, QStringLiteral("FwMark"), mark);
+    }
+    for (const QString &text : iface->list("Address")) {
+        InterfaceAddress address;
+        if (!parseInterfaceAddress(text, &address))
+            return invalid(error, QStringLiteral("Address"), text);
+        plan->addresses << address;
+    }
+    const QString mtu = iface->value("MTU");
+    if (!mtu.isEmpty()) {
+        plan->mtu = mtu.toInt(&ok);
+        if (!ok || plan->mtu <= 0)
+            return invalid(error, QStringLiteral("MTU"), mtu);
+    }
+    if (!parseTable(iface->value("Table"), &plan->table, &plan->tableOff))
+        return invalid(error, QStringLiteral("Table"), iface->value("Table"));
+
+    for (const TunnelConfig::Section *section : config.peers()) {
+        PeerPlan peer;
+        if (!decodeKey(section->value("PublicKey"), &peer.publicKey))
+            return invalid(error, QStringLiteral("PublicKey"), section->value("PublicKey"));
+        const QString psk = section->value("PresharedKey");
+        if (!psk.isEmpty() && !decodeKey(psk, &peer.presharedKey))
+            return invalid(error, QStringLiteral("PresharedKey"), QStringLiteral("(malformed)"));
+        const QString endpoint = section->value("Endpoint");
+        if (!endpoint.isEmpty() && !resolveEndpoint(endpoint, &peer, error))
+            return false;
+        const QString keepalive = section->value("PersistentKeepalive");
+        if (!keepalive.isEmpty()) {
+            peer.keepalive = keepalive.compare("off", Qt::CaseInsensitive) == 0
+                           ? 0 : keepalive.toUShort(&ok);
+            if (!ok)
+                return invalid(error, QStringLiteral("PersistentKeepalive"), keepalive);
+        }
+        for (const QString &allowed : section->list("AllowedIPs")) {
+            CidrPrefix prefix;
+            if (!CidrPrefix::parse(allowed, &prefix))
+                return invalid(error, QStringLiteral("AllowedIPs"), allowed);
+            peer.allowedIps << prefix;
+        }
+        plan->peers << peer;
+    }
+    return true;
+}
+
+// ── Requests ─────────────────────────────────────────────────────────────────
+int createLink(NlSocket &socket, const QByteArray &name)
+{
+    NlRequest request(RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL);
+    ifinfomsg ifi {};
+    ifi.ifi_family = AF_UNSPEC;
+    request.payload(ifi);
+    request.attrString(IFLA_IFNAME, name);
+    const int info = request.begin(IFLA_LINKINFO);
+    request.attrString(IFLA_INFO_KIND, "wireguard");
+    request.end(info);
+    return socket.transact(request);
+}
+
+int deleteLink(NlSocket &socket, int ifindex)
+{
+    NlRequest request(RTM_DELLINK, 0);
+    ifinfomsg ifi {};
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_index  = ifindex;
+    request.payload(ifi);
+    return socket.transact(request);
+}
+
+NlRequest linkUpRequest(int ifindex, int mtu)
+{
+    NlRequest request(RTM_NEWLINK, 0);
+    ifinfomsg ifi {};
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_index  = ifindex;
+    ifi.ifi_flags  = IFF_UP;
+    ifi.ifi_change = IFF_UP;
+    request.payload(ifi);
+    request.attrU32(IFLA_MTU, quint32(mtu));
+    return request;
+}
+
+NlRequest addressRequest(int ifindex, const InterfaceAddress &address)
+{
+    NlRequest request(RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL);
+    ifaddrmsg ifa {};
+    ifa.ifa_family    = address.v6 ? AF_INET6 : AF_INET;
+    ifa.ifa_prefixlen = quint8(address.length);
+    ifa.ifa_index     = quint32(ifindex);
+    request.payload(ifa);
+    const size_t size = address.v6 ? 16 : 4;
+    request.attr(IFA_LOCAL, address.addr.data(), size);
+    request.attr(IFA_ADDRESS, address.addr.data(), size);
+    return request;
+}
+
+/// `ip route add`: an existing route for the prefix is an error (EEXIST),
+/// never overwritten.
+NlRequest routeRequest(int ifindex, const CidrPrefix &prefix, quint32 table)
+{
+    NlRequest request(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL);
+    rtmsg rtm {};
+    rtm.rtm_family   = prefix.v6 ? AF_INET6 : AF_INET;
+    rtm.rtm_dst_len  = quint8(prefix.length);
+    rtm.rtm_table    = table < 256 ? quint8(table) : quint8(RT_TABLE_UNSPEC);
+    rtm.rtm_protocol = RTPROT_BOOT;
+    rtm.rtm_scope    = RT_SCOPE_LINK;
+    rtm.rtm_type     = RTN_UNICAST;
+    request.payload(rtm);
+    if (prefix.length > 0)
+        request.attr(RTA_DST, prefix.addr.data(), prefix.v6 ? 16 : 4);
+    request.attrU32(RTA_OIF, quint32(ifindex));
+    request.attrU32(RTA_TABLE, table);
+    return request;
+}
+
+/// "not fwmark T table T", or "table main suppress_prefixlength 0".
+NlRequest ruleRequest(int type, int family, quint32 table, bool suppressMain)
+{
+    NlRequest request(quint16(type), type == RTM_NEWRULE ? NLM_F_CREATE | NLM_F_EXCL : 0);
+    fib_rule_hdr hdr {};
+    hdr.family = quint8(family);
+    hdr.action = FR_ACT_TO_TBL;
+    hdr.table  = table < 256 ? quint8(table) : quint8(RT_TABLE_UNSPEC);
+    hdr.flags  = suppressMain ? 0 : FIB_RULE_INVERT;
+    request.payload(hdr);
+    request.attrU32(FRA_TABLE, table);
+    if (suppressMain)
+        request.attrU32(FRA_SUPPRESS_PREFIXLEN, 0);
+    else
+        request.attrU32(FRA_FWMARK, table);
+    return request;
+}
+
+/// Calls @p visit(table, oif, prefix) for every IPv4 and IPv6 route in
+/// every table (`ip route show table all`).
+template <typename Visit>
+int forEachRoute(NlSocket &socket, Visit visit)
+{
+    NlRequest request(RTM_GETROUTE, NLM_F_DUMP);
+    rtmsg rtm {};
+    rtm.rtm_family = AF_UNSPEC;
+    request.payload(rtm);
+    return socket.dump(request, [&](const nlmsghdr *nh) {
+        const int header = int(NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(rtmsg)));
+        if (nh->nlmsg_type != RTM_NEWROUTE || int(nh->nlmsg_len) < header)
+            return;
+        const auto *route = static_cast<const rtmsg *>(NLMSG_DATA(nh));
+        if (route->rtm_family != AF_INET && route->rtm_family != AF_INET6)
+            return;
+        CidrPrefix prefix;
+        prefix.v6     = route->rtm_family == AF_INET6;
+        prefix.length = route->rtm_dst_len;
+        quint32 table = route->rtm_table;
+        int oif = 0;
+        forEachAttr(reinterpret_cast<const char *>(nh) + header, int(nh->nlmsg_len) - header,
+                    [&](quint16 type, const char *data, int size) {
+            if (type == RTA_TABLE)
+                table = readU32(data, size);
+            else if (type == RTA_OIF)
+                oif = int(readU32(data, size));
+            else if (type == RTA_DST)
+                std::memcpy(prefix.addr.data(), data, size_t(std::min(size, 16)));
+        });
+        visit(table, oif, prefix);
+    });
+}
+
+/// True if @p outer contains every address of @p inner.
+bool covers(const CidrPrefix &outer, const CidrPrefix &inner)
+{
+    if (outer.v6 != inner.v6 || outer.length > inner.length)
+        return false;
+    const int bytes = outer.length / 8;
+    if (std::memcmp(outer.addr.data(), inner.addr.data(), size_t(bytes)) != 0)
+        return false;
+    const int bits = outer.length % 8;
+    const quint8 mask = quint8(0xFF << (8 - bits));
+    return bits == 0 || (outer.addr[bytes] & mask) == (inner.addr[bytes] & mask);
+}
+
+int linkMtu(NlSocket &socket, int ifindex)
+{
+    NlRequest request(RTM_GETLINK, 0);
+    ifinfomsg ifi {};
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_index  = ifindex;
+    request.payload(ifi);
+    QByteArray reply;
+    if (socket.transact(request, &reply) < 0)
+        return 0;
+    int mtu = 0;
+    forEachReplyAttr<ifinfomsg>(reply, [&](quint16 type, const char *data, int size) {
+        if (type == IFLA_MTU)
+            mtu = int(readU32(data, size));
+    });
+    return mtu;
+}
+
+/// MTU of the route to @p endpoint, else of its outgoing link (`ip route get`).
+int routeMtu(NlSocket &socket, const sockaddr_storage &endpoint)
+{
+    const bool v6 = endpoint.ss_family == AF_INET6;
+    NlRequest request(RTM_GETROUTE, 0);
+    rtmsg rtm {};
+    rtm.rtm_family  = quint8(endpoint.ss_family);
+    rtm.rtm_dst_len = v6 ? 128 : 32;
+    request.payload(rtm);
+    if (v6)
+        request.attr(RTA_DST, &reinterpret_cast<const sockaddr_in6 &>(endpoint).sin6_addr, 16);
+    else
+        request.attr(RTA_DST, &reinterpret_cast<const sockaddr_in &>(endpoint).sin_addr, 4);
+
+    QByteArray reply;
+    if (socket.transact(request, &reply) < 0)
+        return 0;
+    int mtu = 0;
+    int oif = 0;
+    forEachReplyAttr<rtmsg>(reply, [&](quint16 type, const char *data, int size) {
+        if (type == RTA_OIF) {
+            oif = int(readU32(data, size));
+        } else if (type == RTA_METRICS) {
+            forEachAttr(data, size, [&](quint16 metric, const char *value, int valueSize) {
+                if (metric == RTAX_MTU)
+                    mtu = int(readU32(value, valueSize));
+            });
+        }
+    });
+    return mtu > 0 || oif <= 0 ? mtu : linkMtu(socket, oif);
+}
+
+int wireguardFamily(NlSocket &socket)
+{
+    NlRequest request(GENL_ID_CTRL, 0);
+    genlmsghdr genl {};
+    genl.cmd     = CTRL_CMD_GETFAMILY;
+    genl.version = 1;
+    request.payload(genl);
+    request.attrString(CTRL_ATTR_FAMILY_NAME, WG_GENL_NAME);
+    QByteArray reply;
+    const int rc = socket.transact(request, &reply);
+    if (rc < 0)
+        return rc;
+    int family = -ENOENT;
+    forEachReplyAttr<genlmsghdr>(reply, [&](quint16 type, const char *data, int size) {
+        if (type == CTRL_ATTR_FAMILY_ID && size >= 2) {
+            quint16 id = 0;
+            std::memcpy(&id, data, sizeof(id));
+            family = id;
+        }
+    });
+    return family;
+}
+
+/// WG_CMD_SET_DEVICE, split over as many messages as the peers' AllowedIPs
+/// need and sent as one batch. Only the first message replaces the peer
+/// list, and only the first part of each peer replaces its AllowedIPs.
+int setDevice(NlSocket &socket, quint16 family, const QByteArray &name, const DevicePlan &plan)
+{
+    std::vector<NlRequest> requests;
+    qsizetype peer = 0;
+    qsizetype allowed = 0;
+    bool first = true;
+    while (first || peer < plan.peers.size()) {
+        NlRequest request(family, 0);
+        genlmsghdr genl {};
+        genl.cmd     = WG_CMD_SET_DEVICE;
+        genl.version = WG_GENL_VERSION;
+        request.payload(genl);
+        request.attrString(WGDEVICE_A_IFNAME, name);
+        if (first) {
+            request.attr(WGDEVICE_A_PRIVATE_KEY, plan.privateKey.constData(), WG_KEY_LEN);
+            if (plan.listenPort >= 0)
+                request.attrU16(WGDEVICE_A_LISTEN_PORT, quint16(plan.listenPort));
+            if (plan.fwMark)
+                request.attrU32(WGDEVICE_A_FWMARK, plan.fwMark);
+            request.attrU32(WGDEVICE_A_FLAGS, WGDEVICE_F_REPLACE_PEERS);
+        }
+
+        const int peers = request.begin(WGDEVICE_A_PEERS);
+        while (peer < plan.peers.size() && request.size() < kMaxRequest - 512) {
+            const PeerPlan &p = plan.peers.at(peer);
+            const int entry = request.begin(0);
+            request.attr(WGPEER_A_PUBLIC_KEY, p.publicKey.constData(), WG_KEY_LEN);
+            if (allowed == 0) {
+                if (!p.presharedKey.isEmpty())
+                    request.attr(WGPEER_A_PRESHARED_KEY, p.presharedKey.constData(), WG_KEY_LEN);
+                if (p.endpointLength)
+                    request.attr(WGPEER_A_ENDPOINT, &p.endpoint, p.endpointLength);
+                if (p.keepalive >= 0)
+                    request.attrU16(WGPEER_A_PERSISTENT_KEEPALIVE_INTERVAL, quint16(p.keepalive));
+                request.attrU32(WGPEER_A_FLAGS, WGPEER_F_REPLACE_ALLOWEDIPS);
+            }
+            const int ips = request.begin(WGPEER_A_ALLOWEDIPS);
+            for (; allowed < p.allowedIps.size() && request.size() < kMaxRequest - 64; ++allowed) {
+                const CidrPrefix &prefix = p.allowedIps.at(allowed);
+                const int ip = request.begin(0);
+                request.attrU16(WGALLOWEDIP_A_FAMILY, prefix.v6 ? AF_INET6 : AF_INET);
+                request.attr(WGALLOWEDIP_A_IPADDR, prefix.addr.data(), prefix.v6 ? 16 : 4);
+                request.attrU8(WGALLOWEDIP_A_CIDR_MASK, quint8(prefix.length));
+                request.end(ip);
+            }
+            request.end(ips);
+            request.end(entry);
+            if (allowed < p.allowedIps.size())
+                break; // the rest of this peer goes into the next message
+            allowed = 0;
+            ++peer;
+        }
+        request.end(peers);
+        first = false;
+        requests.push_back(std::move(request));
+    }
+
+    std::vector<int> results;
+    const int rc = socket.transactAll(requests, &results);
+    if (rc < 0)
+        return rc;
+    for (const int result : results) {
+        if (result < 0)
+            return result;
+    }
+    return 0;
+}
+
+QByteArray resolvconfRecord(const TunnelConfig::Section &iface)
+{
+    QByteArray record;
+    QStringList search;
+    for (const QString &entry : iface.list("DNS")) {
+        if (QHostAddress(entry).isNull())
+            search << entry;
+        else
+            record += "nameserver " + entry.toLatin1() + '\n';
+    }
+    if (!search.isEmpty())
+        record += "search " + search.join(' ').toUtf8() + '\n';
+    return record;
+}
+
+/// Lets replies to fwmarked packets pass rp_filter. Writing it takes root
+/// or CAP_NET_ADMIN over the network namespace, and a read-only /proc/sys
+/// (some containers) refuses it regardless.
+const char kSrcValidMark[] = "/proc/sys/net/ipv4/conf/all/src_valid_mark";
+
+bool srcValidMarkSet()
+{
+    QFile sysctl(QString::fromLatin1(kSrcValidMark));
+    return sysctl.open(QIODevice::ReadOnly) && sysctl.readAll().trimmed() == "1";
+}
+#endif // Q_OS_LINUX
+
+} // namespace
+
+NativeTunnel::NativeTunnel(const QString &interfaceName)
+    : m_name(interfaceName)
+{
+}
+
+bool NativeTunnel::isAvailable()
+{
+#ifdef Q_OS_LINUX
+    if (::geteuid() == 0)
+        return true;
+    // e.g. `setcap cap_net_admin+ep dkt_vpn`
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly))
+        return false;
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (!line.startsWith("CapEff:"))
+            continue;
+        bool ok = false;
+        const quint64 caps = line.mid(7).trimmed().toULongLong(&ok, 16);
+        return ok && (caps & (quint64(1) << CAP_NET_ADMIN));
+    }
+#endif
+    return false;
+}
+
+QString NativeTunnel::unsupportedReason(const TunnelConfig &config)
+{
+#ifdef Q_OS_LINUX
+    if (qEnvironmentVariable("DKT_VPN_BACKEND") == QLatin1String("wg-quick"))
+        return QStringLiteral("DKT_VPN_BACKEND=wg-quick");
+    if (!isAvailable())
+        return QStringLiteral("no CAP_NET_ADMIN");
+    const TunnelConfig::Section *iface = config.interfaceSection();
+    if (!iface)
+        return QStringLiteral("no [Interface] section");
+    for (const char *hook : { "PreUp", "PostUp", "PreDown", "PostDown" }) {
+        if (iface->contains(hook))
+            return QStringLiteral("%1 hook").arg(QLatin1String(hook));
+    }
+    if (iface->value("SaveConfig").compare("true", Qt::CaseInsensitive) == 0)
+        return QStringLiteral("SaveConfig");
+    quint32 table = 0;
+    bool off = false;
+    if (!parseTable(iface->value("Table"), &table, &off))
+        return QStringLiteral("named routing table");
+    if (!iface->list("DNS").isEmpty()) {
+        if (::geteuid() != 0)
+            return QStringLiteral("DNS needs root for resolvconf");
+        if (QStandardPaths::findExecutable(QStringLiteral("resolvconf")).isEmpty())
+            return QStringLiteral("DNS needs resolvconf");
+    }
+    return {};
+#else
+    Q_UNUSED(config);
+    return QStringLiteral("not supported on this platform");
+#endif
+}
+
+bool NativeTunnel::up(const TunnelConfig &config, QString *error)
+{
+#ifdef Q_OS_LINUX
+    DevicePlan plan;
+    if (!parsePlan(config, &plan, error))
+        return false;
+
+    NlSocket route(NETLINK_ROUTE);
+    NlSocket genl(NETLINK_GENERIC);
+    if (!route.isOpen() || !genl.isOpen()) {
+        *error = errorText("netlink socket", -errno);
+        return false;
+    }
+
+    // A /0 with Table = auto goes into its own table, steered by fwmark:
+    // FwMark if set, else the first table from 51820 up that has no
+    // routes, as wg-quick picks it.
+    bool defaultV4 = false, defaultV6 = false;
+    if (!plan.tableOff && plan.table == 0) {
+        for (const PeerPlan &peer : std::as_const(plan.peers)) {
+            for (const CidrPrefix &prefix : peer.allowedIps) {
+                if (prefix.length == 0)
+                    (prefix.v6 ? defaultV6 : defaultV4) = true;
+            }
+        }
+    }
+    quint32 defaultTable = plan.fwMark;
+    if ((defaultV4 || defaultV6) && !defaultTable) {
+        QSet<quint32> used;
+        const int rc = forEachRoute(route, [&](quint32 table, int, const CidrPrefix &) {
+            used.insert(table);
+        });
+        if (rc < 0) {
+            *error = errorText("list routes", rc);
+            return false;
+        }
+        for (defaultTable = kDefaultTable; used.contains(defaultTable); ++defaultTable) {}
+        plan.fwMark = defaultTable;
+    }
+
+    const QByteArray name = m_name.toLocal8Bit();
+    int rc = createLink(route, name);
+    if (rc < 0) {
+        *error = errorText("create link", rc);
+        return false;
+    }
+    m_ifindex = int(::if_nametoindex(name.constData()));
+
+    // From here on every failure removes what has been added so far.
+    const auto fail = [&](const char *step, int code) {
+        *error = errorText(step, code);
+        rollback();
+        return false;
+    };
+
+    // The module is loaded by the link creation above, so look the family up now.
+    const int family = wireguardFamily(genl);
+    if (family < 0)
+        return fail("wireguard genl family", family);
+    rc = setDevice(genl, quint16(family), name, plan);
+    if (rc < 0)
+        return fail("configure wireguard", rc);
+
+    int mtu = plan.mtu;
+    if (mtu <= 0) {
+        // Like wg-quick: the largest path MTU towards the endpoints, less 80
+        // bytes of IPv6 + UDP + WireGuard overhead.
+        int path = 0;
+        for (const PeerPlan &peer : std::as_const(plan.peers)) {
+            if (peer.endpointLength)
+                path = std::max(path, routeMtu(route, peer.endpoint));
+        }
+        mtu = (path > 0 ? path : 1500) - 80;
+    }
+
+    // Addresses and link up, then routes and rules: two batches, each one
+    // send and one pass over the acknowledgements.
+    std::vector<NlRequest> requests;
+    for (const InterfaceAddress &address : std::as_const(plan.addresses))
+        requests.push_back(addressRequest(m_ifindex, address));
+    requests.push_back(linkUpRequest(m_ifindex, mtu));
+    std::vector<int> results;
+    rc = route.transactAll(requests, &results);
+    if (rc < 0)
+        return fail("add addresses", rc);
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i] < 0)
+            return fail(i + 1 < results.size() ? "add address" : "set link up", results[i]);
+    }
+
+    QList<CidrPrefix> routes;
+    QList<quint32> routeTables;
+    if (!plan.tableOff) {
+        // Most specific first, as wg-quick walks `wg show allowed-ips`.
+        QList<CidrPrefix> prefixes;
+        QSet<QString> seen;
+        for (const PeerPlan &peer : std::as_const(plan.peers)) {
+            for (const CidrPrefix &prefix : peer.allowedIps) {
+                if (!seen.contains(prefix.toString())) {
+                    seen.insert(prefix.toString());
+                    prefixes << prefix;
+                }
+            }
+        }
+        std::stable_sort(prefixes.begin(), prefixes.end(),
+                         [](const CidrPrefix &a, const CidrPrefix &b) { return a.length > b.length; });
+
+        // With Table = auto, wg-quick skips a prefix that a main-table route
+        // on the interface already covers, e.g. the one for its own Address.
+        QList<CidrPrefix> onLink;
+        if (plan.table == 0) {
+            rc = forEachRoute(route, [&](quint32 table, int oif, const CidrPrefix &prefix) {
+                if (table == RT_TABLE_MAIN && oif == m_ifindex)
+                    onLink << prefix;
+            });
+            if (rc < 0)
+                return fail("list routes", rc);
+        }
+        for (const CidrPrefix &prefix : std::as_const(prefixes)) {
+            const bool isDefault = prefix.length == 0 && plan.table == 0;
+            if (!isDefault && std::any_of(onLink.cbegin(), onLink.cend(),
+                                          [&](const CidrPrefix &o) { return covers(o, prefix); }))
+                continue;
+            routes << prefix;
+            routeTables << (isDefault ? defaultTable : plan.table ? plan.table : RT_TABLE_MAIN);
+        }
+    }
+
+    requests.clear();
+    for (qsizetype i = 0; i < routes.size(); ++i)
+        requests.push_back(routeRequest(m_ifindex, routes.at(i), routeTables.at(i)));
+    QList<Rule> rules;
+    for (const int ipFamily : { AF_INET, AF_INET6 }) {
+        if (!(ipFamily == AF_INET ? defaultV4 : defaultV6))
+            continue;
+        for (const bool suppressMain : { false, true }) {
+            const quint32 table = suppressMain ? quint32(RT_TABLE_MAIN) : defaultTable;
+            rules << Rule { ipFamily, table, suppressMain };
+            requests.push_back(ruleRequest(RTM_NEWRULE, ipFamily, table, suppressMain));
+        }
+    }
+    rc = route.transactAll(requests, &results);
+
+    // Only rules this call added are ours to remove. One that already
+    // exists belongs to someone else (another tunnel's suppress rule) and
+    // stays where it is.
+    const size_t firstRule = size_t(routes.size());
+    for (qsizetype i = 0; i < rules.size(); ++i) {
+        if (results[firstRule + size_t(i)] == 0)
+            m_rules << rules.at(i);
+    }
+    if (rc < 0)
+        return fail("add routes", rc);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const int result = results[i];
+        if (result == 0 || (i >= firstRule && result == -EEXIST))
+            continue;
+        if (i < firstRule) {
+            // No route is replaced: a prefix already routed elsewhere (say
+            // the LAN on eth0) fails the bring-up, as `ip route add` does.
+            *error = QStringLiteral("add route %1: %2")
+                         .arg(routes.at(qsizetype(i)).toString(),
+                              QString::fromLocal8Bit(std::strerror(-result)));
+            rollback();
+            return false;
+        }
+        return fail("add rule", result);
+    }
+    if (defaultV4) {
+        // As wg-quick does. Without it a strict rp_filter drops the
+        // tunnel's replies, so a failed write fails the bring-up and
+        // VpnManager falls back to wg-quick.
+        QFile sysctl(QString::fromLatin1(kSrcValidMark));
+        const bool written = sysctl.open(QIODevice::WriteOnly) && sysctl.write("1\n") == 2
+                          && sysctl.flush();
+        if (!written && !srcValidMarkSet()) {
+            *error = QStringLiteral("set src_valid_mark: %1").arg(sysctl.errorString());
+            rollback();
+            return false;
+        }
+    }
+
+    m_dnsRecord = resolvconfRecord(*config.interfaceSection());
+    return true;
+#else
+    Q_UNUSED(config);
+    *error = QStringLiteral("Native tunnel setup is only supported on Linux");
+    return false;
+#endif
+}
+
+bool NativeTunnel::down(QString *error)
+{
+#ifdef Q_OS_LINUX
+    NlSocket route(NETLINK_ROUTE);
+    if (!route.isOpen()) {
+        *error = errorText("netlink socket", -errno);
+        return false;
+    }
+    bool ok = true;
+    std::vector<NlRequest> requests;
+    for (const Rule &rule : std::as_const(m_rules))
+        requests.push_back(ruleRequest(RTM_DELRULE, rule.family, rule.table, rule.suppressMain));
+    std::vector<int> results;
+    int rc = route.transactAll(requests, &results);
+    for (const int result : results) {
+        if (result < 0 && result != -ENOENT)
+            rc = result;
+    }
+    if (rc < 0) {
+        *error = errorText("delete rule", rc);
+        ok = false;
+    }
+    m_rules.clear();
+
+    // Looked up again: the link may have been removed or recreated meanwhile.
+    const int ifindex = int(::if_nametoindex(m_name.toLocal8Bit().constData()));
+    if (ifindex > 0) {
+        rc = deleteLink(route, ifindex);
+        if (rc < 0 && rc != -ENODEV) {
+            *error = errorText("delete link", rc);
+            ok = false;
+        }
+    }
+    m_ifindex = 0;
+    return ok;
+#else
+    Q_UNUSED(error);
+    return true;
+#endif
+}
+
+void NativeTunnel::rollback()
+{
+    QString ignored;
+    down(&ignored);
+}
+
+QString NativeTunnel::resolvconfInterface() const
+{
+    // Same rule as wg-quick: the first "prefix*" entry of interface-order.
+    QFile order(QStringLiteral("/etc/resolvconf/interface-order"));
+    if (order.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        static const QRegularExpression wildcard(QStringLiteral("^([A-Za-z0-9-]+)\\*$"));
+        while (!order.atEnd()) {
+            const QRegularExpressionMatch match =
+                wildcard.match(QString::fromUtf8(order.readLine()).trimmed());
+            if (match.hasMatch())
+                return match.captured(1) + '.' + m_name;
+        }
+    }
+    return m_name;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include "tunnelconfig.h"
+
+/**
+ * NativeTunnel brings a wg-quick config up and down by talking to the kernel
+ * directly (Linux): rtnetlink for the link, addresses, MTU, routes and policy
+ * rules, and WireGuard's generic netlink family for the key and peers. The
+ * requests go out in batches on sockets kept open for the whole bring-up:
+ * the peers, then addresses plus link up, then every route and rule, each
+ * batch one send (up to 64 messages) and one pass over the acks. Nothing is
+ * forked except resolvconf for DNS, which VpnManager runs.
+ *
+ * The end state matches `wg-quick up`: MTU from the path to the endpoints
+ * minus 80, a route per AllowedIPs prefix not already covered by a route on
+ * the interface, and for a /0 the fwmark table (FwMark, else the first table
+ * from 51820 up without routes) with the "not fwmark" and "main
+ * suppress_prefixlength 0" rules. Routes are added, never replaced: a prefix
+ * that is already routed elsewhere fails up(), as `ip route add` fails
+ * wg-quick. Either backend can take the tunnel down. wg-quick's nftables
+ * guard against reverse-path filtering is not installed.
+ *
+ * up() is all or nothing: on failure it removes whatever it had added.
+ * down() removes only the rules up() added, so another tunnel's identical
+ * suppress rule stays in place.
+ */
+class NativeTunnel
+{
+public:
+    static constexpr quint32 kDefaultTable = 51820;
+
+    explicit NativeTunnel(const QString &interfaceName);
+
+    /// True when this process may configure interfaces (root or CAP_NET_ADMIN).
+    static bool isAvailable();
+    /// Why @p config has to go through wg-quick (hooks, SaveConfig, no
+    /// privileges …), or empty if up() can handle it.
+    static QString unsupportedReason(const TunnelConfig &config);
+
+    bool up(const TunnelConfig &config, QString *error);
+    /// Removes the policy rules and the link; addresses and routes go with it.
+    bool down(QString *error);
+
+    const QString &interfaceName() const { return m_name; }
+
+    /// resolvconf record for the config's DNS entries; empty when there are none.
+    const QByteArray &dnsRecord() const { return m_dnsRecord; }
+    /// Name the record is registered under, with the interface-order prefix
+    /// wg-quick uses (e.g. "tun.").
+    QString resolvconfInterface() const;
+
+private:
+    struct Rule {
+        int     family = 0;
+        quint32 table  = 0;
+        bool    suppressMain = false; ///< "table main suppress_prefixlength 0"
+    };
+
+    void rollback();
+
+    QString     m_name;
+    int         m_ifindex = 0;
+    QList<Rule> m_rules;      ///< added by up() itself, removed by down()
+    QByteArray  m_dnsRecord;
+};
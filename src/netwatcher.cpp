@@ -0,0 +1,210 @@
+#include "netwatcher.h"
+
+#include <QDateTime>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#  include <linux/netlink.h>
+#  include <linux/rtnetlink.h>
+#  include <net/if.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#  include <cerrno>
+#endif
+
+#ifdef Q_OS_LINUX
+namespace {
+
+/// IFLA_IFNAME of a link message, or IFA_LABEL of an IPv4 address message.
+QString nameAttribute(const nlmsghdr *nh)
+{
+    const rtattr *rta = nullptr;
+    int attrLen = 0;
+    unsigned short type = 0;
+    if (nh->nlmsg_type == RTM_NEWLINK || nh->nlmsg_type == RTM_DELLINK) {
+        const auto *ifi = static_cast<const ifinfomsg *>(NLMSG_DATA(nh));
+        rta = IFLA_RTA(ifi);
+        attrLen = int(IFLA_PAYLOAD(nh));
+        type = IFLA_IFNAME;
+    } else {
+        const auto *ifa = static_cast<const ifaddrmsg *>(NLMSG_DATA(nh));
+        rta = IFA_RTA(ifa);
+        attrLen = int(IFA_PAYLOAD(nh));
+        type = IFA_LABEL;
+    }
+    for (; RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+        if (rta->rta_type != type)
+            continue;
+        const auto *data = static_cast<const char *>(RTA_DATA(rta));
+        return QString::fromLocal8Bit(data, int(qstrnlen(data, RTA_PAYLOAD(rta))));
+    }
+    return {};
+}
+
+} // namespace
+#endif
+
+NetworkWatcher::NetworkWatcher(QObject *parent)
+    : QObject(parent)
+{
+    m_debounce = new QTimer(this);
+    m_debounce->setSingleShot(true);
+    m_debounce->setInterval(750);
+    connect(m_debounce, &QTimer::timeout, this, [this]() {
+        const QString reason = m_pendingReason;
+        m_pendingReason.clear();
+        emit networkChanged(reason, m_firstEventMs);
+    });
+}
+
+NetworkWatcher::~NetworkWatcher()
+{
+    stop();
+}
+
+void NetworkWatcher::setDebounceInterval(int msec)
+{
+    m_debounce->setInterval(msec);
+}
+
+bool NetworkWatcher::start()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0)
+        return true;
+
+    m_fd = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (m_fd < 0)
+        return false;
+
+    sockaddr_nl addr {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR
+                   | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (::bind(m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &NetworkWatcher::onReadable);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void NetworkWatcher::stop()
+{
+    m_debounce->stop();
+    delete m_notifier;
+    m_notifier = nullptr;
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+    m_fd = -1;
+}
+
+void NetworkWatcher::setIgnoredInterfaces(const QStringList &names)
+{
+    m_ignored = names;
+    m_ignoredIndexes.clear();
+#ifdef Q_OS_LINUX
+    for (const QString &name : names) {
+        if (const unsigned index = if_nametoindex(name.toLocal8Bit().constData()))
+            m_ignoredIndexes << int(index);
+    }
+#endif
+}
+
+bool NetworkWatcher::isIgnored(int ifindex, const QString &name) const
+{
+    if (!name.isEmpty() && m_ignored.contains(name))
+        return true;
+    if (ifindex <= 0)
+        return false;
+    if (m_ignoredIndexes.contains(ifindex))
+        return true;
+#ifdef Q_OS_LINUX
+    // Gone already, e.g. for the address and route removals that follow a
+    // link deletion; only indexes known in advance can be matched then.
+    char resolved[IF_NAMESIZE] = {};
+    if (!if_indextoname(unsigned(ifindex), resolved))
+        return false;
+    return m_ignored.contains(QString::fromLocal8Bit(resolved));
+#else
+    return false;
+#endif
+}
+
+void NetworkWatcher::note(const QString &reason)
+{
+    if (m_pendingReason.isEmpty()) {
+        m_pendingReason = reason;
+        m_firstEventMs  = QDateTime::currentMSecsSinceEpoch();
+    }
+    m_debounce->start(); // restart: fire once the burst has settled
+}
+
+void NetworkWatcher::onReadable()
+{
+#ifdef Q_OS_LINUX
+    alignas(nlmsghdr) char buf[16384];
+    for (;;) {
+        const ssize_t len = ::recv(m_fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == ENOBUFS)
+                note(QStringLiteral("netlink overrun")); // events lost, assume a change
+            break;
+        }
+
+        int remaining = int(len);
+        for (auto *nh = reinterpret_cast<nlmsghdr *>(buf); NLMSG_OK(nh, remaining);
+             nh = NLMSG_NEXT(nh, remaining)) {
+            switch (nh->nlmsg_type) {
+            case RTM_NEWLINK:
+            case RTM_DELLINK: {
+                const auto *ifi = static_cast<const ifinfomsg *>(NLMSG_DATA(nh));
+                // NEWLINK with an empty change mask is just a statistics refresh.
+                if (nh->nlmsg_type == RTM_NEWLINK && ifi->ifi_change == 0)
+                    break;
+                // On DELLINK the index no longer resolves; the name is in the message.
+                if (!isIgnored(ifi->ifi_index, nameAttribute(nh)))
+                    note(nh->nlmsg_type == RTM_NEWLINK ? QStringLiteral("link changed")
+                                                       : QStringLiteral("link removed"));
+                break;
+            }
+            case RTM_NEWADDR:
+            case RTM_DELADDR: {
+                const auto *ifa = static_cast<const ifaddrmsg *>(NLMSG_DATA(nh));
+                if (!isIgnored(int(ifa->ifa_index), nameAttribute(nh)))
+                    note(nh->nlmsg_type == RTM_NEWADDR ? QStringLiteral("address added")
+                                                       : QStringLiteral("address removed"));
+                break;
+            }
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE: {
+                const auto *rtm = static_cast<const rtmsg *>(NLMSG_DATA(nh));
+                // Only default routes in the main table say "we moved".
+                if (rtm->rtm_dst_len != 0 || rtm->rtm_table != RT_TABLE_MAIN)
+                    break;
+                int oif = 0;
+                int attrLen = int(RTM_PAYLOAD(nh));
+                for (auto *rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+                    if (rta->rta_type == RTA_OIF)
+                        oif = *static_cast<const int *>(RTA_DATA(rta));
+                }
+                if (!isIgnored(oif))
+                    note(QStringLiteral("default route changed"));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+#endif
+}
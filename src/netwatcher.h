@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+class QTimer;
+
+/**
+ * NetworkWatcher reports changes of the underlying network that can strand
+ * a tunnel: links going up/down, addresses appearing or disappearing and
+ * default-route changes (Wi-Fi ↔ Ethernet switches, resume from sleep …).
+ *
+ * On Linux it listens on an rtnetlink socket; bursts of events are debounced
+ * into a single networkChanged() signal. Events on the tunnel interfaces
+ * themselves are ignored. Other platforms currently report nothing.
+ */
+class NetworkWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkWatcher(QObject *parent = nullptr);
+    ~NetworkWatcher() override;
+
+    /// Opens the netlink socket. Returns false if unsupported or refused.
+    bool start();
+    void stop();
+
+    /// Interfaces whose own events must not count as a network change.
+    /// They should exist when this is called: their indexes are looked up
+    /// here, because events sent while one is removed cannot be resolved.
+    void setIgnoredInterfaces(const QStringList &names);
+    void setDebounceInterval(int msec);
+
+signals:
+    /// @p reason summarises the first event of the debounced burst and
+    /// @p firstEventMs is its wall-clock time (ms since the epoch).
+    void networkChanged(const QString &reason, qint64 firstEventMs);
+
+private slots:
+    void onReadable();
+
+private:
+    /// @p name is the interface name from the message itself, if it has one.
+    bool isIgnored(int ifindex, const QString &name = QString()) const;
+    void note(const QString &reason);
+
+    int              m_fd       = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer          *m_debounce = nullptr;
+    QStringList      m_ignored;
+    QList<int>       m_ignoredIndexes;
+    QString          m_pendingReason;
+    qint64           m_firstEventMs = 0;
+};
@@ -0,0 +1,227 @@
+#include "queueshaper.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// Tin names by cake diffserv mode, in tin order.
+const QStringList kDiffserv4Tins = { "bulk", "best_effort", "video", "voice" };
+const QStringList kDiffserv3Tins = { "bulk", "best_effort", "voice" };
+
+/// Parses a tc-style rate ("800kbit", "50Mbit", "1.5gbit") into bytes/s.
+bool parseRate(const QString &text, quint64 *bytesPerSecond)
+{
+    static const QRegularExpression re(QStringLiteral("^(\\d+(?:\\.\\d+)?)\\s*([kmg]?)bit$"),
+                                       QRegularExpression::CaseInsensitiveOption);
+    const QRegularExpressionMatch m = re.match(text.trimmed());
+    if (!m.hasMatch())
+        return false;
+    double bits = m.captured(1).toDouble();
+    switch (m.captured(2).toLower().toLatin1().value(0)) {
+    case 'k': bits *= 1e3; break;
+    case 'm': bits *= 1e6; break;
+    case 'g': bits *= 1e9; break;
+    default:  break;
+    }
+    *bytesPerSecond = quint64(bits / 8);
+    return *bytesPerSecond >= QueueShaper::kMinRate;
+}
+
+bool isTrue(const QString &value)
+{
+    for (const char *yes : { "true", "yes", "on", "1" }) {
+        if (value.compare(QLatin1String(yes), Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+quint64 counter(const QJsonObject &object, const char *key)
+{
+    return quint64(std::max(0.0, object.value(QLatin1String(key)).toDouble()));
+}
+
+} // namespace
+
+std::unique_ptr<QueueShaper> QueueShaper::fromConfig(const QString &tunnel,
+                                                     const TunnelConfig &config, QString *error)
+{
+    const QString discipline = config.option("QueueDiscipline").trimmed().toLower();
+    if (discipline.isEmpty() || discipline == QLatin1String("off"))
+        return nullptr;
+
+    auto shaper = std::make_unique<QueueShaper>();
+    shaper->m_tunnel = tunnel;
+    if (discipline == QLatin1String("cake")) {
+        shaper->m_discipline = Cake;
+    } else if (discipline != QLatin1String("fq_codel")) {
+        *error = QStringLiteral("QueueDiscipline must be fq_codel, cake or off, not %1").arg(discipline);
+        return nullptr;
+    }
+
+    const QString rate = config.option("ShapeRate").trimmed();
+    const QString dscp = config.option("DscpClassify").trimmed();
+    if (shaper->m_discipline == FqCodel && (!rate.isEmpty() || isTrue(dscp))) {
+        *error = QStringLiteral("ShapeRate and DscpClassify need QueueDiscipline = cake");
+        return nullptr;
+    }
+    if (rate.compare("auto", Qt::CaseInsensitive) == 0) {
+        shaper->m_adaptive = true;
+    } else if (!rate.isEmpty() && rate.compare("off", Qt::CaseInsensitive) != 0
+               && !parseRate(rate, &shaper->m_rate)) {
+        *error = QStringLiteral("ShapeRate must be auto, off or a rate of at least 1mbit "
+                                "such as 40mbit, not %1").arg(rate);
+        return nullptr;
+    }
+    shaper->m_diffserv = isTrue(dscp);
+
+    // cake accounts for the encapsulation the packets get after the tunnel.
+    const QList<const TunnelConfig::Section *> peers = config.peers();
+    QString host;
+    quint16 port = 0;
+    if (!peers.isEmpty() && TunnelConfig::splitEndpoint(peers.first()->value("Endpoint"), &host, &port)
+        && QHostAddress(host).protocol() == QAbstractSocket::IPv6Protocol)
+        shaper->m_overhead = 80;
+    return shaper;
+}
+
+// ── tc commands ──────────────────────────────────────────────────────────────
+QStringList QueueShaper::qdiscSpec(const char *verb, const QString &device) const
+{
+    QStringList args = { "qdisc", QString::fromLatin1(verb), "dev", device, "root" };
+    if (m_discipline == FqCodel)
+        return args << "fq_codel";
+    args << "cake" << "bandwidth"
+         << (m_rate ? QString::number(m_rate * 8) + "bit" : QStringLiteral("unlimited"));
+    if (qstrcmp(verb, "change") == 0)
+        return args;
+    return args << (m_diffserv ? "diffserv4" : "besteffort")
+                << "overhead" << QString::number(m_overhead);
+}
+
+QStringList QueueShaper::installArguments() const
+{
+    return qdiscSpec("replace", m_tunnel);
+}
+
+QStringList QueueShaper::rateArguments() const
+{
+    return qdiscSpec("change", m_tunnel);
+}
+
+QString QueueShaper::postUpCommand() const
+{
+    // A missing tc must not make wg-quick tear the tunnel down again.
+    return "tc " + qdiscSpec("replace", QStringLiteral("%i")).join(' ') + " || true";
+}
+
+// ── Rate adaptation ──────────────────────────────────────────────────────────
+void QueueShaper::setRtt(double srttMs)
+{
+    if (srttMs <= 0)
+        return;
+    m_srtt = srttMs;
+    // The minimum, drifting up slowly so that a move to a longer path is
+    // eventually accepted as the new baseline.
+    if (m_baseRtt <= 0 || srttMs < m_baseRtt)
+        m_baseRtt = srttMs;
+    else
+        m_baseRtt += (srttMs - m_baseRtt) * 0.002;
+}
+
+bool QueueShaper::updateSample(quint64 txBytes, qint64 nowMs)
+{
+    const bool first = m_lastSampleMs == 0 || txBytes < m_lastTx;
+    const qint64 elapsedMs = nowMs - m_lastSampleMs;
+    const quint64 sent = txBytes - m_lastTx;
+    m_lastTx = txBytes;
+    m_lastSampleMs = nowMs;
+    if (first || elapsedMs <= 0 || !m_adaptive || m_srtt <= 0)
+        return false;
+
+    const double txRate = double(sent) * 1000.0 / double(elapsedMs);
+    const bool bloated = m_srtt - m_baseRtt > kBloatMs;
+    double next = double(m_rate);
+    if (m_rate == 0) {
+        // Unshaped until the path first queues up under load.
+        if (bloated && txRate > kMinRate)
+            next = txRate * 0.9;
+    } else if (txRate >= 0.8 * double(m_rate)) {
+        // Saturated: back off below what got through while the bottleneck
+        // queues, otherwise probe for more one step at a time.
+        next = bloated ? std::min(double(m_rate), txRate) * 0.9 : double(m_rate + kRateStep);
+    }
+    if (next <= 0)
+        return false;
+    m_rate = quint64(std::max(next, double(kMinRate)));
+    // Steps accumulate until they are worth a tc call.
+    if (m_appliedRate
+        && std::abs(double(m_rate) - double(m_appliedRate)) < 0.05 * double(m_appliedRate))
+        return false;
+    m_appliedRate = m_rate;
+    return true;
+}
+
+// ── Statistics ───────────────────────────────────────────────────────────────
+bool QueueShaper::parseStats(const QString &tunnel, const QByteArray &json, QueueStats *out)
+{
+    const QJsonArray qdiscs = QJsonDocument::fromJson(json).array();
+    if (qdiscs.isEmpty())
+        return false;
+    // The root qdisc; older iproute2 releases do not flag it, take the first then.
+    QJsonObject qdisc = qdiscs.first().toObject();
+    for (const QJsonValue &value : qdiscs) {
+        if (value.toObject().value("root").toBool()) {
+            qdisc = value.toObject();
+            break;
+        }
+    }
+
+    out->tunnel      = tunnel;
+    out->kind        = qdisc.value("kind").toString();
+    out->shapeRate   = 0;
+    out->sampledAtMs = QDateTime::currentMSecsSinceEpoch();
+    out->classes.clear();
+
+    if (out->kind == QLatin1String("cake")) {
+        const QJsonObject options = qdisc.value("options").toObject();
+        out->shapeRate = counter(options, "bandwidth"); // "unlimited" reads as 0
+        const QString mode = options.value("diffserv").toString();
+        const QStringList names = mode == QLatin1String("diffserv4") ? kDiffserv4Tins
+                                : mode == QLatin1String("diffserv3") ? kDiffserv3Tins
+                                : QStringList();
+        const QJsonArray tins = qdisc.value("tins").toArray();
+        for (int i = 0; i < tins.size(); ++i) {
+            const QJsonObject tin = tins.at(i).toObject();
+            QueueClassStats c;
+            c.name         = names.value(i, QStringLiteral("best_effort"));
+            c.sentBytes    = counter(tin, "sent_bytes");
+            c.sentPackets  = counter(tin, "sent_packets");
+            c.drops        = counter(tin, "drops");
+            c.ecnMarks     = counter(tin, "ecn_mark");
+            c.backlogBytes = counter(tin, "backlog_bytes");
+            c.avgDelayUs   = counter(tin, "avg_delay_us");
+            c.peakDelayUs  = counter(tin, "peak_delay_us");
+            out->classes << c;
+        }
+    } else if (out->kind == QLatin1String("fq_codel")) {
+        QueueClassStats c;
+        c.name         = QStringLiteral("best_effort");
+        c.sentBytes    = counter(qdisc, "bytes");
+        c.sentPackets  = counter(qdisc, "packets");
+        c.drops        = counter(qdisc, "drops");
+        c.ecnMarks     = counter(qdisc, "ecn_mark");
+        c.backlogBytes = counter(qdisc, "backlog");
+        out->classes << c;
+    } else {
+        return false; // not ours (noqueue, or replaced by hand)
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <memory>
+#include "tunnelconfig.h"
+
+/// Counters of one queue class (a cake tin, or the whole fq_codel qdisc).
+struct QueueClassStats {
+    QString name;               ///< "bulk", "best_effort", "video" or "voice"
+    quint64 sentBytes   = 0;
+    quint64 sentPackets = 0;
+    quint64 drops       = 0;
+    quint64 ecnMarks    = 0;
+    quint64 backlogBytes = 0;
+    quint64 avgDelayUs  = 0;    ///< cake only
+    quint64 peakDelayUs = 0;    ///< cake only
+};
+
+/// One `tc -s qdisc` sample of a tunnel, delivered by value across threads.
+struct QueueStats {
+    QString tunnel;
+    QString kind;               ///< "cake" or "fq_codel"
+    quint64 shapeRate = 0;      ///< bytes/s, 0 = unshaped
+    QVector<QueueClassStats> classes;
+    qint64  sampledAtMs = 0;    ///< ms since the epoch
+};
+Q_DECLARE_METATYPE(QueueStats)
+
+/**
+ * QueueShaper manages the queue discipline on a tunnel interface (Linux),
+ * so bulk uploads do not build a queue in front of interactive traffic.
+ *
+ * [DKT] QueueDiscipline selects fq_codel or cake. cake can also shape
+ * (ShapeRate) and sort packets into diffserv4 tins by DSCP (DscpClassify).
+ * Shaping only helps when the rate sits just below the real bottleneck.
+ * With ShapeRate = auto the rate is found from measurements: the tunnel
+ * runs unshaped until the in-tunnel RTT rises under load, then the rate is
+ * set just below the throughput achieved at that moment. From there it is
+ * adjusted AIMD-style: +1 Mbit/s per saturated sample while the path stays
+ * fast, ×0.9 of what got through when the RTT rises. Without RTT samples
+ * (no probe responder) the rate never moves.
+ *
+ * The class only decides; VpnManager runs the `tc` commands.
+ */
+class QueueShaper
+{
+public:
+    enum Discipline { FqCodel, Cake };
+
+    static constexpr double  kBloatMs = 15;      ///< RTT rise over the baseline that counts as a queue
+    static constexpr quint64 kMinRate = 125000;  ///< 1 Mbit/s, in bytes/s
+    static constexpr quint64 kRateStep = 125000; ///< additive increase per sample, bytes/s
+
+    /// Builds a shaper from the [DKT] options. Returns null when
+    /// QueueDiscipline is unset or "off", or when an option is malformed
+    /// (then @p error is set).
+    static std::unique_ptr<QueueShaper> fromConfig(const QString &tunnel,
+                                                   const TunnelConfig &config, QString *error);
+
+    Discipline discipline() const { return m_discipline; }
+    bool    isAdaptive() const { return m_adaptive; }
+    void    setAdaptive(bool adaptive) { m_adaptive = adaptive; }
+    quint64 rate() const { return m_rate; }
+
+    /// `tc` arguments installing the qdisc at the current rate.
+    QStringList installArguments() const;
+    /// `tc` arguments changing only the cake rate; counters are kept.
+    QStringList rateArguments() const;
+    /// The same install as a wg-quick PostUp command (%i = interface).
+    QString     postUpCommand() const;
+
+    /// Smoothed in-tunnel RTT from the LatencyProber.
+    void setRtt(double srttMs);
+    /// Feeds the tunnel's tx counter. Returns true when the adaptive rate
+    /// has moved 5 % or more from the one last applied.
+    bool updateSample(quint64 txBytes, qint64 nowMs);
+
+    /// Parses `tc -s -j qdisc show dev <tunnel>` output.
+    static bool parseStats(const QString &tunnel, const QByteArray &json, QueueStats *out);
+
+private:
+    QStringList qdiscSpec(const char *verb, const QString &device) const;
+
+    QString    m_tunnel;
+    Discipline m_discipline = FqCodel;
+    bool       m_diffserv   = false;
+    bool       m_adaptive   = false;
+    int        m_overhead   = 60;   ///< outer IP + UDP + WireGuard header per packet
+    quint64    m_rate       = 0;    ///< bytes/s, 0 = unshaped
+    quint64    m_appliedRate = 0;   ///< m_rate when updateSample() last returned true
+
+    double     m_srtt       = 0;
+    double     m_baseRtt    = 0;    ///< unloaded RTT estimate, ms
+    quint64    m_lastTx     = 0;
+    qint64     m_lastSampleMs = 0;
+};
@@ -0,0 +1,432 @@
+#include "throughputchart.h"
+
+#include <QPainter>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+const QColor kRxColor      ("#6366f1");
+const QColor kTxColor      ("#22c55e");
+const QColor kLatencyColor ("#f59e0b");
+const QColor kGridColor    ("#252840");
+const QColor kLabelColor   ("#718096");
+
+const qint64 kSpanPresets[] = {
+    60 * 1000, 5 * 60 * 1000, 15 * 60 * 1000, 60 * 60 * 1000,
+    6 * 60 * 60 * 1000, 24 * 60 * 60 * 1000
+};
+
+// Levels are chosen so that LTTB sees at most this many points per pixel.
+constexpr int kMaxPointsPerPixel = 4;
+
+/// Smallest 1-2-5 step value >= @p value.
+double niceCeil(double value)
+{
+    const double magnitude = std::pow(10.0, std::floor(std::log10(value)));
+    for (double step : { 1.0, 2.0, 5.0, 10.0 }) {
+        if (step * magnitude >= value)
+            return step * magnitude;
+    }
+    return 10.0 * magnitude;
+}
+
+QString formatRate(double bitsPerSecond)
+{
+    if (bitsPerSecond >= 1e9)
+        return QString::number(bitsPerSecond / 1e9, 'g', 3) + " Gb/s";
+    if (bitsPerSecond >= 1e6)
+        return QString::number(bitsPerSecond / 1e6, 'g', 3) + " Mb/s";
+    if (bitsPerSecond >= 1e3)
+        return QString::number(bitsPerSecond / 1e3, 'g', 3) + " kb/s";
+    return QString::number(bitsPerSecond, 'g', 3) + " b/s";
+}
+
+QString formatSpan(qint64 msecs)
+{
+    if (msecs < 60 * 60 * 1000)
+        return QString("−%1 min").arg(msecs / 60000);
+    return QString("−%1 h").arg(msecs / 3600000);
+}
+
+} // namespace
+
+// ── ChartSeries ──────────────────────────────────────────────────────────────
+void ChartSeries::append(qint64 t, double v)
+{
+    push(0, { t, v });
+}
+
+void ChartSeries::clear()
+{
+    for (Level &level : m_levels)
+        level = Level();
+}
+
+void ChartSeries::push(int level, const Point &p)
+{
+    Level &l = m_levels[level];
+    l.points.append(p);
+    if (l.points.size() > kLevelCapacity) {
+        l.points.removeFirst();
+        l.truncated = true;
+    }
+
+    if (level + 1 >= kLevels)
+        return;
+    Level &up = m_levels[level + 1];
+    up.pendingSum  += p.v;
+    up.pendingTSum += p.t;
+    if (++up.pendingCount == kFanOut) {
+        const Point aggregate { up.pendingTSum / kFanOut, up.pendingSum / kFanOut };
+        up.pendingSum   = 0;
+        up.pendingTSum  = 0;
+        up.pendingCount = 0;
+        push(level + 1, aggregate);
+    }
+}
+
+int ChartSeries::levelFor(qint64 from, int maxPoints) const
+{
+    auto byTime = [](const Point &p, qint64 t) { return p.t < t; };
+    for (int k = 0; k < kLevels; ++k) {
+        const Level &l = m_levels[k];
+        // This level has already dropped part of the window.
+        if (l.truncated && l.points.first().t > from)
+            continue;
+        const auto first = std::lower_bound(l.points.cbegin(), l.points.cend(), from, byTime);
+        const qsizetype count = (l.points.cend() - first) + (l.pendingCount > 0 ? 1 : 0);
+        if (count <= maxPoints)
+            return k;
+    }
+    return kLevels - 1;
+}
+
+void ChartSeries::collect(int level, qint64 from, QList<Point> &out) const
+{
+    const Level &l = m_levels[level];
+    auto byTime = [](const Point &p, qint64 t) { return p.t < t; };
+    for (auto it = std::lower_bound(l.points.cbegin(), l.points.cend(), from, byTime);
+         it != l.points.cend(); ++it)
+        out.append(*it);
+
+    if (l.pendingCount > 0) {
+        const Point tail { l.pendingTSum / l.pendingCount, l.pendingSum / l.pendingCount };
+        if (tail.t >= from)
+            out.append(tail);
+    }
+}
+
+// ── ThroughputChart ──────────────────────────────────────────────────────────
+ThroughputChart::ThroughputChart(QWidget *parent)
+    : QWidget(parent)
+{
+    setMinimumHeight(90);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setToolTip(tr("Scroll to change the visible history"));
+}
+
+QSize ThroughputChart::sizeHint() const
+{
+    return { 400, 110 };
+}
+
+void ThroughputChart::addTrafficSample(qint64 timeMs, quint64 rxBytes, quint64 txBytes)
+{
+    // Counters reset when the tunnel is re-created; skip that interval.
+    if (m_lastTrafficMs > 0 && timeMs > m_lastTrafficMs
+        && rxBytes >= m_lastRx && txBytes >= m_lastTx) {
+        const double dt = (timeMs - m_lastTrafficMs) / 1000.0;
+        m_nowMs = std::max(m_nowMs, timeMs);
+        m_rx.history.append(timeMs, (rxBytes - m_lastRx) / dt);
+        m_tx.history.append(timeMs, (txBytes - m_lastTx) / dt);
+        refreshTail(m_rx);
+        refreshTail(m_tx);
+        update();
+    }
+    m_lastTrafficMs = timeMs;
+    m_lastRx = rxBytes;
+    m_lastTx = txBytes;
+}
+
+void ThroughputChart::addLatencySample(qint64 timeMs, double latencyMs)
+{
+    if (!m_hasLatency) {
+        m_hasLatency = true;
+        m_bgDirty = true; // right-hand axis appears
+    }
+    m_nowMs = std::max(m_nowMs, timeMs);
+    m_latency.history.append(timeMs, latencyMs);
+    refreshTail(m_latency);
+    update();
+}
+
+void ThroughputChart::clear()
+{
+    for (Trace *trace : { &m_rx, &m_tx, &m_latency }) {
+        trace->history.clear();
+        trace->buckets.clear();
+        trace->level = 0;
+    }
+    m_hasLatency    = false;
+    m_nowMs         = 0;
+    m_lastTrafficMs = 0;
+    m_bgDirty       = true;
+    update();
+}
+
+void ThroughputChart::setTimeSpan(qint64 msecs)
+{
+    msecs = std::clamp<qint64>(msecs, kSpanPresets[0], std::end(kSpanPresets)[-1]);
+    if (msecs == m_spanMs)
+        return;
+    m_spanMs  = msecs;
+    m_bgDirty = true;
+    rebuildAll();
+    update();
+}
+
+// ── Downsampling ─────────────────────────────────────────────────────────────
+QRectF ThroughputChart::plotRect() const
+{
+    return QRectF(rect()).adjusted(52, 4, -40, -14);
+}
+
+qint64 ThroughputChart::bucketWidth() const
+{
+    const qint64 columns = std::max<qint64>(1, qint64(plotRect().width()));
+    return std::max<qint64>(1, m_spanMs / columns);
+}
+
+void ThroughputChart::rebuildAll()
+{
+    rebuild(m_rx);
+    rebuild(m_tx);
+    if (m_hasLatency)
+        rebuild(m_latency);
+}
+
+void ThroughputChart::rebuild(Trace &trace)
+{
+    trace.buckets.clear();
+    if (m_nowMs == 0)
+        return;
+    const qint64 from = m_nowMs - m_spanMs;
+    trace.level = trace.history.levelFor(from, kMaxPointsPerPixel * int(plotRect().width()));
+    // One bucket left of the window keeps the line running into the edge.
+    recompute(trace, from / bucketWidth() - 1);
+}
+
+void ThroughputChart::refreshTail(Trace &trace)
+{
+    const qint64 from = m_nowMs - m_spanMs;
+    const int level = trace.history.levelFor(from, kMaxPointsPerPixel * int(plotRect().width()));
+    if (level != trace.level || trace.buckets.isEmpty()) {
+        rebuild(trace);
+        return;
+    }
+
+    const qint64 firstIndex = from / bucketWidth() - 1;
+    while (!trace.buckets.isEmpty() && trace.buckets.first().index < firstIndex)
+        trace.buckets.removeFirst();
+
+    // The new point lands in the last bucket, or in a new one after it. The
+    // bucket before it has a new right-hand neighbour and must be picked
+    // again. The coarse levels' tail aggregate can also move back by one
+    // bucket, so start one bucket earlier.
+    const qint64 lastIndex = trace.buckets.isEmpty() ? firstIndex : trace.buckets.last().index;
+    recompute(trace, std::max(firstIndex, lastIndex - 2));
+}
+
+void ThroughputChart::recompute(Trace &trace, qint64 fromIndex)
+{
+    const qint64 width = bucketWidth();
+    while (!trace.buckets.isEmpty() && trace.buckets.last().index >= fromIndex)
+        trace.buckets.removeLast();
+    const qsizetype firstNew = trace.buckets.size();
+
+    m_scratch.clear();
+    m_bucketStarts.clear();
+    trace.history.collect(trace.level, fromIndex * width, m_scratch);
+
+    for (qsizetype i = 0; i < m_scratch.size(); ++i) {
+        const ChartSeries::Point &p = m_scratch[i];
+        const qint64 index = p.t / width;
+        if (trace.buckets.size() == firstNew || trace.buckets.last().index != index) {
+            trace.buckets.append({ index, {}, {} });
+            m_bucketStarts.append(int(i));
+        }
+        trace.buckets.last().average += QPointF(double(p.t), p.v);
+    }
+    m_bucketStarts.append(int(m_scratch.size()));
+
+    const qsizetype count = trace.buckets.size();
+    for (qsizetype b = firstNew; b < count; ++b) {
+        const int n = m_bucketStarts[b - firstNew + 1] - m_bucketStarts[b - firstNew];
+        trace.buckets[b].average /= n;
+    }
+
+    // Largest-Triangle-Three-Buckets: in each bucket keep the point that
+    // spans the largest triangle with the previous pick and the average of
+    // the next bucket. The open last bucket shows its newest point.
+    for (qsizetype b = firstNew; b < count; ++b) {
+        const int begin = m_bucketStarts[b - firstNew];
+        const int end   = m_bucketStarts[b - firstNew + 1];
+        Bucket &bucket = trace.buckets[b];
+        if (b == count - 1) {
+            bucket.pick = QPointF(double(m_scratch[end - 1].t), m_scratch[end - 1].v);
+            continue;
+        }
+
+        const QPointF a = b > 0 ? trace.buckets[b - 1].pick
+                                : QPointF(double(m_scratch[begin].t), m_scratch[begin].v);
+        const QPointF c = trace.buckets[b + 1].average;
+        double bestArea = -1;
+        for (int i = begin; i < end; ++i) {
+            const double px = double(m_scratch[i].t);
+            const double py = m_scratch[i].v;
+            const double area = std::abs((a.x() - c.x()) * (py - a.y())
+                                         - (a.x() - px) * (c.y() - a.y()));
+            if (area > bestArea) {
+                bestArea = area;
+                bucket.pick = QPointF(px, py);
+            }
+        }
+    }
+}
+
+// ── Painting ─────────────────────────────────────────────────────────────────
+QPolygonF ThroughputChart::polyline(const Trace &trace, double yMax) const
+{
+    const QRectF plot   = plotRect();
+    const double left   = double(m_nowMs - m_spanMs);
+    const double xScale = plot.width() / double(m_spanMs);
+    const double yScale = plot.height() / yMax;
+
+    QPolygonF line;
+    line.reserve(trace.buckets.size());
+    for (const Bucket &b : trace.buckets)
+        line << QPointF(plot.left() + (b.pick.x() - left) * xScale,
+                        plot.bottom() - b.pick.y() * yScale);
+    return line;
+}
+
+void ThroughputChart::updateBackground(double rateMax, double latencyMax)
+{
+    m_bgRateMax    = rateMax;
+    m_bgLatencyMax = latencyMax;
+    m_bgDirty      = false;
+
+    const qreal dpr = devicePixelRatioF();
+    m_background = QPixmap(size() * dpr);
+    m_background.setDevicePixelRatio(dpr);
+    m_background.fill(Qt::transparent);
+
+    QPainter p(&m_background);
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setPen(QColor("#2d3154"));
+    p.setBrush(QColor("#141520"));
+    p.drawRoundedRect(QRectF(rect()).adjusted(0.5, 0.5, -0.5, -0.5), 4, 4);
+
+    const QRectF plot = plotRect();
+    QFont font = p.font();
+    font.setPixelSize(9);
+    p.setFont(font);
+
+    for (int k = 1; k <= 4; ++k) {
+        const double y = plot.bottom() - plot.height() * k / 4;
+        p.setPen(kGridColor);
+        p.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+        if (k % 2)
+            continue;
+        p.setPen(kLabelColor);
+        p.drawText(QRectF(0, y - 7, plot.left() - 4, 14), Qt::AlignRight | Qt::AlignVCenter,
+                   formatRate(rateMax * 8 * k / 4));
+        if (m_hasLatency)
+            p.drawText(QRectF(plot.right() + 4, y - 7, width() - plot.right() - 4, 14),
+                       Qt::AlignLeft | Qt::AlignVCenter,
+                       QString("%1 ms").arg(latencyMax * k / 4, 0, 'g', 3));
+    }
+    p.setPen(kGridColor);
+    p.drawLine(plot.bottomLeft(), plot.bottomRight());
+
+    p.setPen(kLabelColor);
+    const QRectF axis(plot.left(), plot.bottom() + 1, plot.width(), 12);
+    p.drawText(axis, Qt::AlignLeft | Qt::AlignVCenter, formatSpan(m_spanMs));
+    p.drawText(axis, Qt::AlignRight | Qt::AlignVCenter, tr("now"));
+
+    // Legend
+    QPointF pos = plot.topLeft() + QPointF(4, 10);
+    auto legend = [&](const QColor &color, const QString &text) {
+        p.setPen(color);
+        p.drawText(pos, text);
+        pos.rx() += p.fontMetrics().horizontalAdvance(text) + 10;
+    };
+    legend(kRxColor, tr("↓ Download"));
+    legend(kTxColor, tr("↑ Upload"));
+    if (m_hasLatency)
+        legend(kLatencyColor, tr("Latency"));
+}
+
+void ThroughputChart::paintEvent(QPaintEvent *)
+{
+    const qint64 from = m_nowMs - m_spanMs;
+    double rateMax = 0, latencyMax = 0;
+    for (const Trace *trace : { &m_rx, &m_tx }) {
+        for (const Bucket &b : trace->buckets) {
+            if (b.pick.x() >= from)
+                rateMax = std::max(rateMax, b.pick.y());
+        }
+    }
+    for (const Bucket &b : m_latency.buckets) {
+        if (b.pick.x() >= from)
+            latencyMax = std::max(latencyMax, b.pick.y());
+    }
+    // Scales snap to 1-2-5 steps so the background is rarely rebuilt.
+    rateMax    = niceCeil(std::max(rateMax * 8, 8000.0)) / 8;
+    latencyMax = niceCeil(std::max(latencyMax, 10.0));
+    if (m_bgDirty || rateMax != m_bgRateMax || latencyMax != m_bgLatencyMax)
+        updateBackground(rateMax, latencyMax);
+
+    QPainter p(this);
+    p.drawPixmap(0, 0, m_background);
+    if (m_nowMs == 0)
+        return;
+
+    p.setRenderHint(QPainter::Antialiasing);
+    p.setClipRect(plotRect().adjusted(0, -1, 0, 1));
+    p.setBrush(Qt::NoBrush);
+    p.setPen(QPen(kRxColor, 1.5));
+    p.drawPolyline(polyline(m_rx, rateMax));
+    p.setPen(QPen(kTxColor, 1.5));
+    p.drawPolyline(polyline(m_tx, rateMax));
+    if (m_hasLatency) {
+        p.setPen(QPen(kLatencyColor, 1.0, Qt::DotLine));
+        p.drawPolyline(polyline(m_latency, latencyMax));
+    }
+}
+
+void ThroughputChart::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    m_bgDirty = true;
+    rebuildAll(); // bucket width follows the pixel width
+}
+
+void ThroughputChart::wheelEvent(QWheelEvent *event)
+{
+    const int delta = event->angleDelta().y();
+    if (delta == 0) {
+        event->ignore();
+        return;
+    }
+    const auto current = std::find(std::begin(kSpanPresets), std::end(kSpanPresets), m_spanMs);
+    qsizetype index = current != std::end(kSpanPresets) ? current - std::begin(kSpanPresets) : 2;
+    index = std::clamp<qsizetype>(index + (delta > 0 ? -1 : 1), 0,
+                                  std::size(kSpanPresets) - 1);
+    setTimeSpan(kSpanPresets[index]);
+    event->accept();
+}
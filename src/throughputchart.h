@@ -0,0 +1,132 @@
+#pragma once
+
+#include <QList>
+#include <QPixmap>
+#include <QPointF>
+#include <QPolygonF>
+#include <QWidget>
+
+/**
+ * History of one chart value, kept at several resolutions.
+ *
+ * Level 0 holds the raw samples; each further level holds the mean of
+ * kFanOut points of the level below. Every level is capped at kLevelCapacity
+ * points, so memory is bounded. A window of any length can be served from a
+ * level that has only a few points per pixel.
+ */
+class ChartSeries
+{
+public:
+    struct Point {
+        qint64 t;   ///< ms since the epoch
+        double v;
+    };
+
+    static constexpr int kLevels        = 4;
+    static constexpr int kFanOut        = 4;
+    static constexpr int kLevelCapacity = 8192;
+
+    void append(qint64 t, double v);
+    void clear();
+
+    /// Finest level that still covers @p from and has at most @p maxPoints
+    /// points from there on.
+    int  levelFor(qint64 from, int maxPoints) const;
+    /// Appends the points of @p level with t >= @p from, including the
+    /// partially filled aggregate at the tail.
+    void collect(int level, qint64 from, QList<Point> &out) const;
+
+private:
+    struct Level {
+        QList<Point> points;
+        bool   truncated    = false; ///< points have been dropped at the front
+        // Aggregate being built from the level below.
+        double pendingSum   = 0;
+        qint64 pendingTSum  = 0;
+        int    pendingCount = 0;
+    };
+
+    void push(int level, const Point &p);
+
+    Level m_levels[kLevels];
+};
+
+/**
+ * ThroughputChart draws the receive/transmit rate and the tunnel latency of
+ * the current session.
+ *
+ * Each trace is downsampled to one point per pixel column with
+ * Largest-Triangle-Three-Buckets. The buckets are aligned to absolute time,
+ * so a new sample only changes the last few buckets, and only those are
+ * recomputed. Grid, axis labels and legend live in a cached pixmap that is
+ * rebuilt only when the size or an axis scale changes. The work per sample
+ * and per frame therefore depends on the widget width, not on how much
+ * history is visible.
+ */
+class ThroughputChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ThroughputChart(QWidget *parent = nullptr);
+
+    /// Feeds cumulative byte counters; rates come from consecutive samples.
+    void addTrafficSample(qint64 timeMs, quint64 rxBytes, quint64 txBytes);
+    void addLatencySample(qint64 timeMs, double latencyMs);
+    void clear();
+
+    /// Visible history, 1 minute … 24 hours. The mouse wheel steps through presets.
+    void   setTimeSpan(qint64 msecs);
+    qint64 timeSpan() const { return m_spanMs; }
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    friend class TestThroughputChart; // inspects the LTTB picks
+
+    struct Bucket {
+        qint64  index;       ///< t / bucket width
+        QPointF average;     ///< (t, v) mean of the bucket's points
+        QPointF pick;        ///< point kept by LTTB
+    };
+
+    struct Trace {
+        ChartSeries   history;
+        int           level = 0;
+        QList<Bucket> buckets;
+    };
+
+    QRectF plotRect() const;
+    qint64 bucketWidth() const;
+    void   rebuild(Trace &trace);
+    void   refreshTail(Trace &trace);
+    void   recompute(Trace &trace, qint64 fromIndex);
+    void   rebuildAll();
+    void   updateBackground(double rateMax, double latencyMax);
+    QPolygonF polyline(const Trace &trace, double yMax) const;
+
+    Trace   m_rx;
+    Trace   m_tx;
+    Trace   m_latency;
+    bool    m_hasLatency = false;
+
+    qint64  m_spanMs = 10 * 60 * 1000;
+    qint64  m_nowMs  = 0;           ///< time of the newest sample
+
+    qint64  m_lastTrafficMs = 0;
+    quint64 m_lastRx = 0;
+    quint64 m_lastTx = 0;
+
+    QPixmap m_background;
+    double  m_bgRateMax    = 0;
+    double  m_bgLatencyMax = 0;
+    bool    m_bgDirty      = true;
+
+    QList<ChartSeries::Point> m_scratch;      ///< reused by recompute()
+    QList<int>                m_bucketStarts; ///< bucket → first index in m_scratch
+};
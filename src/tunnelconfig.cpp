@@ -0,0 +1,318 @@
+#include "tunnelconfig.h"
+#include "cidrset.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <utility>
+
+namespace {
+
+// [Interface] keys that `wg` itself applies; everything else is wg-quick's.
+bool isWgInterfaceKey(const QString &key)
+{
+    return key.compare("PrivateKey", Qt::CaseInsensitive) == 0
+        || key.compare("ListenPort", Qt::CaseInsensitive) == 0
+        || key.compare("FwMark", Qt::CaseInsensitive) == 0;
+}
+
+/// Canonical "key=value" lines of a section, keys lower-cased.
+QStringList canonicalEntries(const TunnelConfig::Section &section)
+{
+    QStringList out;
+    for (const TunnelConfig::Entry &e : section.entries)
+        out << e.key.toLower() + '=' + e.value.trimmed();
+    return out;
+}
+
+/// Routes wg-quick installs for @p config: every non-/0 AllowedIPs prefix,
+/// unless Table = off. Sets @p defaults to the /0 prefixes.
+QSet<QString> routedPrefixes(const TunnelConfig &config, QSet<QString> *defaults)
+{
+    QSet<QString> out;
+    const TunnelConfig::Section *iface = config.interfaceSection();
+    if (iface && iface->value("Table").compare("off", Qt::CaseInsensitive) == 0)
+        return out;
+    for (const TunnelConfig::Section *peer : config.peers()) {
+        for (const QString &allowed : peer->list("AllowedIPs")) {
+            CidrPrefix prefix;
+            if (!CidrPrefix::parse(allowed, &prefix))
+                continue;
+            if (prefix.length == 0)
+                defaults->insert(prefix.toString());
+            else
+                out.insert(prefix.toString());
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+// ── Section ──────────────────────────────────────────────────────────────────
+QString TunnelConfig::Section::value(const QString &key) const
+{
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (entries[i].key.compare(key, Qt::CaseInsensitive) == 0)
+            return entries[i].value;
+    }
+    return {};
+}
+
+QStringList TunnelConfig::Section::list(const QString &key) const
+{
+    QStringList out;
+    for (const Entry &e : entries) {
+        if (e.key.compare(key, Qt::CaseInsensitive) != 0)
+            continue;
+        for (const QString &part : e.value.split(',', Qt::SkipEmptyParts)) {
+            const QString trimmed = part.trimmed();
+            if (!trimmed.isEmpty())
+                out << trimmed;
+        }
+    }
+    return out;
+}
+
+void TunnelConfig::Section::setList(const QString &key, const QStringList &values)
+{
+    int firstIndex = -1;
+    for (int i = entries.size() - 1; i >= 0; --i) {
+        if (entries[i].key.compare(key, Qt::CaseInsensitive) == 0) {
+            entries.removeAt(i);
+            firstIndex = i;
+        }
+    }
+    const Entry e { key, values.join(", ") };
+    if (firstIndex < 0)
+        entries.append(e);
+    else
+        entries.insert(firstIndex, e);
+}
+
+bool TunnelConfig::Section::contains(const QString &key) const
+{
+    for (const Entry &e : entries) {
+        if (e.key.compare(key, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+// ── Parsing ──────────────────────────────────────────────────────────────────
+TunnelConfig TunnelConfig::parse(const QString &text)
+{
+    TunnelConfig cfg;
+    const QStringList lines = text.split('\n');
+    for (const QString &rawLine : lines) {
+        QString line = rawLine;
+        const int hash = line.indexOf('#');
+        if (hash >= 0)
+            line.truncate(hash);
+        line = line.trimmed();
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith('[') && line.endsWith(']')) {
+            cfg.m_sections.append(Section { line.mid(1, line.size() - 2).trimmed(), {} });
+            continue;
+        }
+
+        const int eq = line.indexOf('=');
+        if (eq <= 0 || cfg.m_sections.isEmpty())
+            continue;
+        cfg.m_sections.last().entries.append(Entry { line.left(eq).trimmed(),
+                                                     line.mid(eq + 1).trimmed() });
+    }
+    return cfg;
+}
+
+TunnelConfig TunnelConfig::load(const QString &path, QString *error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (error)
+            *error = f.errorString();
+        return {};
+    }
+    return parse(QString::fromUtf8(f.readAll()));
+}
+
+// ── Accessors ────────────────────────────────────────────────────────────────
+const TunnelConfig::Section *TunnelConfig::interfaceSection() const
+{
+    for (const Section &s : m_sections) {
+        if (s.name.compare("Interface", Qt::CaseInsensitive) == 0)
+            return &s;
+    }
+    return nullptr;
+}
+
+TunnelConfig::Section *TunnelConfig::interfaceSection()
+{
+    return const_cast<Section *>(std::as_const(*this).interfaceSection());
+}
+
+QList<const TunnelConfig::Section *> TunnelConfig::peers() const
+{
+    QList<const Section *> out;
+    for (const Section &s : m_sections) {
+        if (s.name.compare("Peer", Qt::CaseInsensitive) == 0)
+            out << &s;
+    }
+    return out;
+}
+
+QList<TunnelConfig::Section *> TunnelConfig::peers()
+{
+    QList<Section *> out;
+    for (Section &s : m_sections) {
+        if (s.name.compare("Peer", Qt::CaseInsensitive) == 0)
+            out << &s;
+    }
+    return out;
+}
+
+bool TunnelConfig::hasExtensions() const
+{
+    for (const Section &s : m_sections) {
+        if (s.name.compare(kExtensionSection, Qt::CaseInsensitive) == 0)
+            return true;
+    }
+    return false;
+}
+
+QString TunnelConfig::option(const QString &key, const QString &fallback) const
+{
+    for (const Section &s : m_sections) {
+        if (s.name.compare(kExtensionSection, Qt::CaseInsensitive) == 0 && s.contains(key))
+            return s.value(key);
+    }
+    return fallback;
+}
+
+QStringList TunnelConfig::optionList(const QString &key) const
+{
+    QStringList out;
+    for (const Section &s : m_sections) {
+        if (s.name.compare(kExtensionSection, Qt::CaseInsensitive) == 0)
+            out += s.list(key);
+    }
+    return out;
+}
+
+QString TunnelConfig::toString() const
+{
+    QString out;
+    for (const Section &s : m_sections) {
+        if (s.name.compare(kExtensionSection, Qt::CaseInsensitive) == 0)
+            continue;
+        if (!out.isEmpty())
+            out += '\n';
+        out += '[' + s.name + "]\n";
+        for (const Entry &e : s.entries)
+            out += e.key + " = " + e.value + '\n';
+    }
+    return out;
+}
+
+bool TunnelConfig::splitEndpoint(const QString &endpoint, QString *host, quint16 *port)
+{
+    const int colon = endpoint.lastIndexOf(':');
+    if (colon <= 0)
+        return false;
+    QString h = endpoint.left(colon).trimmed();
+    if (h.startsWith('[') && h.endsWith(']'))
+        h = h.mid(1, h.size() - 2);
+    bool ok = false;
+    const uint p = endpoint.mid(colon + 1).toUInt(&ok);
+    if (!ok || p == 0 || p > 65535 || h.isEmpty())
+        return false;
+    *host = h;
+    *port = quint16(p);
+    return true;
+}
+
+QString TunnelConfig::toWgString() const
+{
+    QString out;
+    for (const Section &s : m_sections) {
+        const bool isInterface = s.name.compare("Interface", Qt::CaseInsensitive) == 0;
+        if (!isInterface && s.name.compare("Peer", Qt::CaseInsensitive) != 0)
+            continue;
+        if (!out.isEmpty())
+            out += '\n';
+        out += '[' + s.name + "]\n";
+        for (const Entry &e : s.entries) {
+            if (!isInterface || isWgInterfaceKey(e.key))
+                out += e.key + " = " + e.value + '\n';
+        }
+    }
+    return out;
+}
+
+// ── Diff ─────────────────────────────────────────────────────────────────────
+bool TunnelConfig::Diff::isEmpty() const
+{
+    return interfaceKeys.isEmpty() && peersAdded.isEmpty() && peersRemoved.isEmpty()
+        && peersUpdated.isEmpty() && routesAdded.isEmpty() && routesRemoved.isEmpty()
+        && !defaultRouteChanged;
+}
+
+bool TunnelConfig::Diff::isLive() const
+{
+    if (defaultRouteChanged)
+        return false; // wg-quick sets up fwmark policy routing for /0
+    for (const QString &key : interfaceKeys) {
+        if (!isWgInterfaceKey(key))
+            return false;
+        if (defaultRouted && key.compare("FwMark", Qt::CaseInsensitive) == 0)
+            return false;
+    }
+    return true;
+}
+
+TunnelConfig::Diff TunnelConfig::diff(const TunnelConfig &from, const TunnelConfig &to)
+{
+    Diff d;
+
+    // [Interface]: compare every key present on either side.
+    const Section empty;
+    const Section *a = from.interfaceSection() ? from.interfaceSection() : &empty;
+    const Section *b = to.interfaceSection() ? to.interfaceSection() : &empty;
+    QSet<QString> keys;
+    for (const Entry &e : a->entries)
+        keys.insert(e.key.toLower());
+    for (const Entry &e : b->entries)
+        keys.insert(e.key.toLower());
+    for (const QString &key : std::as_const(keys)) {
+        if (a->list(key) != b->list(key))
+            d.interfaceKeys << key;
+    }
+    d.interfaceKeys.sort();
+
+    // Peers, matched by public key.
+    QHash<QString, const Section *> before;
+    for (const Section *peer : from.peers())
+        before.insert(peer->value("PublicKey"), peer);
+    for (const Section *peer : to.peers()) {
+        const QString key = peer->value("PublicKey");
+        const Section *old = before.take(key);
+        if (!old)
+            d.peersAdded << key;
+        else if (canonicalEntries(*old) != canonicalEntries(*peer))
+            d.peersUpdated << key;
+    }
+    d.peersRemoved = before.keys();
+
+    QSet<QString> defaultsBefore, defaultsAfter;
+    const QSet<QString> routesBefore = routedPrefixes(from, &defaultsBefore);
+    const QSet<QString> routesAfter  = routedPrefixes(to, &defaultsAfter);
+    d.routesAdded   = QSet<QString>(routesAfter).subtract(routesBefore).values();
+    d.routesRemoved = QSet<QString>(routesBefore).subtract(routesAfter).values();
+    d.routesAdded.sort();
+    d.routesRemoved.sort();
+    d.defaultRouteChanged = defaultsBefore != defaultsAfter;
+    d.defaultRouted = !defaultsAfter.isEmpty();
+    return d;
+}
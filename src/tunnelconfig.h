@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/**
+ * TunnelConfig is an in-memory WireGuard / wg-quick configuration.
+ *
+ * Besides the standard [Interface] and [Peer] sections it understands a
+ * client-only [DKT] section holding DKT VPN options (split tunnelling …).
+ * wg-quick rejects unknown keys, so toString() leaves that section out and
+ * VpnManager hands wg-quick a generated copy whenever [DKT] is present.
+ */
+class TunnelConfig
+{
+public:
+    static constexpr const char *kExtensionSection = "DKT";
+
+    struct Entry {
+        QString key;
+        QString value;
+    };
+
+    struct Section {
+        QString      name;
+        QList<Entry> entries;
+
+        /// Value of the last @p key entry (case-insensitive), or empty.
+        QString value(const QString &key) const;
+        /// All values of every @p key entry, split on commas.
+        QStringList list(const QString &key) const;
+        /// Replaces every @p key entry with one comma-joined entry.
+        void setList(const QString &key, const QStringList &values);
+        bool contains(const QString &key) const;
+    };
+
+    static TunnelConfig parse(const QString &text);
+    /// Reads and parses @p path; sets @p error and returns an empty config on failure.
+    static TunnelConfig load(const QString &path, QString *error = nullptr);
+
+    bool isEmpty() const { return m_sections.isEmpty(); }
+
+    const Section *interfaceSection() const;
+    Section       *interfaceSection();
+    QList<const Section *> peers() const;
+    QList<Section *>       peers();
+
+    bool hasExtensions() const;
+    /// Value of a [DKT] option, or @p fallback when it is not set.
+    QString option(const QString &key, const QString &fallback = {}) const;
+    QStringList optionList(const QString &key) const;
+
+    /// wg-quick compatible text, without the [DKT] section.
+    QString toString() const;
+    /// Text for `wg setconf` / `wg syncconf`: like toString(), minus the
+    /// [Interface] keys only wg-quick understands (Address, DNS, MTU, hooks …).
+    QString toWgString() const;
+
+    /// What changed between two versions of the same tunnel's config.
+    struct Diff {
+        QStringList interfaceKeys;   ///< changed [Interface] keys
+        QStringList peersAdded;      ///< public keys
+        QStringList peersRemoved;
+        QStringList peersUpdated;
+        QStringList routesAdded;     ///< AllowedIPs prefixes other than /0
+        QStringList routesRemoved;
+        bool        defaultRouteChanged = false; ///< a /0 appeared or went away
+        bool        defaultRouted = false;       ///< the new config routes a /0
+
+        bool isEmpty() const;
+        /// True if `wg syncconf` plus the route delta reproduces the new
+        /// config; false if wg-quick must recreate the interface. FwMark is
+        /// live only without a /0: wg-quick's `not fwmark` rule keeps the
+        /// old mark, and the tunnel's own packets would loop into it.
+        bool isLive() const;
+    };
+    static Diff diff(const TunnelConfig &from, const TunnelConfig &to);
+
+    /// Splits "host:port" / "[v6]:port" into its parts.
+    static bool splitEndpoint(const QString &endpoint, QString *host, quint16 *port);
+
+private:
+    QList<Section> m_sections;
+};
@@ -1,48 +1,245 @@
 #include "vpnmanager.h"
+#include "cidrset.h"
+#include "logger.h"
+#include "netwatcher.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
 #include <QStandardPaths>
 #include <QProcess>
 #include <QRegularExpression>
-#include <QDebug>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#  include <cerrno>
+#  include <cstring>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#  include <linux/capability.h>
+#  include <sys/prctl.h>
+#  include <sys/syscall.h>
+#endif
 
 // ── Platform guards ──────────────────────────────────────────────────────────
 #ifdef Q_OS_WIN
 #  include <windows.h>
 #endif
 
+namespace {
+
+const char *statusName(VpnStatus s)
+{
+    switch (s) {
+    case VpnStatus::Disconnected:  return "disconnected";
+    case VpnStatus::Connecting:    return "connecting";
+    case VpnStatus::Connected:     return "connected";
+    case VpnStatus::Disconnecting: return "disconnecting";
+    case VpnStatus::Error:         return "error";
+    }
+    return "unknown";
+}
+
+/// Reads a prefix list file: whitespace or comma separated, '#' comments.
+QStringList readPrefixList(const QString &path, bool *ok)
+{
+    QFile f(path);
+    *ok = f.open(QIODevice::ReadOnly | QIODevice::Text);
+    QStringList out;
+    if (!*ok)
+        return out;
+    static const QRegularExpression separators(R"([\s,]+)");
+    while (!f.atEnd()) {
+        QString line = QString::fromUtf8(f.readLine());
+        const int hash = line.indexOf('#');
+        if (hash >= 0)
+            line.truncate(hash);
+        out += line.split(separators, Qt::SkipEmptyParts);
+    }
+    return out;
+}
+
+/// Path of an external tool: $DKT_VPN_TOOL_DIR first (unusual install
+/// layouts, and the stand-ins the tests use), then the usual install
+/// locations, then PATH. Empty when the tool is nowhere to be found.
+QString toolPath(const char *name, std::initializer_list<const char *> candidates)
+{
+    const QString tool = QString::fromUtf8(name);
+    const QString dir = qEnvironmentVariable("DKT_VPN_TOOL_DIR");
+    if (!dir.isEmpty() && QFileInfo(dir + '/' + tool).isExecutable())
+        return dir + '/' + tool;
+    for (const char *p : candidates) {
+        if (QFileInfo::exists(QString::fromUtf8(p)))
+            return QString::fromUtf8(p);
+    }
+    return QStandardPaths::findExecutable(tool);
+}
+
+/// Addresses an Endpoint host stands for: the literal itself, or whatever
+/// DNS returns right now (wg resolves the name the same way at `wg set`).
+QList<QHostAddress> endpointAddresses(const QString &host)
+{
+    const QHostAddress literal(host);
+    if (!literal.isNull())
+        return { literal };
+    QList<QHostAddress> addresses = QHostInfo::fromName(host).addresses();
+    for (QHostAddress &a : addresses)
+        a.setScopeId({});
+    return addresses;
+}
+
+#ifdef Q_OS_LINUX
+/// With CAP_NET_ADMIN permitted (e.g. `setcap cap_net_admin+ep dkt_vpn`),
+/// adds it to the calling thread's inheritable and ambient sets so programs
+/// it starts keep it. False when the capability is not available.
+bool raiseAmbientNetAdmin()
+{
+    if (::prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_IS_SET, CAP_NET_ADMIN, 0, 0) == 1)
+        return true;
+    __user_cap_header_struct header { _LINUX_CAPABILITY_VERSION_3, 0 };
+    __user_cap_data_struct   data[_LINUX_CAPABILITY_U32S_3] {};
+    if (::syscall(SYS_capget, &header, data) != 0)
+        return false;
+    const quint32 bit = quint32(1) << CAP_NET_ADMIN; // in the first word
+    if (!(data[0].permitted & bit))
+        return false;
+    data[0].inheritable |= bit;
+    return ::syscall(SYS_capset, &header, data) == 0
+        && ::prctl(PR_CAP_AMBIENT, PR_CAP_AMBIENT_RAISE, CAP_NET_ADMIN, 0, 0) == 0;
+}
+#endif
+
+QString shellQuote(const QString &s)
+{
+    QString out = s;
+    out.replace('\'', "'\\''");
+    return '\'' + out + '\'';
+}
+
+/// In-tunnel probe target: [DKT] ProbeTarget ("addr" for ICMP echo,
+/// "addr:port" / "[v6]:port" for UDP echo, "off"), else a DNS server inside
+/// the tunnel's /16, else the .1 of the tunnel address's /24 (the usual
+/// gateway of WireGuard providers).
+bool probeTarget(const TunnelConfig &config, QHostAddress *address, quint16 *port)
+{
+    *port = 0;
+    const QString option = config.option("ProbeTarget").trimmed();
+    if (option.compare("off", Qt::CaseInsensitive) == 0)
+        return false;
+    if (!option.isEmpty()) {
+        QString host = option;
+        if ((option.count(':') == 1 || option.startsWith('['))
+            && !TunnelConfig::splitEndpoint(option, &host, port))
+            return false;
+        return address->setAddress(host);
+    }
+
+    const TunnelConfig::Section *iface = config.interfaceSection();
+    if (!iface)
+        return false;
+    for (const QString &cidr : iface->list("Address")) {
+        const QHostAddress own(cidr.section('/', 0, 0));
+        if (own.protocol() != QAbstractSocket::IPv4Protocol)
+            continue;
+        for (const QString &dns : iface->list("DNS")) {
+            const QHostAddress server(dns);
+            if (server.isInSubnet(own, 16) && server != own) {
+                *address = server;
+                return true;
+            }
+        }
+        const quint32 gateway = (own.toIPv4Address() & 0xFFFFFF00u) | 1u;
+        if (gateway != own.toIPv4Address()) {
+            *address = QHostAddress(gateway);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool queueOptionsChanged(const TunnelConfig &a, const TunnelConfig &b)
+{
+    for (const char *key : { "QueueDiscipline", "ShapeRate", "DscpClassify" }) {
+        if (a.option(key) != b.option(key))
+            return true;
+    }
+    return false;
+}
+
+/// TunnelMetrics::queue slot of a QueueShaper class name, or -1.
+int queueClassSlot(const QString &name)
+{
+    for (int i = 0; i < TunnelMetrics::kQueueClasses; ++i) {
+        if (name == QLatin1String(TunnelMetrics::kQueueClassNames[i]))
+            return i;
+    }
+    return -1;
+}
+
+} // namespace
+
 // ────────────────────────────────────────────────────────────────────────────
 VpnManager::VpnManager(QObject *parent)
     : QObject(parent)
 {
+    qRegisterMetaType<VpnStatus>();
+    qRegisterMetaType<VpnStats>();
+    qRegisterMetaType<QList<VpnServer>>();
+    qRegisterMetaType<LatencyQuality>();
+    qRegisterMetaType<QueueStats>();
+
     m_pollTimer = new QTimer(this);
     m_pollTimer->setInterval(2000);
     connect(m_pollTimer, &QTimer::timeout, this, &VpnManager::pollStats);
+
+    m_reloadTimer = new QTimer(this);
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(500);
+    connect(m_reloadTimer, &QTimer::timeout, this, &VpnManager::reloadConfig);
+
+    m_netWatcher = new NetworkWatcher(this);
+    connect(m_netWatcher, &NetworkWatcher::networkChanged,
+            this, &VpnManager::onNetworkChanged);
 }
 
-VpnManager::~VpnManager()
+// ── Public API ───────────────────────────────────────────────────────────────
+bool VpnManager::forwardToOwnThread(std::function<void()> call)
 {
-    if (m_connectProcess) {
-        m_connectProcess->kill();
-        m_connectProcess->waitForFinished(1000);
-    }
-    if (m_disconnectProcess) {
-        m_disconnectProcess->kill();
-        m_disconnectProcess->waitForFinished(1000);
-    }
-    if (m_statsProcess) {
-        m_statsProcess->kill();
-        m_statsProcess->waitForFinished(1000);
-    }
+    if (QThread::currentThread() == thread())
+        return false;
+    QMetaObject::invokeMethod(this, std::move(call), Qt::QueuedConnection);
+    return true;
+}
+
+void VpnManager::initialize()
+{
+    const QList<VpnServer> bonds = bondedServers();
+    if (!bonds.isEmpty())
+        emit bondsDiscovered(bonds);
 }
 
-// ── Public API ───────────────────────────────────────────────────────────────
 void VpnManager::connectToServer(const VpnServer &server)
 {
-    if (m_status == VpnStatus::Connecting || m_status == VpnStatus::Connected)
+    if (forwardToOwnThread([this, server] { connectToServer(server); }))
+        return;
+    if (m_shuttingDown || m_status == VpnStatus::Connecting || m_status == VpnStatus::Connected)
+        return;
+
+    m_connectClock.start();
+    m_bond.reset();
+    m_shaper.reset();
+    if (!server.bondMembers.isEmpty()) {
+        connectBonded(server);
         return;
+    }
 
     QString configFile = resolveConfigFile(server.configName);
     if (configFile.isEmpty()) {
@@ -56,7 +253,24 @@ void VpnManager::connectToServer(const VpnServer &server)
 
     m_currentServerName = server.country;
     m_currentConfigName = server.configName;
+    m_currentServer     = server;
+    m_sourceConfigFile  = configFile;
+
+    QString error;
+    configFile = prepareRuntimeConfig(configFile, &error);
+    m_metrics.observeConnectPhase(VpnMetrics::PhaseResolveConfig,
+                                  m_connectClock.nsecsElapsed() / 1e9);
+    if (configFile.isEmpty()) {
+        removeRuntimeFiles();
+        setStatus(VpnStatus::Error,
+                  tr("Could not prepare the configuration for %1.\n%2")
+                  .arg(server.country, error));
+        return;
+    }
+
     m_currentConfigFile = configFile;
+    m_tunnelMetrics     = m_metrics.tunnel(server.configName);
+    m_awaitingHandshake = false;
 
     setStatus(VpnStatus::Connecting, tr("Connecting to %1…").arg(server.country));
     runConnectCommand(configFile);
@@ -64,14 +278,62 @@ void VpnManager::connectToServer(const VpnServer &server)
 
 void VpnManager::disconnect()
 {
-    if (m_status == VpnStatus::Disconnected || m_status == VpnStatus::Disconnecting)
+    if (forwardToOwnThread([this] { disconnect(); }))
+        return;
+    if (m_shuttingDown
+        || m_status == VpnStatus::Disconnected || m_status == VpnStatus::Disconnecting)
         return;
 
     m_pollTimer->stop();
+    m_netWatcher->stop();
+    stopProbers();
+    unwatchConfig();
+    m_roaming = false;
     setStatus(VpnStatus::Disconnecting, tr("Disconnecting…"));
     runDisconnectCommand();
 }
 
+void VpnManager::shutdown()
+{
+    if (forwardToOwnThread([this] { shutdown(); }))
+        return;
+    if (m_shuttingDown)
+        return;
+    m_shuttingDown = true;
+    m_pollTimer->stop();
+    m_netWatcher->stop();
+    stopProbers();
+    unwatchConfig();
+
+    // Results of commands that are still running no longer matter; kill
+    // them and report back once they have been reaped.
+    for (QProcess *process : findChildren<QProcess *>()) {
+        if (process->state() == QProcess::NotRunning)
+            continue;
+        QObject::disconnect(process, nullptr, this, nullptr);
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, [this] { --m_pendingExits; checkShutdown(); });
+        ++m_pendingExits;
+        process->kill();
+    }
+    // A process stuck in the kernel must not hold up the exit forever.
+    QTimer::singleShot(2000, this, [this] {
+        if (m_pendingExits > 0) {
+            m_pendingExits = 0;
+            checkShutdown();
+        }
+    });
+    checkShutdown();
+}
+
+void VpnManager::checkShutdown()
+{
+    if (!m_shuttingDown || m_pendingExits != 0)
+        return;
+    m_pendingExits = -1; // reported
+    emit shutdownFinished();
+}
+
 // ── Config directory resolution ──────────────────────────────────────────────
 QString VpnManager::configDirectory() const
 {
@@ -119,22 +381,295 @@ QString VpnManager::resolveConfigFile(const QString &configName) const
     return {};
 }
 
+QString VpnManager::runtimeConfigDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/runtime";
+}
+
+TunnelConfig VpnManager::loadEffectiveConfig(const QString &configFile, QString *error)
+{
+    TunnelConfig config = TunnelConfig::load(configFile, error);
+    if (config.isEmpty()) {
+        if (error->isEmpty())
+            *error = tr("%1 does not contain a WireGuard configuration.").arg(configFile);
+        return {};
+    }
+    if (config.hasExtensions()
+        && !applySplitTunnel(config, QFileInfo(configFile).absolutePath(), error))
+        return {};
+    return config;
+}
+
+QString VpnManager::prepareRuntimeConfig(const QString &configFile, QString *error)
+{
+    const TunnelConfig config = loadEffectiveConfig(configFile, error);
+    if (config.isEmpty() || !setupShaper(config, error))
+        return {};
+    m_activeConfig = config;
+    if (!config.hasExtensions())
+        return configFile; // plain wg-quick config, use it as-is
+
+    // wg-quick installs the qdisc from its own privileged run, so there is
+    // no second prompt. Only the runtime copy gets the hook: m_activeConfig
+    // stays hook-free and the native backend can still take it.
+    TunnelConfig runtime = config;
+    if (m_shaper && runtime.interfaceSection())
+        runtime.interfaceSection()->entries.append({ "PostUp", m_shaper->postUpCommand() });
+
+    // wg-quick derives the interface name from the file name, so keep it.
+    return writeRuntimeFile(QFileInfo(configFile).fileName(), runtime.toString(), error);
+}
+
+QString VpnManager::writeRuntimeFile(const QString &fileName, const QString &content,
+                                     QString *error)
+{
+    const QString dir = runtimeConfigDirectory();
+    QDir().mkpath(dir);
+    QFile::setPermissions(dir, QFileDevice::ReadOwner | QFileDevice::WriteOwner
+                                   | QFileDevice::ExeOwner);
+    const QString path = dir + "/" + fileName;
+    QFile out;
+#ifdef Q_OS_UNIX
+    // The copy may hold a private key, so it is 0600 from the moment it
+    // exists. An older copy is removed first; it would keep its own mode.
+    QFile::remove(path);
+    const int fd = ::open(QFile::encodeName(path).constData(),
+                          O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        *error = tr("Cannot write %1: %2").arg(path, QString::fromLocal8Bit(std::strerror(errno)));
+        return {};
+    }
+    out.open(fd, QIODevice::WriteOnly | QIODevice::Text, QFileDevice::AutoCloseHandle);
+#else
+    out.setFileName(path);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        *error = tr("Cannot write %1: %2").arg(path, out.errorString());
+        return {};
+    }
+    out.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+#endif
+    if (out.write(content.toUtf8()) < 0 || !out.flush()) {
+        *error = tr("Cannot write %1: %2").arg(path, out.errorString());
+        return {};
+    }
+    if (!m_runtimeFiles.contains(path))
+        m_runtimeFiles << path;
+    return path;
+}
+
+void VpnManager::removeRuntimeFiles()
+{
+    for (const QString &path : std::as_const(m_runtimeFiles))
+        QFile::remove(path);
+    m_runtimeFiles.clear();
+}
+
+// ── Bonding ──────────────────────────────────────────────────────────────────
+QList<VpnServer> VpnManager::bondedServers() const
+{
+#ifdef Q_OS_LINUX
+    const QString path = resolveConfigFile("bonding");
+    if (!path.isEmpty())
+        return BondPlanner::loadDefinitions(path);
+#endif
+    return {};
+}
+
+void VpnManager::connectBonded(const VpnServer &server)
+{
+    m_currentServerName = server.country;
+    m_currentConfigName = server.configName;
+    m_currentServer     = server;
+    m_sourceConfigFile.clear(); // bonds are not hot-reloaded
+
+    QString error;
+    QList<BondMember> members;
+    for (const QString &name : server.bondMembers) {
+        const QString source = resolveConfigFile(name);
+        if (source.isEmpty()) {
+            error = tr("Config file not found for %1.").arg(name);
+            break;
+        }
+        BondMember member;
+        member.tunnel = name;
+        member.config = TunnelConfig::load(source, &error);
+        TunnelConfig::Section *iface = member.config.interfaceSection();
+        if (!iface) {
+            if (error.isEmpty())
+                error = tr("%1 has no [Interface] section.").arg(source);
+            break;
+        }
+        // Routing is done by the bond's policy rules, not by wg-quick, and
+        // the members' own UDP packets must bypass the flow marking.
+        iface->setList("Table", { "off" });
+        iface->setList("FwMark", { QString::number(BondPlanner::kWireGuardMark) });
+        member.configFile = writeRuntimeFile(name + ".conf", member.config.toString(), &error);
+        if (member.configFile.isEmpty())
+            break;
+        members << member;
+    }
+
+    m_metrics.observeConnectPhase(VpnMetrics::PhaseResolveConfig,
+                                  m_connectClock.nsecsElapsed() / 1e9);
+    if (!error.isEmpty()) {
+        m_bond.reset();
+        removeRuntimeFiles();
+        setStatus(VpnStatus::Error,
+                  tr("Could not prepare bond %1.\n%2").arg(server.country, error));
+        return;
+    }
+
+    // The scripts run as root, so they are passed to `sh -c` rather than
+    // left in a directory the user can write to.
+    m_bond = std::make_unique<BondPlanner>(server.country, members);
+    m_bondDownScript    = m_bond->downScript(wgQuickPath());
+    m_tunnelMetrics     = m_metrics.bond(server.configName);
+    m_awaitingHandshake = false;
+    m_lastRebalanceMs   = 0;
+    m_bondRebalancing   = runsWithoutPrompt("nft");
+    if (!m_bondRebalancing)
+        Logger::instance().log(LogLevel::Warning, "bonding", server.configName,
+                               tr("Not root and no CAP_NET_ADMIN; flows keep their initial "
+                                  "spread and a failing member is not taken out"));
+
+    setStatus(VpnStatus::Connecting,
+              tr("Bonding %1 (%2)…").arg(server.country, server.bondMembers.join(", ")));
+    runConnectCommand(m_bond->upScript(wgQuickPath()));
+}
+
+void VpnManager::rebalanceBond(bool urgent)
+{
+    // Every change would be another password prompt.
+    if (!m_bondRebalancing)
+        return;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    // Weight drift is applied at most every 10 s; health changes at once.
+    if (!urgent && now - m_lastRebalanceMs < 10000)
+        return;
+    m_lastRebalanceMs = now;
+    if (!m_bond->rebalance())
+        return;
+
+    QStringList weights;
+    for (const BondMember &m : m_bond->members())
+        weights << QString("%1=%2").arg(m.tunnel).arg(m.weight / 125000.0, 0, 'f', 1);
+    Logger::instance().log(LogLevel::Info, "bonding", m_currentConfigName,
+                           tr("Rebalancing flows"),
+                           { { "weights_mbit", weights.join(',') } });
+
+    runPrivileged("nft", { "-f", "/dev/stdin" }, [this](int exitCode, const QByteArray &output) {
+        if (exitCode != 0)
+            Logger::instance().logRaw(LogLevel::Warning, "nft", m_currentConfigName, output);
+    }, m_bond->nftRuleset().toUtf8());
+}
+
+/**
+ * Split tunnelling: [DKT] SplitInclude / SplitExclude (and the *File
+ * variants pointing at prefix lists) are folded into every peer's
+ * AllowedIPs as the minimal equivalent prefix set.
+ */
+bool VpnManager::applySplitTunnel(TunnelConfig &config, const QString &baseDir, QString *error)
+{
+    QStringList includes = config.optionList("SplitInclude");
+    QStringList excludes = config.optionList("SplitExclude");
+
+    auto readLists = [&](const char *key, QStringList &into) {
+        for (const QString &file : config.optionList(key)) {
+            const QString path = QDir(baseDir).absoluteFilePath(file);
+            bool ok = false;
+            into += readPrefixList(path, &ok);
+            if (!ok) {
+                *error = tr("Cannot read prefix list %1").arg(path);
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!readLists("SplitIncludeFile", includes) || !readLists("SplitExcludeFile", excludes))
+        return false;
+    if (includes.isEmpty() && excludes.isEmpty())
+        return true;
+
+    QElapsedTimer clock;
+    clock.start();
+    for (TunnelConfig::Section *peer : config.peers()) {
+        CidrSet set;
+        QStringList invalid = set.include(peer->list("AllowedIPs"));
+        invalid += set.include(includes);
+        invalid += set.exclude(excludes);
+        if (!invalid.isEmpty()) {
+            *error = tr("Invalid split-tunnel prefix: %1").arg(invalid.first());
+            return false;
+        }
+
+        // Once AllowedIPs is no longer a /0, wg-quick installs plain routes;
+        // keep the endpoint itself outside the tunnel to avoid a routing loop.
+        QString host;
+        quint16 port = 0;
+        if (TunnelConfig::splitEndpoint(peer->value("Endpoint"), &host, &port)) {
+            const QList<QHostAddress> addresses = endpointAddresses(host);
+            if (addresses.isEmpty()) {
+                *error = tr("Cannot resolve endpoint %1; it has to be kept out of the "
+                            "split tunnel").arg(host);
+                return false;
+            }
+            for (const QHostAddress &address : addresses) {
+                bool ok = false;
+                const CidrPrefix endpoint = CidrPrefix::host(address.toString(), &ok);
+                if (ok)
+                    set.exclude(endpoint);
+            }
+        }
+
+        QStringList allowed;
+        const QList<CidrPrefix> prefixes = set.aggregate();
+        allowed.reserve(prefixes.size());
+        for (const CidrPrefix &p : prefixes)
+            allowed << p.toString();
+        peer->setList("AllowedIPs", allowed);
+
+        Logger::instance().log(LogLevel::Info, "split-tunnel", m_currentConfigName,
+                               tr("AllowedIPs aggregated"),
+                               { { "include_rules", int(includes.size()) },
+                                 { "exclude_rules", int(excludes.size()) },
+                                 { "prefixes", int(allowed.size()) },
+                                 { "elapsed_ms", clock.elapsed() } });
+    }
+    return true;
+}
+
 // ── Platform-specific command helpers ────────────────────────────────────────
 QString VpnManager::wgQuickPath() const
 {
 #ifdef Q_OS_WIN
     return {};
 #else
-    for (const char *p : { "/usr/bin/wg-quick",
-                           "/usr/local/bin/wg-quick",
-                           "/opt/homebrew/bin/wg-quick" }) {
-        if (QFileInfo::exists(QString::fromUtf8(p)))
-            return QString::fromUtf8(p);
-    }
-    return "wg-quick"; // rely on PATH
+    const QString path = toolPath("wg-quick", { "/usr/bin/wg-quick",
+                                                "/usr/local/bin/wg-quick",
+                                                "/opt/homebrew/bin/wg-quick" });
+    return path.isEmpty() ? QStringLiteral("wg-quick") : path;
 #endif
 }
 
+QString VpnManager::wgPath() const
+{
+    const QString path = toolPath("wg", { "/usr/bin/wg", "/usr/local/bin/wg",
+                                          "/opt/homebrew/bin/wg" });
+    return path.isEmpty() ? QStringLiteral("wg") : path;
+}
+
+QString VpnManager::tcPath() const
+{
+    return toolPath("tc", { "/usr/sbin/tc", "/sbin/tc", "/usr/bin/tc" });
+}
+
+QString VpnManager::ipPath() const
+{
+    const QString path = toolPath("ip", { "/usr/sbin/ip", "/sbin/ip", "/usr/bin/ip",
+                                          "/bin/ip" });
+    return path.isEmpty() ? QStringLiteral("ip") : path;
+}
+
 QString VpnManager::wireguardExePath() const
 {
 #ifdef Q_OS_WIN
@@ -159,7 +694,8 @@ void VpnManager::runConnectCommand(const QString &configFile)
     m_connectProcess->setProcessChannelMode(QProcess::MergedChannels);
 
     connect(m_connectProcess, &QProcess::readyReadStandardOutput, this, [this]() {
-        emit logMessage(QString::fromLocal8Bit(m_connectProcess->readAllStandardOutput()));
+        Logger::instance().logRaw(LogLevel::Info, "wg-quick", m_currentConfigName,
+                                  m_connectProcess->readAllStandardOutput());
     });
     connect(m_connectProcess,
             QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
@@ -167,22 +703,23 @@ void VpnManager::runConnectCommand(const QString &configFile)
     connect(m_connectProcess, &QProcess::errorOccurred,
             this, &VpnManager::onProcessError);
 
+    m_phaseClock.start();
+    if (m_bond) {
+        // One privileged script brings up every member and the policy
+        // routing; for a bond the argument is that script itself.
+        startPrivileged(m_connectProcess, "/bin/sh", { "-c", configFile });
+        return;
+    }
 #ifdef Q_OS_WIN
     // Windows: install the WireGuard tunnel service (requires Administrator)
     QString wgExe = wireguardExePath();
-    m_connectProcess->start(wgExe, { "/installtunnelservice", configFile });
-#elif defined(Q_OS_LINUX)
-    // Linux: try pkexec for graphical privilege escalation, fall back to sudo
-    QString wgQuick = wgQuickPath();
-    if (QFileInfo::exists("/usr/bin/pkexec")) {
-        m_connectProcess->start("/usr/bin/pkexec", { wgQuick, "up", configFile });
-    } else {
-        m_connectProcess->start("sudo", { wgQuick, "up", configFile });
-    }
+    startProcess(m_connectProcess, wgExe, { "/installtunnelservice", configFile });
 #else
-    // macOS
-    QString wgQuick = wgQuickPath();
-    m_connectProcess->start("sudo", { wgQuick, "up", configFile });
+#  ifdef Q_OS_LINUX
+    if (startNativeTunnel())
+        return;
+#  endif
+    startPrivileged(m_connectProcess, wgQuickPath(), { "up", configFile });
 #endif
 }
 
@@ -196,7 +733,8 @@ void VpnManager::runDisconnectCommand()
     m_disconnectProcess->setProcessChannelMode(QProcess::MergedChannels);
 
     connect(m_disconnectProcess, &QProcess::readyReadStandardOutput, this, [this]() {
-        emit logMessage(QString::fromLocal8Bit(m_disconnectProcess->readAllStandardOutput()));
+        Logger::instance().logRaw(LogLevel::Info, "wg-quick", m_currentConfigName,
+                                  m_disconnectProcess->readAllStandardOutput());
     });
     connect(m_disconnectProcess,
             QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
@@ -204,33 +742,136 @@ void VpnManager::runDisconnectCommand()
     connect(m_disconnectProcess, &QProcess::errorOccurred,
             this, &VpnManager::onProcessError);
 
+    if (m_bond) {
+        startPrivileged(m_disconnectProcess, "/bin/sh", { "-c", m_bondDownScript });
+        return;
+    }
 #ifdef Q_OS_WIN
     QString wgExe = wireguardExePath();
-    m_disconnectProcess->start(wgExe, { "/uninstalltunnelservice", m_currentConfigName });
-#elif defined(Q_OS_LINUX)
-    QString wgQuick = wgQuickPath();
-    if (QFileInfo::exists("/usr/bin/pkexec")) {
-        m_disconnectProcess->start("/usr/bin/pkexec", { wgQuick, "down", m_currentConfigFile });
-    } else {
-        m_disconnectProcess->start("sudo", { wgQuick, "down", m_currentConfigFile });
-    }
+    startProcess(m_disconnectProcess, wgExe, { "/uninstalltunnelservice", m_currentConfigName });
 #else
-    QString wgQuick = wgQuickPath();
-    m_disconnectProcess->start("sudo", { wgQuick, "down", m_currentConfigFile });
+#  ifdef Q_OS_LINUX
+    if (m_native) {
+        stopNativeTunnel();
+        return;
+    }
+#  endif
+    startPrivileged(m_disconnectProcess, wgQuickPath(), { "down", m_currentConfigFile });
 #endif
 }
 
+bool VpnManager::startNativeTunnel()
+{
+    const QString reason = NativeTunnel::unsupportedReason(m_activeConfig);
+    if (!reason.isEmpty()) {
+        Logger::instance().log(LogLevel::Debug, "native", m_currentConfigName,
+                               QStringLiteral("using wg-quick"), { { "reason", reason } });
+        return false;
+    }
+
+    auto tunnel = std::make_unique<NativeTunnel>(m_currentConfigName);
+    QString error;
+    if (!tunnel->up(m_activeConfig, &error)) {
+        // up() has removed whatever it added; wg-quick gets a clean slate.
+        Logger::instance().log(LogLevel::Warning, "native", m_currentConfigName,
+                               tr("Native tunnel setup failed, falling back to wg-quick"),
+                               { { "error", error } });
+        return false;
+    }
+    m_native = std::move(tunnel);
+    Logger::instance().log(LogLevel::Info, "native", m_currentConfigName,
+                           tr("Tunnel configured over netlink"),
+                           { { "elapsed_ms", m_phaseClock.elapsed() } });
+
+    if (m_native->dnsRecord().isEmpty()) {
+        QMetaObject::invokeMethod(this, [this] {
+            if (m_native && m_status == VpnStatus::Connecting)
+                onConnectFinished(0, QProcess::NormalExit);
+        }, Qt::QueuedConnection);
+        return true;
+    }
+    // DNS is the one step left to a helper, exactly as wg-quick invokes it.
+    startProcess(m_connectProcess, "resolvconf",
+                 { "-a", m_native->resolvconfInterface(), "-m", "0", "-x" });
+    m_connectProcess->write(m_native->dnsRecord());
+    m_connectProcess->closeWriteChannel();
+    return true;
+}
+
+void VpnManager::stopNativeTunnel()
+{
+    QString error;
+    const bool removed = m_native->down(&error);
+    if (!removed)
+        Logger::instance().log(LogLevel::Warning, "native", m_currentConfigName, error);
+    const bool hadDns = !m_native->dnsRecord().isEmpty();
+    const QString dnsInterface = m_native->resolvconfInterface();
+    m_native.reset();
+
+    if (!hadDns) {
+        QMetaObject::invokeMethod(this, [this, removed] {
+            onDisconnectFinished(removed ? 0 : 1, QProcess::NormalExit);
+        }, Qt::QueuedConnection);
+        return;
+    }
+    startProcess(m_disconnectProcess, "resolvconf", { "-d", dnsInterface, "-f" });
+}
+
 // ── Slots ─────────────────────────────────────────────────────────────────────
 void VpnManager::onConnectFinished(int exitCode, QProcess::ExitStatus)
 {
+    Logger::instance().log(LogLevel::Debug, "vpnmanager", m_currentConfigName,
+                           QStringLiteral("tunnel command finished"),
+                           { { "exit_code", exitCode },
+                             { "elapsed_ms", m_phaseClock.elapsed() } });
     if (exitCode == 0) {
+        m_metrics.observeConnectPhase(VpnMetrics::PhaseTunnelUp,
+                                      m_phaseClock.nsecsElapsed() / 1e9);
+        if (m_tunnelMetrics
+            && m_tunnelMetrics->connects.fetch_add(1, std::memory_order_relaxed) > 0)
+            m_tunnelMetrics->reconnects.fetch_add(1, std::memory_order_relaxed);
+        m_connectEpoch      = QDateTime::currentSecsSinceEpoch();
+        m_awaitingHandshake = true;
+        m_phaseClock.start();
+
         setStatus(VpnStatus::Connected,
                   tr("Connected to %1").arg(m_currentServerName));
+        m_pollTimer->setInterval(2000);
         m_pollTimer->start();
+        m_netWatcher->setIgnoredInterfaces(m_bond ? m_bond->interfaces()
+                                                  : QStringList { m_currentConfigName });
+        if (!m_netWatcher->start())
+            Logger::instance().log(LogLevel::Debug, "vpnmanager", m_currentConfigName,
+                                   tr("Network change detection unavailable"));
+        startProbers();
+        if (!m_bond)
+            watchConfig(m_activeConfig);
+        if (m_shaper && m_native)
+            installShaper(); // with wg-quick the PostUp hook has done this
+        if (m_reloadRestarting) {
+            m_reloadRestarting = false;
+            const double seconds = m_reloadClock.nsecsElapsed() / 1e9;
+            m_metrics.observeConfigApply(VpnMetrics::ApplyRestart, seconds);
+            Logger::instance().log(LogLevel::Info, "reload", m_currentConfigName,
+                                   tr("Config applied by reconnecting"),
+                                   { { "elapsed_ms", m_reloadClock.elapsed() } });
+        }
+        pollStats(); // catch the first handshake as early as possible
     } else {
+        if (m_tunnelMetrics)
+            m_tunnelMetrics->connectFailures.fetch_add(1, std::memory_order_relaxed);
         QString out;
         if (m_connectProcess)
             out = QString::fromLocal8Bit(m_connectProcess->readAllStandardOutput());
+        if (m_native) {
+            // resolvconf failed: take the half-configured tunnel down again.
+            QString error;
+            m_native->down(&error);
+            m_native.reset();
+        }
+        m_bond.reset();
+        m_reloadRestarting = false;
+        removeRuntimeFiles();
         setStatus(VpnStatus::Error,
                   tr("Failed to connect (exit code %1).\n%2").arg(exitCode).arg(out));
     }
@@ -242,8 +883,17 @@ void VpnManager::onDisconnectFinished(int exitCode, QProcess::ExitStatus)
         m_currentServerName.clear();
         m_currentConfigName.clear();
         m_currentConfigFile.clear();
+        m_bond.reset();
+        m_shaper.reset(); // the qdisc went with the interface
+        removeRuntimeFiles(); // no private keys left behind
         setStatus(VpnStatus::Disconnected, tr("Disconnected"));
+        if (m_reconnectAfterDown) {
+            m_reconnectAfterDown = false;
+            m_reloadRestarting   = true;
+            connectToServer(m_currentServer);
+        }
     } else {
+        m_reconnectAfterDown = false;
         // Even on error, treat as disconnected to allow retry
         setStatus(VpnStatus::Error,
                   tr("Disconnect may have failed (exit code %1). "
@@ -286,6 +936,7 @@ void VpnManager::pollStats()
     connect(m_statsProcess,
             QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
             this, [this](int exitCode, QProcess::ExitStatus) {
+                m_metrics.observePollDuration(m_pollClock.nsecsElapsed() / 1e9);
                 if (exitCode == 0) {
                     QString out = QString::fromLocal8Bit(m_statsProcess->readAllStandardOutput());
                     parseWgShowOutput(out);
@@ -293,22 +944,109 @@ void VpnManager::pollStats()
                 m_statsProcess->disconnect();
             });
 
+    m_pollClock.start();
+    m_pollStartedMs = QDateTime::currentMSecsSinceEpoch();
 #ifdef Q_OS_WIN
-    m_statsProcess->start(wireguardExePath(), { "/show", m_currentConfigName });
+    startProcess(m_statsProcess, wireguardExePath(), { "/show", m_currentConfigName });
 #else
-    // wg show <tunnel>
-    QString wgBin;
-    for (const char *p : { "/usr/bin/wg", "/usr/local/bin/wg", "/opt/homebrew/bin/wg" }) {
-        if (QFileInfo::exists(QString::fromUtf8(p))) { wgBin = QString::fromUtf8(p); break; }
-    }
-    if (wgBin.isEmpty()) wgBin = "wg";
-    m_statsProcess->start(wgBin, { "show", m_currentConfigName });
+    // wg show <tunnel> dump — exact byte counters and handshake timestamps
+    if (m_bond)
+        startProcess(m_statsProcess, wgPath(), { "show", "all", "dump" });
+    else
+        startProcess(m_statsProcess, wgPath(), { "show", m_currentConfigName, "dump" });
+    if (m_shaper)
+        pollQueueStats();
 #endif
 }
 
 void VpnManager::parseWgShowOutput(const QString &output)
 {
     quint64 rx = 0, tx = 0;
+    qint64  handshake = 0;
+
+    // `wg show <tunnel> dump`: one tab-separated interface line, then one line
+    // per peer: public-key preshared-key endpoint allowed-ips latest-handshake
+    // transfer-rx transfer-tx persistent-keepalive. `wg show all dump`
+    // prefixes every line with the interface name.
+    struct Totals { quint64 rx = 0, tx = 0; qint64 handshake = 0; };
+    QHash<QString, Totals> perTunnel;
+    const QStringList lines = output.split('\n', Qt::SkipEmptyParts);
+    bool isDump = false;
+    for (const QString &line : lines) {
+        QStringList f = line.split('\t');
+        QString tunnel = m_currentConfigName;
+        if (f.size() == 9 || f.size() == 5)
+            tunnel = f.takeFirst();
+        if (f.size() != 8)
+            continue; // interface line
+        isDump = true;
+        Totals &t = perTunnel[tunnel];
+        t.handshake = qMax(t.handshake, f[4].toLongLong());
+        t.rx += f[5].toULongLong();
+        t.tx += f[6].toULongLong();
+    }
+    if (isDump) {
+        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+        bool healthChanged = false;
+        for (auto it = perTunnel.cbegin(); it != perTunnel.cend(); ++it) {
+            if (m_bond && !m_bond->interfaces().contains(it.key()))
+                continue; // some other WireGuard interface on this machine
+            rx += it->rx;
+            tx += it->tx;
+            handshake = qMax(handshake, it->handshake);
+            if (!m_bond)
+                continue;
+
+            TunnelMetrics *member = m_metrics.tunnel(it.key());
+            member->rxBytes.store(it->rx, std::memory_order_relaxed);
+            member->txBytes.store(it->tx, std::memory_order_relaxed);
+            member->latestHandshake.store(it->handshake, std::memory_order_relaxed);
+            if (m_bond->updateSample(it.key(), it->rx, it->tx, it->handshake, nowMs)) {
+                healthChanged = true;
+                const bool healthy = m_bond->members()[m_bond->interfaces().indexOf(it.key())].healthy;
+                Logger::instance().log(healthy ? LogLevel::Info : LogLevel::Warning, "bonding",
+                                       it.key(), healthy ? tr("Bond member recovered")
+                                                         : tr("Bond member degraded, removing it"));
+            }
+        }
+        if (m_bond)
+            rebalanceBond(healthChanged);
+
+        if (m_tunnelMetrics) {
+            m_tunnelMetrics->rxBytes.store(rx, std::memory_order_relaxed);
+            m_tunnelMetrics->txBytes.store(tx, std::memory_order_relaxed);
+            m_tunnelMetrics->latestHandshake.store(handshake, std::memory_order_relaxed);
+        }
+        if (m_shaper && !m_bond && m_shaper->updateSample(tx, nowMs))
+            applyShapeRate();
+        // Both sides are whole seconds, and the handshake often completes
+        // while the tunnel command is still running, in the second before
+        // m_connectEpoch is taken.
+        if (m_awaitingHandshake && handshake > 0 && handshake + 1 >= m_connectEpoch) {
+            m_awaitingHandshake = false;
+            m_metrics.observeConnectPhase(VpnMetrics::PhaseFirstHandshake,
+                                          m_phaseClock.nsecsElapsed() / 1e9);
+            m_metrics.observeConnectPhase(VpnMetrics::PhaseTotal,
+                                          m_connectClock.nsecsElapsed() / 1e9);
+        }
+        // Bytes counted by a poll that started before the event may have
+        // arrived before it; the baseline comes from the first poll after.
+        if (m_roaming && !m_roamHasBaseline && m_pollStartedMs >= m_roamEventMs) {
+            m_roamHasBaseline = true;
+            m_roamRxBytes     = rx;
+        }
+        // Recovered once the peer talks to us again over the new path.
+        if (m_roaming && ((m_roamHasBaseline && rx > m_roamRxBytes)
+                          || handshake * 1000 > m_roamStartMs))
+            finishRoaming(true);
+        else if (m_roaming && QDateTime::currentMSecsSinceEpoch() - m_roamStartMs > 30000)
+            finishRoaming(false);
+        emit statsUpdated({ m_currentConfigName, rx, tx, handshake,
+                            QDateTime::currentMSecsSinceEpoch() });
+        return;
+    }
+
+    // Human-readable `wg show` / `wireguard.exe /show` output
     static const QRegularExpression rxRe(R"(transfer:\s*([\d\.]+)\s*(\w+)\s+received,\s*([\d\.]+)\s*(\w+)\s+sent)");
     QRegularExpressionMatch m = rxRe.match(output);
     if (m.hasMatch()) {
@@ -323,14 +1061,533 @@ void VpnManager::parseWgShowOutput(const QString &output)
         rx = toBytes(m.captured(1), m.captured(2));
         tx = toBytes(m.captured(3), m.captured(4));
     }
-    emit statsUpdated(rx, tx);
+    emit statsUpdated({ m_currentConfigName, rx, tx, 0, QDateTime::currentMSecsSinceEpoch() });
+}
+
+void VpnManager::onNetworkChanged(const QString &reason, qint64 firstEventMs)
+{
+    if (m_status != VpnStatus::Connected)
+        return;
+
+    m_metrics.countNetworkChange();
+    Logger::instance().log(LogLevel::Info, "roaming", m_currentConfigName,
+                           tr("Network changed, refreshing tunnel"),
+                           { { "reason", reason } });
+
+    if (!m_roaming) {
+        m_roaming         = true;
+        m_roamStartMs     = firstEventMs;
+        m_roamEventMs     = QDateTime::currentMSecsSinceEpoch();
+        m_roamHasBaseline = false;
+    }
+
+#ifndef Q_OS_WIN
+    // Setting the endpoint again makes wg re-resolve host names. Turning
+    // persistent-keepalive off and back on in the same call makes the kernel
+    // send a keepalive right away, so the server learns our new address
+    // without waiting for the next timer or handshake retry. A network change
+    // is no reason to ask for a password: without the privileges at hand the
+    // probe burst below is the only nudge, and wg's own timers do the rest.
+    if (!runsWithoutPrompt(wgPath())) {
+        Logger::instance().log(LogLevel::Debug, "roaming", m_currentConfigName,
+                               tr("Not root and no CAP_NET_ADMIN; endpoints are not refreshed"));
+    } else {
+        for (const auto &tunnel : activeTunnels()) {
+            QStringList args = { "set", tunnel.first };
+            for (const TunnelConfig::Section *peer : tunnel.second.peers()) {
+                const QString key = peer->value("PublicKey");
+                if (key.isEmpty())
+                    continue;
+                const QString endpoint = peer->value("Endpoint");
+                if (!endpoint.isEmpty())
+                    args << "peer" << key << "endpoint" << endpoint;
+                const int keepalive = peer->value("PersistentKeepalive").toInt();
+                if (keepalive > 0)
+                    args << "peer" << key << "persistent-keepalive" << "off"
+                         << "peer" << key << "persistent-keepalive" << QString::number(keepalive);
+            }
+            if (args.size() <= 2)
+                continue;
+            const QString name = tunnel.first;
+            runPrivileged(wgPath(), args, [this, name](int exitCode, const QByteArray &output) {
+                if (exitCode != 0)
+                    Logger::instance().logRaw(LogLevel::Warning, "roaming", name, output);
+                pollStats();
+            });
+        }
+    }
+#endif
+
+    for (LatencyProber *prober : std::as_const(m_probers))
+        prober->burst();
+    m_pollTimer->setInterval(500);
+    pollStats();
+}
+
+void VpnManager::onQualityUpdated(const LatencyQuality &quality)
+{
+    if (!quality.responding) {
+        // Feeding this to the bond or the shaper would read a silent guess
+        // as a dead path; they carry on as if there were no prober.
+        auto *prober = qobject_cast<LatencyProber *>(sender());
+        Logger::instance().log(LogLevel::Warning, "probe", quality.tunnel,
+                               tr("No probe responder; latency and loss are not reported "
+                                  "until it answers (set ProbeTarget in [DKT])"),
+                               { { "target", prober ? prober->target().toString() : QString() } });
+        if (m_shaper && m_shaper->isAdaptive() && quality.tunnel == m_currentConfigName)
+            Logger::instance().log(LogLevel::Warning, "qos", quality.tunnel,
+                                   tr("ShapeRate = auto has no RTT to work with, "
+                                      "the tunnel stays unshaped"));
+        emit qualityUpdated(quality);
+        return;
+    }
+    if (m_bond) {
+        m_bond->setRtt(quality.tunnel, quality.srttMs);
+        m_bond->setLoss(quality.tunnel, quality.loss);
+    }
+    if (m_shaper && quality.tunnel == m_currentConfigName)
+        m_shaper->setRtt(quality.srttMs);
+    emit qualityUpdated(quality);
+}
+
+void VpnManager::finishRoaming(bool recovered)
+{
+    const double seconds = (QDateTime::currentMSecsSinceEpoch() - m_roamStartMs) / 1000.0;
+    m_roaming = false;
+    m_pollTimer->setInterval(2000);
+    if (recovered) {
+        m_metrics.observeRoamingRecovery(seconds);
+        Logger::instance().log(LogLevel::Info, "roaming", m_currentConfigName,
+                               tr("Tunnel recovered after network change"),
+                               { { "stall_ms", qint64(seconds * 1000) } });
+    } else {
+        Logger::instance().log(LogLevel::Warning, "roaming", m_currentConfigName,
+                               tr("No traffic from the peer since the network change"),
+                               { { "waited_ms", qint64(seconds * 1000) } });
+    }
+}
+
+// ── Config hot-reload ────────────────────────────────────────────────────────
+void VpnManager::watchConfig(const TunnelConfig &config)
+{
+    if (m_sourceConfigFile.isEmpty())
+        return;
+    if (!m_configWatcher) {
+        // Created lazily so its notifier belongs to the manager's thread.
+        m_configWatcher = new QFileSystemWatcher(this);
+        auto changed = [this]() {
+            // Editors that save by renaming drop the watch on the file itself.
+            if (QFileInfo::exists(m_sourceConfigFile)
+                && !m_configWatcher->files().contains(m_sourceConfigFile))
+                m_configWatcher->addPath(m_sourceConfigFile);
+            m_reloadTimer->start();
+        };
+        connect(m_configWatcher, &QFileSystemWatcher::fileChanged, this, changed);
+        connect(m_configWatcher, &QFileSystemWatcher::directoryChanged, this, changed);
+    }
+
+    unwatchConfig();
+    const QDir baseDir = QFileInfo(m_sourceConfigFile).absoluteDir();
+    QStringList paths = { m_sourceConfigFile, baseDir.absolutePath() };
+    for (const char *key : { "SplitIncludeFile", "SplitExcludeFile" }) {
+        for (const QString &file : config.optionList(key))
+            paths << baseDir.absoluteFilePath(file);
+    }
+    m_configWatcher->addPaths(paths);
+}
+
+void VpnManager::unwatchConfig()
+{
+    m_reloadTimer->stop();
+    if (!m_configWatcher)
+        return;
+    const QStringList watched = m_configWatcher->files() + m_configWatcher->directories();
+    if (!watched.isEmpty())
+        m_configWatcher->removePaths(watched);
+}
+
+void VpnManager::reloadConfig()
+{
+    if (m_status != VpnStatus::Connected || m_sourceConfigFile.isEmpty() || m_bond)
+        return;
+
+    m_reloadClock.start();
+    QString error;
+    const TunnelConfig next = loadEffectiveConfig(m_sourceConfigFile, &error);
+    if (next.isEmpty() || !next.interfaceSection()) {
+        // Often a half-written file; the next save triggers another reload.
+        Logger::instance().log(LogLevel::Warning, "reload", m_currentConfigName,
+                               tr("Ignoring unreadable config, keeping the tunnel as is"),
+                               { { "error", error } });
+        return;
+    }
+
+    const TunnelConfig::Diff diff = TunnelConfig::diff(m_activeConfig, next);
+    const bool probesChanged = next.option("ProbeTarget") != m_activeConfig.option("ProbeTarget")
+                            || next.option("ProbeBudget") != m_activeConfig.option("ProbeBudget");
+    if (diff.isEmpty()) {
+        // Only DKT options, comments or formatting changed.
+        if (queueOptionsChanged(m_activeConfig, next))
+            reconfigureShaper(next);
+        m_activeConfig = next;
+        watchConfig(next);
+        if (probesChanged)
+            startProbers();
+        return;
+    }
+
+    Logger::instance().log(LogLevel::Info, "reload", m_currentConfigName, tr("Config changed"),
+                           { { "peers_added",    int(diff.peersAdded.size()) },
+                             { "peers_removed",  int(diff.peersRemoved.size()) },
+                             { "peers_updated",  int(diff.peersUpdated.size()) },
+                             { "routes_added",   int(diff.routesAdded.size()) },
+                             { "routes_removed", int(diff.routesRemoved.size()) },
+                             { "interface_keys", diff.interfaceKeys.join(',') } });
+#ifdef Q_OS_LINUX
+    if (diff.isLive()) {
+        applyConfigLive(next, diff);
+        return;
+    }
+#endif
+    restartForReload();
+}
+
+void VpnManager::applyConfigLive(const TunnelConfig &next, const TunnelConfig::Diff &diff)
+{
+    const QString iface = m_currentConfigName;
+    const QString ip = shellQuote(ipPath());
+
+    // One privileged script, so the user sees at most one prompt. Nothing
+    // goes through a file: the runtime directory is writable by the user,
+    // and root would run whatever sits there by then. The config (with its
+    // private key) arrives on stdin, the route batch as a here-document.
+    QString script = "set -e\n";
+    script += shellQuote(wgPath()) + " syncconf " + shellQuote(iface) + " /dev/stdin\n";
+    if (!diff.routesAdded.isEmpty() || !diff.routesRemoved.isEmpty()) {
+        const QString table = next.interfaceSection()->value("Table");
+        const QString suffix = " dev " + iface
+            + (table.isEmpty() || table.compare("auto", Qt::CaseInsensitive) == 0
+                   ? QString() : " table " + table);
+        // wg-quick skips a prefix that a route on the interface already
+        // covers, so a removed prefix may have no route of its own. Only a
+        // route that is still there after `del` is a failure.
+        if (!diff.routesRemoved.isEmpty()) {
+            script += "route_del() { " + ip + " route del \"$@\" 2>/dev/null"
+                      " || [ -z \"$(" + ip + " route show exact \"$@\" 2>/dev/null)\" ]; }\n";
+            for (const QString &prefix : diff.routesRemoved)
+                script += "route_del " + prefix + suffix + '\n';
+        }
+        if (!diff.routesAdded.isEmpty()) {
+            script += ip + " -force -batch - <<'DKT_ROUTES'\n";
+            for (const QString &prefix : diff.routesAdded)
+                script += "route replace " + prefix + suffix + '\n';
+            script += "DKT_ROUTES\n";
+        }
+    }
+
+    runPrivileged("/bin/sh", { "-c", script }, [this, next](int exitCode, const QByteArray &output) {
+        if (m_status != VpnStatus::Connected)
+            return;
+        if (exitCode != 0) {
+            Logger::instance().logRaw(LogLevel::Warning, "reload", m_currentConfigName, output);
+            restartForReload();
+            return;
+        }
+        if (queueOptionsChanged(m_activeConfig, next))
+            reconfigureShaper(next);
+        m_activeConfig = next;
+        // wg-quick down reads the runtime copy; keep it in step.
+        if (m_currentConfigFile != m_sourceConfigFile) {
+            QString error;
+            writeRuntimeFile(QFileInfo(m_currentConfigFile).fileName(), next.toString(), &error);
+        }
+        m_metrics.observeConfigApply(VpnMetrics::ApplyLive, m_reloadClock.nsecsElapsed() / 1e9);
+        Logger::instance().log(LogLevel::Info, "reload", m_currentConfigName,
+                               tr("Config applied without reconnecting"),
+                               { { "elapsed_ms", m_reloadClock.elapsed() } });
+        watchConfig(next);
+        startProbers();
+    }, next.toWgString().toUtf8());
+}
+
+void VpnManager::restartForReload()
+{
+    Logger::instance().log(LogLevel::Info, "reload", m_currentConfigName,
+                           tr("Interface settings changed, reconnecting"));
+    m_reconnectAfterDown = true;
+    disconnect();
+}
+
+// ── Queue management ─────────────────────────────────────────────────────────
+bool VpnManager::setupShaper(const TunnelConfig &config, QString *error)
+{
+    // A new qdisc starts its counters at zero and may have other classes.
+    m_metrics.tunnel(m_currentConfigName)->resetQueue();
+    m_shaper = QueueShaper::fromConfig(m_currentConfigName, config, error);
+    if (!m_shaper)
+        return error->isEmpty();
+#ifdef Q_OS_LINUX
+    if (tcPath().isEmpty()) {
+        m_shaper.reset();
+        *error = tr("QueueDiscipline needs tc from iproute2, which is not installed.");
+        return false;
+    }
+    if (m_shaper->isAdaptive() && !runsWithoutPrompt(tcPath())) {
+        // Each rate change would be another pkexec prompt.
+        m_shaper->setAdaptive(false);
+        Logger::instance().log(LogLevel::Warning, "qos", m_currentConfigName,
+                               tr("ShapeRate = auto needs root or CAP_NET_ADMIN, "
+                                  "the tunnel stays unshaped"));
+    }
+#else
+    m_shaper.reset();
+    Logger::instance().log(LogLevel::Warning, "qos", m_currentConfigName,
+                           tr("QueueDiscipline is only supported on Linux, ignoring it"));
+#endif
+    return true;
+}
+
+void VpnManager::installShaper()
+{
+    if (!runsWithoutPrompt(tcPath())) {
+        // The netlink backend needs no prompt of its own; tc must not add one.
+        Logger::instance().log(LogLevel::Warning, "qos", m_currentConfigName,
+                               tr("Cannot run tc without a password prompt, "
+                                  "the queue discipline is not installed"));
+        m_shaper.reset();
+        return;
+    }
+    const QStringList args = m_shaper->installArguments();
+    runPrivileged(tcPath(), args, [this, args](int exitCode, const QByteArray &output) {
+        if (exitCode != 0) {
+            Logger::instance().logRaw(LogLevel::Warning, "qos", m_currentConfigName, output);
+            return;
+        }
+        Logger::instance().log(LogLevel::Debug, "qos", m_currentConfigName,
+                               tr("Queue discipline installed"), { { "tc", args.join(' ') } });
+    });
+}
+
+void VpnManager::reconfigureShaper(const TunnelConfig &config)
+{
+    if (!runsWithoutPrompt(tcPath())) {
+        // An edit to the config must not bring up a password prompt.
+        Logger::instance().log(LogLevel::Info, "qos", m_currentConfigName,
+                               tr("Queue settings changed; they apply at the next connect"));
+        return;
+    }
+    std::unique_ptr<QueueShaper> previous = std::move(m_shaper);
+    QString error;
+    if (!setupShaper(config, &error)) {
+        m_shaper = std::move(previous);
+        Logger::instance().log(LogLevel::Warning, "qos", m_currentConfigName,
+                               tr("Keeping the current queue discipline"), { { "error", error } });
+        return;
+    }
+    if (m_shaper)
+        installShaper(); // "replace" swaps the root qdisc in place
+    else if (previous)
+        runPrivileged(tcPath(), { "qdisc", "del", "dev", m_currentConfigName, "root" }, {});
+}
+
+void VpnManager::applyShapeRate()
+{
+    const quint64 rate = m_shaper->rate();
+    runPrivileged(tcPath(), m_shaper->rateArguments(),
+                  [this, rate](int exitCode, const QByteArray &output) {
+        if (exitCode != 0) {
+            Logger::instance().logRaw(LogLevel::Warning, "qos", m_currentConfigName, output);
+            return;
+        }
+        Logger::instance().log(LogLevel::Debug, "qos", m_currentConfigName,
+                               tr("Shaping rate adjusted"),
+                               { { "rate_kbit", qint64(rate * 8 / 1000) } });
+    });
+}
+
+void VpnManager::pollQueueStats()
+{
+    if (m_queueProcess && m_queueProcess->state() != QProcess::NotRunning)
+        return;
+
+    if (!m_queueProcess) {
+        m_queueProcess = new QProcess(this);
+        connect(m_queueProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                this, [this](int exitCode, QProcess::ExitStatus) {
+                    QueueStats stats;
+                    if (exitCode != 0 || !m_shaper
+                        || !QueueShaper::parseStats(m_currentConfigName,
+                                                    m_queueProcess->readAllStandardOutput(), &stats))
+                        return;
+                    if (m_tunnelMetrics) {
+                        quint32 mask = 0;
+                        for (const QueueClassStats &c : std::as_const(stats.classes)) {
+                            const int slot = queueClassSlot(c.name);
+                            if (slot < 0)
+                                continue;
+                            TunnelMetrics::QueueClass &q = m_tunnelMetrics->queue[slot];
+                            q.sentBytes.store(c.sentBytes, std::memory_order_relaxed);
+                            q.drops.store(c.drops, std::memory_order_relaxed);
+                            q.ecnMarks.store(c.ecnMarks, std::memory_order_relaxed);
+                            q.backlogBytes.store(c.backlogBytes, std::memory_order_relaxed);
+                            q.delayMicros.store(c.avgDelayUs, std::memory_order_relaxed);
+                            mask |= 1u << slot;
+                        }
+                        m_tunnelMetrics->queueRate.store(stats.shapeRate, std::memory_order_relaxed);
+                        m_tunnelMetrics->queueClassMask.store(mask, std::memory_order_relaxed);
+                    }
+                    emit queueStatsUpdated(stats);
+                });
+    }
+    // `tc -s` reads qdisc counters without privileges.
+    startProcess(m_queueProcess, tcPath(),
+                 { "-s", "-j", "qdisc", "show", "dev", m_currentConfigName });
 }
 
 // ── Internal helpers ──────────────────────────────────────────────────────────
+QList<QPair<QString, TunnelConfig>> VpnManager::activeTunnels() const
+{
+    QList<QPair<QString, TunnelConfig>> tunnels;
+    if (m_bond) {
+        for (const BondMember &m : m_bond->members())
+            tunnels.append({ m.tunnel, m.config });
+    } else {
+        tunnels.append({ m_currentConfigName, m_activeConfig });
+    }
+    return tunnels;
+}
+
+void VpnManager::startProbers()
+{
+    stopProbers();
+    bool shaperProbed = false;
+    for (const auto &tunnel : activeTunnels()) {
+        QHostAddress target;
+        quint16 port = 0;
+        if (!probeTarget(tunnel.second, &target, &port))
+            continue;
+
+        auto *prober = new LatencyProber(tunnel.first, m_metrics.tunnel(tunnel.first), this);
+        prober->setTarget(target, port);
+        bool ok = false;
+        const int budget = tunnel.second.option("ProbeBudget").toInt(&ok);
+        if (ok)
+            prober->setBudget(budget);
+        connect(prober, &LatencyProber::qualityUpdated, this, &VpnManager::onQualityUpdated);
+
+        QString error;
+        if (!prober->start(&error)) {
+            Logger::instance().log(LogLevel::Info, "probe", tunnel.first,
+                                   tr("Latency probing unavailable"),
+                                   { { "target", target.toString() }, { "error", error } });
+            delete prober;
+            continue;
+        }
+        Logger::instance().log(LogLevel::Debug, "probe", tunnel.first, tr("Probing tunnel"),
+                               { { "target", target.toString() },
+                                 { "mode", port ? QString("udp:%1").arg(port) : QString("icmp") } });
+        m_probers << prober;
+        shaperProbed |= tunnel.first == m_currentConfigName;
+    }
+    if (m_shaper && m_shaper->isAdaptive() && !shaperProbed)
+        Logger::instance().log(LogLevel::Warning, "qos", m_currentConfigName,
+                               tr("ShapeRate = auto needs a latency probe, "
+                                  "the tunnel stays unshaped"));
+}
+
+void VpnManager::stopProbers()
+{
+    qDeleteAll(m_probers);
+    m_probers.clear();
+}
+
+void VpnManager::runPrivileged(const QString &program, const QStringList &args,
+                               std::function<void(int, const QByteArray &)> done,
+                               const QByteArray &input)
+{
+    auto *process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [process, done](int exitCode, QProcess::ExitStatus) {
+                const QByteArray output = process->readAll();
+                process->deleteLater();
+                if (done)
+                    done(exitCode, output);
+            });
+    connect(process, &QProcess::errorOccurred,
+            this, [process, done](QProcess::ProcessError error) {
+                if (error != QProcess::FailedToStart)
+                    return; // finished() follows for the other errors
+                process->deleteLater();
+                if (done)
+                    done(-1, {});
+            });
+
+    startPrivileged(process, program, args);
+    if (!input.isEmpty()) {
+        process->write(input);
+        process->closeWriteChannel();
+    }
+}
+
+bool VpnManager::runsWithoutPrompt(const QString &program)
+{
+#if defined(Q_OS_WIN)
+    Q_UNUSED(program);
+    return true;
+#elif defined(Q_OS_LINUX)
+    if (::geteuid() == 0)
+        return true;
+    static const QStringList netAdminTools = { "wg", "tc", "nft", "ip" };
+    if (!netAdminTools.contains(QFileInfo(program).fileName()))
+        return false; // wg-quick insists on uid 0, scripts may need anything
+    // Capabilities are per thread and children inherit them from the thread
+    // that forks, which for every process this class starts is this one.
+    if (m_ambientNetAdmin < 0)
+        m_ambientNetAdmin = raiseAmbientNetAdmin() ? 1 : 0;
+    return m_ambientNetAdmin == 1;
+#else
+    return ::geteuid() == 0;
+#endif
+}
+
+void VpnManager::startPrivileged(QProcess *process, const QString &program,
+                                 const QStringList &args)
+{
+#ifdef Q_OS_WIN
+    startProcess(process, program, args); // the client runs as Administrator
+#else
+#  ifdef Q_OS_LINUX
+    if (runsWithoutPrompt(program)) {
+        startProcess(process, program, args);
+        return;
+    }
+    // Graphical prompt where polkit is available, sudo otherwise.
+    const QString pkexec = toolPath("pkexec", { "/usr/bin/pkexec" });
+    if (!pkexec.isEmpty()) {
+        startProcess(process, pkexec, QStringList { program } + args);
+        return;
+    }
+#  endif
+    const QString sudo = toolPath("sudo", {});
+    startProcess(process, sudo.isEmpty() ? QStringLiteral("sudo") : sudo,
+                 QStringList { program } + args);
+#endif
+}
+
+void VpnManager::startProcess(QProcess *process, const QString &program,
+                              const QStringList &args)
+{
+    m_metrics.countProcessSpawn();
+    process->start(program, args);
+}
+
 void VpnManager::setStatus(VpnStatus s, const QString &msg)
 {
     m_status = s;
     emit statusChanged(s, msg);
     if (!msg.isEmpty())
-        emit logMessage(msg);
+        Logger::instance().log(s == VpnStatus::Error ? LogLevel::Error : LogLevel::Info,
+                               "vpnmanager", m_currentConfigName, msg,
+                               { { "status", QString::fromLatin1(statusName(s)) } });
 }
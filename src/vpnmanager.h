@@ -1,11 +1,24 @@
 #pragma once
 
+#include <QMetaType>
 #include <QObject>
 #include <QProcess>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QString>
+#include <functional>
+#include <memory>
+#include "bonding.h"
+#include "latencyprober.h"
+#include "metrics.h"
+#include "nativetunnel.h"
+#include "queueshaper.h"
+#include "tunnelconfig.h"
 #include "vpnserver.h"
 
+class NetworkWatcher;
+class QFileSystemWatcher;
+
 /// Current state of the VPN connection.
 enum class VpnStatus {
     Disconnected,
@@ -14,14 +27,57 @@ enum class VpnStatus {
     Disconnecting,
     Error
 };
+Q_DECLARE_METATYPE(VpnStatus)
+
+/// Transfer counters of one `wg show` poll, delivered by value across threads.
+struct VpnStats {
+    QString tunnel;
+    quint64 rxBytes = 0;
+    quint64 txBytes = 0;
+    qint64  latestHandshake = 0;  ///< Unix seconds, 0 = never
+    qint64  sampledAtMs = 0;      ///< ms since the epoch
+};
+Q_DECLARE_METATYPE(VpnStats)
 
 /**
  * VpnManager manages WireGuard VPN connections on all three platforms:
  *   - Linux / macOS : wg-quick up/down  (with pkexec / sudo for privileges)
  *   - Windows       : wireguard.exe /installtunnelservice and /uninstalltunnelservice
  *
+ * On Linux, when the process itself holds CAP_NET_ADMIN, a single tunnel is
+ * brought up through NativeTunnel instead (netlink, no wg-quick); configs it
+ * cannot handle still go through wg-quick.
+ *
  * It also polls `wg show` every 2 s to refresh transfer statistics while
- * a tunnel is active.
+ * a tunnel is active, and records client performance counters in a
+ * VpnMetrics instance that MetricsServer can expose.
+ *
+ * While connected, a NetworkWatcher reports link/address/default-route
+ * changes; the manager then re-resolves the peer endpoints and nudges a
+ * keepalive through the tunnel (only when that needs no password prompt,
+ * see runsWithoutPrompt()) and polls quickly until traffic flows again.
+ *
+ * While connected, a LatencyProber per tunnel measures in-tunnel RTT,
+ * jitter and loss ([DKT] ProbeTarget / ProbeBudget); results are reported
+ * through qualityUpdated() and, once the target has answered, feed the
+ * bond weights and the shaper.
+ *
+ * Edits to the active .conf are picked up while connected. Peer and
+ * AllowedIPs changes are applied in place (`wg syncconf` plus a route
+ * delta, Linux); interface-level changes restart the tunnel.
+ *
+ * [DKT] QueueDiscipline puts fq_codel or cake on the tunnel (Linux, see
+ * QueueShaper); its per-class counters are polled with the transfer stats
+ * and reported through queueStatsUpdated().
+ *
+ * A VpnServer with bondMembers (Linux only) brings up every member tunnel
+ * and spreads flows across them; see BondPlanner.
+ *
+ * The manager is meant to live on its own thread (MainWindow moves it to
+ * one), so process spawning, file probes and output parsing never stall the
+ * UI. connectToServer(), disconnect() and shutdown() may be called from any
+ * thread; they are forwarded to the manager's thread. Results come back as
+ * queued signals carrying plain values.
  */
 class VpnManager : public QObject
 {
@@ -29,45 +85,151 @@ class VpnManager : public QObject
 
 public:
     explicit VpnManager(QObject *parent = nullptr);
-    ~VpnManager() override;
 
     void connectToServer(const VpnServer &server);
     void disconnect();
-
-    VpnStatus status() const { return m_status; }
-    QString   currentServerName() const { return m_currentServerName; }
+    /// Stops polling and kills running commands without waiting for them;
+    /// emits shutdownFinished() once they have exited.
+    void shutdown();
 
     /// Returns the directory where .conf files are read from.
     QString configDirectory() const;
 
+    /// Directory holding the generated configs handed to wg-quick when a
+    /// .conf uses DKT-only options.
+    static QString runtimeConfigDirectory();
+
+    /// Performance counters; lock-free, so safe to use from any thread.
+    const VpnMetrics &metrics() const { return m_metrics; }
+    VpnMetrics       &metrics()       { return m_metrics; }
+
+public slots:
+    /// Runs on the manager's thread once it has started; reports the bonds
+    /// found in bonding.conf.
+    void initialize();
+
 signals:
     void statusChanged(VpnStatus status, const QString &message);
-    void statsUpdated(quint64 bytesRx, quint64 bytesTx);
-    void logMessage(const QString &line);
+    void statsUpdated(const VpnStats &stats);
+    void qualityUpdated(const LatencyQuality &quality);
+    void queueStatsUpdated(const QueueStats &stats);
+    void bondsDiscovered(const QList<VpnServer> &bonds);
+    void shutdownFinished();
 
 private slots:
     void onConnectFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onDisconnectFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onProcessError(QProcess::ProcessError error);
     void pollStats();
+    void onNetworkChanged(const QString &reason, qint64 firstEventMs);
+    void onQualityUpdated(const LatencyQuality &quality);
+    void reloadConfig();
 
 private:
     // Helpers
+    bool   forwardToOwnThread(std::function<void()> call);
+    QList<VpnServer> bondedServers() const;
     void   setStatus(VpnStatus s, const QString &msg = {});
     QString resolveConfigFile(const QString &configName) const;
+    QString prepareRuntimeConfig(const QString &configFile, QString *error);
+    /// The source config with DKT options (split tunnelling) applied.
+    TunnelConfig loadEffectiveConfig(const QString &configFile, QString *error);
+    void    watchConfig(const TunnelConfig &config);
+    void    unwatchConfig();
+    void    applyConfigLive(const TunnelConfig &next, const TunnelConfig::Diff &diff);
+    void    restartForReload();
+    bool    applySplitTunnel(TunnelConfig &config, const QString &baseDir, QString *error);
+    /// Writes a 0600 file to runtimeConfigDirectory(); removeRuntimeFiles()
+    /// deletes everything written since the last call.
+    QString writeRuntimeFile(const QString &fileName, const QString &content, QString *error);
+    void    removeRuntimeFiles();
+    void    connectBonded(const VpnServer &server);
+    void    rebalanceBond(bool urgent);
     QString wgQuickPath() const;
     QString wireguardExePath() const;
+    QString wgPath() const;
+    QString tcPath() const;   ///< empty when iproute2's tc is not installed
+    QString ipPath() const;
     void   runConnectCommand(const QString &configFile);
     void   runDisconnectCommand();
+    /// Brings the tunnel up through NativeTunnel; false if wg-quick must do it.
+    bool   startNativeTunnel();
+    void   stopNativeTunnel();
     void   parseWgShowOutput(const QString &output);
+    void   startProcess(QProcess *process, const QString &program, const QStringList &args);
+    /// Starts @p program as root: directly when the client is root, else
+    /// through pkexec or sudo (Linux / macOS).
+    void   startPrivileged(QProcess *process, const QString &program, const QStringList &args);
+    /// True when startPrivileged() can run @p program without a password
+    /// prompt: the client is root, or (Linux) it holds CAP_NET_ADMIN and
+    /// @p program is wg, tc, nft or ip, which need nothing else. Background
+    /// work (roaming, rebalancing, shaping) only runs when this holds.
+    bool   runsWithoutPrompt(const QString &program);
+    /// Runs a one-off command with the same privilege escalation as wg-quick;
+    /// @p input is written to its stdin.
+    void   runPrivileged(const QString &program, const QStringList &args,
+                         std::function<void(int exitCode, const QByteArray &output)> done = {},
+                         const QByteArray &input = {});
+    void   finishRoaming(bool recovered);
+    /// Name and parsed config of every tunnel that is up (bond members or the single tunnel).
+    QList<QPair<QString, TunnelConfig>> activeTunnels() const;
+    void   startProbers();
+    void   stopProbers();
+    /// Creates m_shaper from the [DKT] queue options; false on a bad option.
+    bool   setupShaper(const TunnelConfig &config, QString *error);
+    void   installShaper();
+    void   reconfigureShaper(const TunnelConfig &config);
+    void   applyShapeRate();
+    void   pollQueueStats();
+    void   checkShutdown();
 
     QProcess *m_connectProcess    = nullptr;
     QProcess *m_disconnectProcess = nullptr;
     QProcess *m_statsProcess      = nullptr;
+    QProcess *m_queueProcess      = nullptr; ///< `tc -s qdisc show`, polled with the stats
     QTimer   *m_pollTimer         = nullptr;
+    NetworkWatcher *m_netWatcher  = nullptr;
+    QList<LatencyProber *> m_probers;
 
     VpnStatus m_status            = VpnStatus::Disconnected;
+    bool      m_shuttingDown      = false;
+    int       m_pendingExits      = 0;   ///< processes still exiting; -1 once shutdown is reported
     QString   m_currentServerName;
     QString   m_currentConfigName; ///< tunnel name used for disconnect
-    QString   m_currentConfigFile; ///< full path to config file
+    QString   m_currentConfigFile; ///< full path to the config handed to wg-quick
+    TunnelConfig m_activeConfig;   ///< parsed form of m_currentConfigFile
+    VpnServer    m_currentServer;
+    QString      m_sourceConfigFile; ///< the user's .conf behind m_currentConfigFile
+    QStringList  m_runtimeFiles;     ///< written by writeRuntimeFile() for this session
+
+    // Config hot-reload
+    QFileSystemWatcher *m_configWatcher = nullptr; ///< created on the manager's thread
+    QTimer        *m_reloadTimer = nullptr;        ///< debounces editor save bursts
+    QElapsedTimer  m_reloadClock;
+    bool           m_reconnectAfterDown = false;   ///< restart in progress: down done → up
+    bool           m_reloadRestarting   = false;   ///< restart in progress: up pending
+
+    std::unique_ptr<BondPlanner>  m_bond;   ///< set while a bond is active
+    std::unique_ptr<NativeTunnel> m_native; ///< set while the tunnel is up without wg-quick
+    std::unique_ptr<QueueShaper>  m_shaper; ///< set when the tunnel has a managed qdisc
+    QString   m_bondDownScript;           ///< text for `sh -c`
+    qint64    m_lastRebalanceMs = 0;
+    bool      m_bondRebalancing = false;  ///< nft can be run without a prompt
+    int       m_ambientNetAdmin = -1; ///< CAP_NET_ADMIN passed on to children; -1 not tried yet
+
+    VpnMetrics     m_metrics;
+    TunnelMetrics *m_tunnelMetrics = nullptr; ///< entry for the current tunnel
+    QElapsedTimer  m_connectClock;            ///< started when a connect is requested
+    QElapsedTimer  m_phaseClock;              ///< started at the current connect phase
+    QElapsedTimer  m_pollClock;
+    qint64         m_connectEpoch = 0;        ///< Unix seconds when the tunnel came up
+    bool           m_awaitingHandshake = false;
+
+    // Roaming recovery after a network change
+    bool           m_roaming = false;
+    qint64         m_roamStartMs = 0;  ///< first network event, ms since epoch
+    qint64         m_roamEventMs = 0;  ///< when onNetworkChanged() handled it
+    bool           m_roamHasBaseline = false;
+    quint64        m_roamRxBytes = 0;  ///< rx counter of the first poll started after the event
+    qint64         m_pollStartedMs = 0;
 };
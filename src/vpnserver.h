@@ -1,7 +1,9 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QList>
+#include <QMetaType>
 
 /// Represents a single VPN server location.
 struct VpnServer {
@@ -9,7 +11,9 @@ struct VpnServer {
     QString code;        ///< Two-letter country code, e.g. "us"
     QString flag;        ///< Unicode flag emoji
     QString configName;  ///< WireGuard config name without extension, e.g. "dkt-us"
+    QStringList bondMembers; ///< config names bonded together; empty for a single server
 };
+Q_DECLARE_METATYPE(VpnServer)
 
 /// Returns the built-in list of supported VPN server locations.
 inline QList<VpnServer> defaultServers()
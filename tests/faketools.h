@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+/// A config VpnManager accepts as-is: no [DKT] section, literal endpoint.
+inline const QByteArray kSampleConfig =
+    "[Interface]\n"
+    "PrivateKey = yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBmk=\n"
+    "Address = 10.8.0.2/24\n"
+    "\n"
+    "[Peer]\n"
+    "PublicKey = xTIBA5rboUvnH4htodjb6e697QjLERt1NAB4mZqp8Dg=\n"
+    "Endpoint = 192.0.2.1:51820\n"
+    "AllowedIPs = 10.8.0.0/24\n";
+
+/**
+ * A scratch directory with stand-ins for the tools VpnManager runs (wg,
+ * wg-quick, pkexec …) and a config directory. While it exists,
+ * DKT_VPN_TOOL_DIR and DKT_VPN_CONFIG_DIR point into it and the manager
+ * stays on the wg-quick backend, so a test never touches the real network.
+ *
+ * By default privilege escalation passes straight through and wg-quick
+ * succeeds without doing anything; tests replace tools with addTool().
+ */
+class FakeTools
+{
+public:
+    FakeTools()
+    {
+        QStandardPaths::setTestModeEnabled(true); // runtime copies stay out of ~/.local
+        QDir(m_dir.path()).mkpath("configs");
+        qputenv("DKT_VPN_TOOL_DIR", QFile::encodeName(m_dir.path()));
+        qputenv("DKT_VPN_CONFIG_DIR", QFile::encodeName(configDirectory()));
+        qputenv("DKT_VPN_BACKEND", "wg-quick");
+        addTool("pkexec", "exec \"$@\"");
+        addTool("sudo", "exec \"$@\"");
+        addTool("wg-quick", "exit 0");
+    }
+
+    ~FakeTools()
+    {
+        qunsetenv("DKT_VPN_TOOL_DIR");
+        qunsetenv("DKT_VPN_CONFIG_DIR");
+        qunsetenv("DKT_VPN_BACKEND");
+    }
+
+    bool    isValid() const { return m_dir.isValid(); }
+    QString path() const { return m_dir.path(); }
+    QString configDirectory() const { return m_dir.path() + "/configs"; }
+
+    /// Installs, or replaces, an executable /bin/sh script called @p name.
+    bool addTool(const char *name, const QByteArray &body)
+    {
+        QFile script(m_dir.path() + '/' + QString::fromUtf8(name));
+        if (!script.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        script.write("#!/bin/sh\n" + body + '\n');
+        script.close();
+        return script.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner
+                                     | QFileDevice::ExeOwner);
+    }
+
+    /// Writes <configDirectory()>/<name>.conf.
+    bool addConfig(const QString &name, const QByteArray &content)
+    {
+        QFile config(configDirectory() + '/' + name + ".conf");
+        if (!config.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        return config.write(content) == content.size();
+    }
+
+private:
+    QTemporaryDir m_dir;
+};
@@ -0,0 +1,114 @@
+#!/bin/sh
+# Runs one tst_netns scenario against real WireGuard tunnels between two
+# throwaway network namespaces:
+#
+#   run.sh <tst_netns> <scenario> [wg-quick|native]
+#
+#   client ns                                server ns
+#   c0 192.0.2.2/24     ───────────────────  s0 192.0.2.1/24
+#   c1 198.51.100.2/24  ───────────────────  s1 198.51.100.1/24
+#                                            ep 203.0.113.1, 203.0.113.2 (dummy)
+#                                               198.18.0.1 (traffic sink)
+#                                            wg0 10.8.0.1/24 :51820
+#                                            wg1 10.9.0.1/24 :51821
+#
+# The client reaches 203.0.113.1 over c0 and 203.0.113.2 over c1, and
+# everything else through its default route over c0. Configs
+# dkt-a (wg0, endpoint .1) and dkt-b (wg1, endpoint .2) are written to a
+# scratch DKT_VPN_CONFIG_DIR; the scenario runs inside the client namespace
+# with DKT_VPN_NETNS_SERVER naming the server one. Everything is removed on
+# exit. Without root, WireGuard or iproute2 the test is skipped (77).
+set -eu
+
+driver=$1
+scenario=$2
+backend=${3:-wg-quick}
+skip=77
+
+[ "$(id -u)" -eq 0 ] || { echo "skipped: needs root"; exit $skip; }
+needs="ip wg wg-quick ping"
+case $scenario in
+    bonding) needs="$needs nft" ;;
+    bondingThroughput) needs="$needs nft tc" ;;
+    bufferbloat) needs="$needs tc" ;;
+esac
+for tool in $needs; do
+    command -v "$tool" >/dev/null 2>&1 || { echo "skipped: needs $tool"; exit $skip; }
+done
+
+client=dkt-c$$
+server=dkt-s$$
+work=$(mktemp -d)
+cleanup() {
+    ip netns pids "$client" 2>/dev/null | xargs -r kill 2>/dev/null || true
+    ip netns pids "$server" 2>/dev/null | xargs -r kill 2>/dev/null || true
+    ip netns del "$client" 2>/dev/null || true
+    ip netns del "$server" 2>/dev/null || true
+    rm -rf "$work"
+}
+trap cleanup EXIT INT TERM
+
+ip netns add "$client"
+ip netns add "$server"
+C="ip -n $client"
+S="ip -n $server"
+
+if ! $S link add probe type wireguard 2>/dev/null; then
+    echo "skipped: no WireGuard kernel module"
+    exit $skip
+fi
+$S link del probe
+
+$C link set lo up
+$S link set lo up
+# The latency prober uses unprivileged ping sockets, root included.
+ip netns exec "$client" sysctl -qw net.ipv4.ping_group_range="0 2147483647"
+for i in 0 1; do
+    ip link add c$i netns "$client" type veth peer name s$i netns "$server"
+done
+$C addr add 192.0.2.2/24 dev c0
+$C addr add 198.51.100.2/24 dev c1
+$S addr add 192.0.2.1/24 dev s0
+$S addr add 198.51.100.1/24 dev s1
+$S link add ep type dummy
+$S addr add 203.0.113.1/32 dev ep
+$S addr add 203.0.113.2/32 dev ep
+$S addr add 198.18.0.1/32 dev ep
+for dev in c0 c1; do $C link set "$dev" up; done
+for dev in s0 s1 ep; do $S link set "$dev" up; done
+$C route add 203.0.113.1/32 via 192.0.2.1 dev c0
+$C route add 203.0.113.2/32 via 198.51.100.1 dev c1
+$C route add default via 192.0.2.1 dev c0
+
+mkdir -p "$work/configs"
+umask 077
+tunnel() { # <client name> <server dev> <subnet> <port> <endpoint>
+    ckey=$(wg genkey)
+    skey=$(wg genkey)
+    $S link add "$2" type wireguard
+    printf '%s\n' "$skey" > "$work/$2.key"
+    ip netns exec "$server" wg set "$2" listen-port "$4" private-key "$work/$2.key" \
+        peer "$(printf '%s' "$ckey" | wg pubkey)" allowed-ips "$3.2/32"
+    $S addr add "$3.1/24" dev "$2"
+    $S link set "$2" up
+    cat > "$work/configs/$1.conf" <<EOF
+[Interface]
+PrivateKey = $ckey
+Address = $3.2/24
+
+[Peer]
+PublicKey = $(printf '%s' "$skey" | wg pubkey)
+Endpoint = $5:$4
+AllowedIPs = $3.0/24
+PersistentKeepalive = 5
+EOF
+}
+tunnel dkt-a wg0 10.8.0 51820 203.0.113.1
+tunnel dkt-b wg1 10.9.0 51821 203.0.113.2
+
+ip netns exec "$client" env \
+    DKT_VPN_NETNS=1 \
+    DKT_VPN_NETNS_SERVER="$server" \
+    DKT_VPN_CONFIG_DIR="$work/configs" \
+    DKT_VPN_BACKEND="$backend" \
+    "$driver" "$scenario"
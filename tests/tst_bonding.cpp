@@ -0,0 +1,172 @@
+#include <QMap>
+#include <QRegularExpression>
+#include <QtTest>
+#include <algorithm>
+
+#include "bonding.h"
+
+namespace {
+
+BondPlanner planner(int members)
+{
+    QList<BondMember> list;
+    for (int i = 0; i < members; ++i) {
+        BondMember m;
+        m.tunnel = QString("dkt-%1").arg(QChar('a' + i));
+        list << m;
+    }
+    return BondPlanner("Test", list);
+}
+
+QVector<double> shares(const BondPlanner &bond)
+{
+    QVector<double> out(bond.members().size(), 0.0);
+    for (int member : bond.buckets()) {
+        if (member >= 0)
+            out[member] += 1.0 / BondPlanner::kBuckets;
+    }
+    return out;
+}
+
+} // namespace
+
+class TestBonding : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void weightsFollowCapacityNotAssignedLoad_data();
+    void weightsFollowCapacityNotAssignedLoad();
+    void memberRegainsShareAfterOutage();
+    void missingHandshakeFailsAfterGrace();
+    void upScriptIsSelfContained();
+    void rulesRankAheadOfMain();
+};
+
+void TestBonding::weightsFollowCapacityNotAssignedLoad_data()
+{
+    QTest::addColumn<double>("capacityA");
+    QTest::addColumn<double>("capacityB");
+    QTest::addColumn<double>("demand");
+
+    // bytes/s per member; demand is spread evenly over the buckets.
+    QTest::newRow("equal, saturated")   << 5e6 << 5e6 << 20e6;
+    QTest::newRow("2:1, saturated")     << 10e6 << 5e6 << 30e6;
+    QTest::newRow("2:1, one saturated") << 10e6 << 5e6 << 12e6;
+    QTest::newRow("idle")               << 10e6 << 5e6 << 1e6;
+}
+
+void TestBonding::weightsFollowCapacityNotAssignedLoad()
+{
+    // Each member carries min(its share of the demand, its capacity). With
+    // weights following raw throughput, whichever member starts with fewer
+    // buckets shows less traffic, loses more buckets and ends with none.
+    QFETCH(double, capacityA);
+    QFETCH(double, capacityB);
+    QFETCH(double, demand);
+    const double capacity[2] = { capacityA, capacityB };
+
+    BondPlanner bond = planner(2);
+    quint64 rx[2] = {};
+    qint64 nowMs = 1'000'000'000;
+    for (int poll = 0; poll < 300; ++poll) {
+        const QVector<double> share = shares(bond);
+        nowMs += 2000;
+        for (int i = 0; i < 2; ++i) {
+            rx[i] += quint64(std::min(share[i] * demand, capacity[i]) * 2);
+            bond.updateSample(bond.members()[i].tunnel, rx[i], rx[i] / 20, nowMs / 1000, nowMs);
+        }
+        bond.rebalance();
+    }
+
+    const QVector<double> share = shares(bond);
+    qInfo("shares after 300 polls: %.2f / %.2f", share[0], share[1]);
+    QVERIFY(share[0] > 0.25 && share[1] > 0.25);
+    if (capacityA > capacityB && demand > capacityA + capacityB)
+        QVERIFY(share[0] > share[1]);
+}
+
+void TestBonding::memberRegainsShareAfterOutage()
+{
+    // dkt-b is out for 100 polls, then healthy again. Its throughput starts
+    // from the few buckets the floor weight gives it; estimated against that
+    // share it gets back to an even split instead of staying starved.
+    BondPlanner bond = planner(2);
+    constexpr double kDemand = 4e6; // well below either member's capacity
+    quint64 rx[2] = {};
+    qint64 nowMs = 1'000'000'000;
+    for (int poll = 0; poll < 250; ++poll) {
+        bond.setLoss("dkt-b", poll >= 50 && poll < 150 ? 0.9 : 0.0);
+        const QVector<double> share = shares(bond);
+        nowMs += 2000;
+        for (int i = 0; i < 2; ++i) {
+            rx[i] += quint64(share[i] * kDemand * 2);
+            bond.updateSample(bond.members()[i].tunnel, rx[i], rx[i] / 20, nowMs / 1000, nowMs);
+        }
+        bond.rebalance();
+    }
+    const QVector<double> share = shares(bond);
+    qInfo("shares after the outage: %.2f / %.2f", share[0], share[1]);
+    QVERIFY(share[1] > 0.35);
+}
+
+void TestBonding::missingHandshakeFailsAfterGrace()
+{
+    BondPlanner bond = planner(2);
+    const qint64 start = 1'000'000'000;
+    const auto sample = [&](qint64 ms) {
+        bond.updateSample("dkt-a", 0, 0, 0, ms);
+        bond.updateSample("dkt-b", 100, 100, ms / 1000, ms);
+    };
+
+    sample(start);
+    sample(start + (BondPlanner::kHandshakeGraceSecs - 1) * 1000);
+    QVERIFY(bond.members()[0].healthy);
+    // Returns true because the member's health flipped.
+    QVERIFY(bond.updateSample("dkt-a", 0, 0, 0, start + BondPlanner::kHandshakeGraceSecs * 1000));
+    QVERIFY(!bond.members()[0].healthy);
+    QVERIFY(bond.members()[1].healthy);
+
+    bond.rebalance();
+    QCOMPARE(shares(bond)[1], 1.0);
+}
+
+void TestBonding::upScriptIsSelfContained()
+{
+    // Run as root through `sh -c`: nothing may be read back from a file the
+    // user could have swapped.
+    BondPlanner bond = planner(2);
+    const QString up = bond.upScript("/usr/bin/wg-quick");
+    QVERIFY(up.contains("nft -f /dev/stdin <<'DKT_NFT'\n# DKT VPN bond"));
+    QVERIFY(up.contains("bond_down() (\nset +e\n"));
+    QVERIFY(!up.contains(".sh"));
+    QVERIFY(!up.contains(".nft"));
+}
+
+void TestBonding::rulesRankAheadOfMain()
+{
+    // Behind "32766: from all lookup main" a host's default route would
+    // take every marked packet. The suppress rule has to come first, or
+    // the members' defaults would also take LAN traffic.
+    BondPlanner bond = planner(2);
+    const QString up = bond.upScript("/usr/bin/wg-quick");
+    static const QRegularExpression rule("ip -4 rule add (.*) priority (\\d+)\n");
+    QMap<int, QString> rules;
+    for (auto it = rule.globalMatch(up); it.hasNext();) {
+        const QRegularExpressionMatch m = it.next();
+        rules.insert(m.captured(2).toInt(), m.captured(1));
+    }
+    QCOMPARE(rules.size(), 3);
+    QVERIFY(rules.lastKey() < 32766);
+    QCOMPARE(rules.first(), QString("table main suppress_prefixlength 0"));
+    QCOMPARE(rules.values().mid(1), QStringList({ "fwmark 52001 table 52001",
+                                                  "fwmark 52002 table 52002" }));
+
+    // Removed with the same selectors, so nobody else's rules go with them.
+    const QString down = bond.downScript("/usr/bin/wg-quick");
+    for (auto it = rules.cbegin(); it != rules.cend(); ++it)
+        QVERIFY(down.contains(QString("ip -4 rule del %1 priority %2").arg(it.value()).arg(it.key())));
+}
+
+QTEST_GUILESS_MAIN(TestBonding)
+#include "tst_bonding.moc"
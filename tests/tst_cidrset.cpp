@@ -0,0 +1,309 @@
+#include <QFile>
+#include <QRandomGenerator>
+#include <QtTest>
+#include <algorithm>
+
+#include "cidrset.h"
+
+namespace {
+
+using Address = std::array<quint8, 16>;
+
+struct Rule {
+    CidrPrefix prefix;
+    bool       include;
+};
+
+int bitAt(const Address &addr, int i)
+{
+    return (addr[size_t(i / 8)] >> (7 - i % 8)) & 1;
+}
+
+bool contains(const CidrPrefix &prefix, bool v6, const Address &addr)
+{
+    if (prefix.v6 != v6)
+        return false;
+    for (int i = 0; i < prefix.length; ++i) {
+        if (bitAt(prefix.addr, i) != bitAt(addr, i))
+            return false;
+    }
+    return true;
+}
+
+/// The rule CidrSet documents: the longest matching rule decides, an
+/// exclude beats an include of the same prefix, no rule means excluded.
+bool modelSelects(const QList<Rule> &rules, bool v6, const Address &addr)
+{
+    int  best     = -1;
+    bool selected = false;
+    for (const Rule &r : rules) {
+        if (!contains(r.prefix, v6, addr))
+            continue;
+        if (r.prefix.length > best) {
+            best     = r.prefix.length;
+            selected = r.include;
+        } else if (r.prefix.length == best && !r.include) {
+            selected = false;
+        }
+    }
+    return selected;
+}
+
+bool covered(const QList<CidrPrefix> &out, bool v6, const Address &addr)
+{
+    return std::any_of(out.begin(), out.end(),
+                       [&](const CidrPrefix &p) { return contains(p, v6, addr); });
+}
+
+Address lastAddress(const CidrPrefix &p)
+{
+    Address a = p.addr;
+    for (int i = p.length; i < p.maxLength(); ++i)
+        a[size_t(i / 8)] |= quint8(0x80 >> (i % 8));
+    return a;
+}
+
+/// The property every aggregate() result has to satisfy regardless of the
+/// rules: per family sorted, pairwise disjoint and with no two siblings
+/// left unmerged (which makes the decomposition the minimal one).
+QString checkCanonical(const QList<CidrPrefix> &out)
+{
+    for (qsizetype i = 1; i < out.size(); ++i) {
+        const CidrPrefix &a = out[i - 1];
+        const CidrPrefix &b = out[i];
+        if (a.v6 && !b.v6)
+            return "IPv6 before IPv4 at " + b.toString();
+        if (a.v6 != b.v6)
+            continue;
+        if (!(lastAddress(a) < b.addr))
+            return a.toString() + " overlaps or follows " + b.toString();
+        if (a.length == b.length && a.length > 0) {
+            CidrPrefix parent = a;
+            parent.length = a.length - 1;
+            if (contains(parent, b.v6, b.addr))
+                return a.toString() + " and " + b.toString() + " should be merged";
+        }
+    }
+    return {};
+}
+
+Address v4Address(quint32 value)
+{
+    Address a {};
+    a[0] = quint8(value >> 24);
+    a[1] = quint8(value >> 16);
+    a[2] = quint8(value >> 8);
+    a[3] = quint8(value);
+    return a;
+}
+
+/// 2001:db8::<value>, the low 32 bits set from @p value.
+Address v6Address(quint32 value)
+{
+    Address a {};
+    a[0] = 0x20; a[1] = 0x01; a[2] = 0x0d; a[3] = 0xb8;
+    a[12] = quint8(value >> 24);
+    a[13] = quint8(value >> 16);
+    a[14] = quint8(value >> 8);
+    a[15] = quint8(value);
+    return a;
+}
+
+CidrPrefix prefixOf(bool v6, const Address &addr, int length)
+{
+    CidrPrefix p;
+    p.v6     = v6;
+    p.addr   = addr;
+    p.length = length;
+    for (int i = length; i < p.maxLength(); ++i)
+        p.addr[size_t(i / 8)] &= quint8(~(0x80 >> (i % 8)));
+    return p;
+}
+
+QStringList strings(const QList<CidrPrefix> &prefixes)
+{
+    QStringList out;
+    for (const CidrPrefix &p : prefixes)
+        out << p.toString();
+    return out;
+}
+
+// Rules are drawn inside a 4096-address window, 10.0.0.0/20 or
+// 2001:db8::/116, so every address in it can be checked exhaustively;
+// a few rules cover the window from outside.
+constexpr int     kWindowBits = 12;
+constexpr quint32 kV4Window   = 0x0a000000;
+
+} // namespace
+
+class TestCidrSet : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseClearsHostBits();
+    void returnsInvalidEntries();
+    void splitsDefaultRouteAroundExclusion();
+    void excludeWinsTies();
+    void matchesReferenceModel_data();
+    void matchesReferenceModel();
+    void benchmarkBypassList();
+};
+
+void TestCidrSet::parseClearsHostBits()
+{
+    CidrPrefix p;
+    QVERIFY(CidrPrefix::parse("10.1.2.3/8", &p));
+    QCOMPARE(p.toString(), QStringLiteral("10.0.0.0/8"));
+    QVERIFY(CidrPrefix::parse(" fe80::1:2/10 ", &p));
+    QCOMPARE(p.toString(), QStringLiteral("fe80::/10"));
+    QVERIFY(CidrPrefix::parse("192.0.2.7", &p));
+    QCOMPARE(p.toString(), QStringLiteral("192.0.2.7/32"));
+
+    bool ok = true;
+    CidrPrefix::host("192.0.2.0/24", &ok);
+    QVERIFY(!ok);
+    QCOMPARE(CidrPrefix::host("2001:db8::1", &ok).toString(), QStringLiteral("2001:db8::1/128"));
+    QVERIFY(ok);
+}
+
+void TestCidrSet::returnsInvalidEntries()
+{
+    CidrSet set;
+    const QStringList invalid = set.include({ "10.0.0.0/8", "10.0.0.0/33", "nonsense", "",
+                                              "::/129", "::/0" });
+    QCOMPARE(invalid, QStringList({ "10.0.0.0/33", "nonsense", "", "::/129" }));
+    QCOMPARE(strings(set.aggregate()), QStringList({ "10.0.0.0/8", "::/0" }));
+}
+
+void TestCidrSet::splitsDefaultRouteAroundExclusion()
+{
+    CidrSet set;
+    set.include({ "0.0.0.0/0" });
+    set.exclude({ "10.0.0.0/8" });
+    QCOMPARE(strings(set.aggregate()),
+             QStringList({ "0.0.0.0/5", "8.0.0.0/7", "11.0.0.0/8", "12.0.0.0/6",
+                           "16.0.0.0/4", "32.0.0.0/3", "64.0.0.0/2", "128.0.0.0/1" }));
+}
+
+void TestCidrSet::excludeWinsTies()
+{
+    for (bool excludeFirst : { false, true }) {
+        CidrSet set;
+        if (excludeFirst)
+            set.exclude({ "192.0.2.0/24" });
+        set.include({ "192.0.2.0/23", "192.0.2.0/24" });
+        if (!excludeFirst)
+            set.exclude({ "192.0.2.0/24" });
+        QCOMPARE(strings(set.aggregate()), QStringList({ "192.0.3.0/24" }));
+    }
+}
+
+void TestCidrSet::matchesReferenceModel_data()
+{
+    QTest::addColumn<bool>("v6");
+    QTest::addColumn<quint32>("seed");
+    for (quint32 seed : { 1u, 2u, 3u, 4u, 5u, 6u, 7u, 8u }) {
+        QTest::addRow("ipv4-%u", seed) << false << seed;
+        QTest::addRow("ipv6-%u", seed) << true << seed;
+    }
+}
+
+void TestCidrSet::matchesReferenceModel()
+{
+    QFETCH(bool, v6);
+    QFETCH(quint32, seed);
+    QRandomGenerator rng(seed);
+    const int maxLength = v6 ? 128 : 32;
+    const auto address  = [v6](quint32 offset) {
+        return v6 ? v6Address(offset) : v4Address(kV4Window + offset);
+    };
+
+    for (int round = 0; round < 50; ++round) {
+        QList<Rule> rules;
+        const int count = rng.bounded(1, 16);
+        for (int i = 0; i < count; ++i) {
+            Rule r;
+            r.include = rng.bounded(3) != 0;
+            if (rng.bounded(10) == 0) {
+                // Covers the whole window: the default route or a wider block.
+                r.prefix = prefixOf(v6, address(0), rng.bounded(2) ? 0 : maxLength - 24);
+            } else {
+                const int length = rng.bounded(maxLength - kWindowBits, maxLength + 1);
+                r.prefix = prefixOf(v6, address(rng.bounded(1u << kWindowBits)), length);
+            }
+            rules << r;
+        }
+
+        CidrSet set;
+        for (const Rule &r : rules)
+            r.include ? set.include(r.prefix) : set.exclude(r.prefix);
+        const QList<CidrPrefix> out = set.aggregate();
+
+        const QString problem = checkCanonical(out);
+        QVERIFY2(problem.isEmpty(), qPrintable(problem));
+        for (const CidrPrefix &p : out)
+            QCOMPARE(p.v6, v6);
+
+        for (quint32 offset = 0; offset < (1u << kWindowBits); ++offset) {
+            const Address a = address(offset);
+            if (covered(out, v6, a) != modelSelects(rules, v6, a))
+                QFAIL(qPrintable(QString("round %1: %2 disagrees with the model for %3")
+                                     .arg(round)
+                                     .arg(strings(out).join(' '))
+                                     .arg(prefixOf(v6, a, maxLength).toString())));
+        }
+        // Outside the window only the covering rules apply.
+        for (int i = 0; i < 64; ++i) {
+            Address a {};
+            for (auto &byte : a)
+                byte = quint8(rng.bounded(256));
+            if (!v6)
+                std::fill(a.begin() + 4, a.end(), 0);
+            QCOMPARE(covered(out, v6, a), modelSelects(rules, v6, a));
+        }
+    }
+}
+
+void TestCidrSet::benchmarkBypassList()
+{
+    // The split-tunnel case: a full tunnel minus a country-sized bypass list.
+    // DKT_VPN_BENCH_PREFIX_LIST may name a file with one prefix per line to
+    // measure a real list; otherwise ~50k deterministic prefixes are used.
+    QStringList bypass;
+    const QString listFile = qEnvironmentVariable("DKT_VPN_BENCH_PREFIX_LIST");
+    if (!listFile.isEmpty()) {
+        QFile file(listFile);
+        QVERIFY2(file.open(QIODevice::ReadOnly | QIODevice::Text), qPrintable(listFile));
+        while (!file.atEnd()) {
+            const QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (!line.isEmpty() && !line.startsWith('#'))
+                bypass << line;
+        }
+    } else {
+        QRandomGenerator rng(42);
+        for (int i = 0; i < 45000; ++i) {
+            const int length = rng.bounded(12, 25);
+            bypass << prefixOf(false, v4Address(rng.generate()), length).toString();
+        }
+        for (int i = 0; i < 5000; ++i) {
+            Address a { 0x20, 0x01 };
+            for (int b = 2; b < 6; ++b)
+                a[size_t(b)] = quint8(rng.bounded(256));
+            bypass << prefixOf(true, a, rng.bounded(29, 49)).toString();
+        }
+    }
+
+    qsizetype routes = 0;
+    QBENCHMARK {
+        CidrSet set;
+        set.include({ "0.0.0.0/0", "::/0" });
+        QVERIFY(set.exclude(bypass).isEmpty());
+        routes = set.aggregate().size();
+    }
+    qInfo("%lld bypass prefixes -> %lld routes", qlonglong(bypass.size()), qlonglong(routes));
+    QVERIFY(routes > 0);
+}
+
+QTEST_GUILESS_MAIN(TestCidrSet)
+#include "tst_cidrset.moc"
@@ -0,0 +1,254 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryDir>
+#include <QtTest>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "logger.h"
+
+namespace {
+
+/// Keeps every formatted line; written on the logger's writer thread.
+class CaptureSink : public LogSink
+{
+public:
+    void write(const LogRecord &, const QString &line, const QString &) override
+    {
+        QMutexLocker lock(&m_mutex);
+        m_lines << line;
+    }
+
+    QStringList lines() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return m_lines;
+    }
+
+    int count() const
+    {
+        QMutexLocker lock(&m_mutex);
+        return int(m_lines.size());
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QStringList    m_lines;
+};
+
+/// Counts the records it passes on to another sink.
+class CountingSink : public LogSink
+{
+public:
+    explicit CountingSink(std::unique_ptr<LogSink> inner) : m_inner(std::move(inner)) {}
+
+    void write(const LogRecord &record, const QString &line, const QString &text) override
+    {
+        m_inner->write(record, line, text);
+        m_count.fetch_add(1, std::memory_order_release);
+    }
+    void flush() override { m_inner->flush(); }
+
+    int count() const { return m_count.load(std::memory_order_acquire); }
+
+private:
+    std::unique_ptr<LogSink> m_inner;
+    std::atomic<int>         m_count { 0 };
+};
+
+/// Runs @p body with a capturing sink attached; shutdown() drains every
+/// record before the lines are returned.
+QStringList capture(const std::function<void()> &body)
+{
+    auto sink = std::make_shared<CaptureSink>();
+    Logger &logger = Logger::instance();
+    logger.addSink(sink);
+    logger.start();
+    body();
+    logger.shutdown();
+    logger.removeSink(sink.get());
+    return sink->lines();
+}
+
+} // namespace
+
+class TestLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void escapesMultiLineMessages();
+    void quotesAndEscapesFieldValues();
+    void splitsRawOutputIntoRecords();
+    void rotatesAtTheSizeCap();
+    void benchmarkCallerLatency();
+    void benchmarkThroughput_data();
+    void benchmarkThroughput();
+};
+
+void TestLogger::escapesMultiLineMessages()
+{
+    const QStringList lines = capture([] {
+        Logger::instance().log(LogLevel::Error, "test", "dkt-de",
+                               "Failed to connect.\nwg-quick: \"exit\" \\ 1");
+    });
+    QCOMPARE(lines.size(), 1);
+    QVERIFY(!lines.first().contains('\n'));
+    QVERIFY(lines.first().endsWith(" tunnel=dkt-de Failed to connect.\\nwg-quick: \\\"exit\\\" \\\\ 1"));
+}
+
+void TestLogger::quotesAndEscapesFieldValues()
+{
+    const QStringList lines = capture([] {
+        Logger::instance().log(LogLevel::Info, "test", "my tunnel", "m",
+                               { { "plain", 42 },
+                                 { "path", QStringLiteral("C:\\dkt \"x\"") },
+                                 { "error", QStringLiteral("a\nb") },
+                                 { "empty", QString() } });
+    });
+    QCOMPARE(lines.size(), 1);
+    const QString &line = lines.first();
+    QVERIFY(line.contains(" tunnel=\"my tunnel\" m "));
+    QVERIFY(line.contains(" plain=42"));
+    QVERIFY(line.contains(" path=\"C:\\\\dkt \\\"x\\\"\""));
+    QVERIFY(line.contains(" error=\"a\\nb\""));
+    QVERIFY(line.endsWith(" empty=\"\""));
+}
+
+void TestLogger::splitsRawOutputIntoRecords()
+{
+    const QStringList lines = capture([] {
+        Logger::instance().logRaw(LogLevel::Info, "wg-quick", "dkt-de",
+                                  "[#] ip link add dkt-de type wireguard\n\n[#] wg setconf\r\n");
+    });
+    QCOMPARE(lines.size(), 2);
+    QVERIFY(lines[0].endsWith("[#] ip link add dkt-de type wireguard"));
+    QVERIFY(lines[1].endsWith("[#] wg setconf"));
+}
+
+void TestLogger::rotatesAtTheSizeCap()
+{
+    // 100-byte lines against a 1000-byte cap and three old files. The
+    // current file already holds 950 bytes, so the first line rotates it.
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("dkt-vpn.log");
+    {
+        QFile existing(path);
+        QVERIFY(existing.open(QIODevice::WriteOnly));
+        existing.write(QByteArray(949, 'o') + '\n');
+    }
+
+    {
+        RotatingFileSink sink(path, 1000, 3);
+        for (int i = 0; i < 50; ++i) {
+            const QString line = QString("%1").arg(i, 2, 10, QChar('0')).leftJustified(99, '.');
+            sink.write(LogRecord(), line, line);
+        }
+        sink.flush();
+    }
+
+    // The old content and lines 0-9 were rotated out; 10-19 are in .3,
+    // 20-29 in .2, 30-39 in .1 and 40-49 in the current file.
+    const auto read = [&](const QString &name) {
+        QFile f(dir.filePath(name));
+        return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+    };
+    for (const QString &name : { "dkt-vpn.log", "dkt-vpn.log.1", "dkt-vpn.log.2", "dkt-vpn.log.3" }) {
+        QVERIFY2(QFileInfo(dir.filePath(name)).size() <= 1000, qPrintable(name));
+        QCOMPARE(read(name).count('\n'), 10);
+    }
+    QVERIFY(!QFileInfo::exists(dir.filePath("dkt-vpn.log.4")));
+    QVERIFY(read("dkt-vpn.log").startsWith("40."));
+    QVERIFY(read("dkt-vpn.log.1").startsWith("30."));
+    QVERIFY(read("dkt-vpn.log.3").startsWith("10."));
+}
+
+void TestLogger::benchmarkCallerLatency()
+{
+    // Cost on the calling thread only: capture the record, push it on the
+    // ring. Calls are timed one by one in batches the ring can hold, and the
+    // writer catches up between batches, so no call takes the drop path.
+    constexpr int kBatches = 100;
+    constexpr int kBatch   = 512; // half the ring: the push that fills it wakes the writer
+    auto sink = std::make_shared<CaptureSink>();
+    Logger &logger = Logger::instance();
+    logger.addSink(sink);
+    logger.start();
+
+    std::vector<qint64> nanos;
+    nanos.reserve(kBatches * kBatch);
+    QElapsedTimer clock;
+    for (int b = 0; b < kBatches; ++b) {
+        for (int i = 0; i < kBatch; ++i) {
+            clock.start();
+            logger.log(LogLevel::Info, "bench", "dkt-de", QStringLiteral("poll finished"),
+                       { { "rx", 123456789 }, { "elapsed_ms", 12 } });
+            nanos.push_back(clock.nsecsElapsed());
+        }
+        while (sink->count() < (b + 1) * kBatch)
+            QThread::yieldCurrentThread();
+    }
+    logger.shutdown();
+    logger.removeSink(sink.get());
+
+    std::sort(nanos.begin(), nanos.end());
+    const auto at = [&](double q) { return nanos[size_t(q * double(nanos.size() - 1))]; };
+    qInfo("log() on the caller: p50 %lld ns, p99 %lld ns, p99.9 %lld ns, max %lld ns",
+          at(0.5), at(0.99), at(0.999), nanos.back());
+    QCOMPARE(sink->count(), kBatches * kBatch);
+}
+
+void TestLogger::benchmarkThroughput_data()
+{
+    QTest::addColumn<bool>("toFile");
+    QTest::newRow("memory") << false;
+    QTest::newRow("rotating file") << true;
+}
+
+void TestLogger::benchmarkThroughput()
+{
+    // Lines per second through the writer into a sink. The caller waits
+    // whenever its ring is half full, so nothing is dropped and the rate is
+    // that of the writer. The file run rotates every few thousand lines.
+    QFETCH(bool, toFile);
+    constexpr int kLines = 200000;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::unique_ptr<LogSink> inner;
+    if (toFile)
+        inner = std::make_unique<RotatingFileSink>(dir.filePath("bench.log"), 1 << 20, 5);
+    else
+        inner = std::make_unique<CaptureSink>();
+    auto sink = std::make_shared<CountingSink>(std::move(inner));
+    Logger &logger = Logger::instance();
+    logger.addSink(sink);
+    logger.start();
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < kLines; ++i) {
+        logger.log(LogLevel::Info, "bench", "dkt-de", QStringLiteral("poll finished"),
+                   { { "seq", i } });
+        if ((i & 511) == 511) {
+            while (sink->count() < i - 256)
+                QThread::yieldCurrentThread();
+        }
+    }
+    logger.shutdown();
+    const qint64 elapsedNs = clock.nsecsElapsed();
+    logger.removeSink(sink.get());
+
+    QCOMPARE(sink->count(), kLines);
+    qInfo("%s: %d lines in %.1f ms: %.0f lines/s", QTest::currentDataTag(), kLines,
+          elapsedNs / 1e6, kLines / (elapsedNs / 1e9));
+    if (toFile)
+        QVERIFY(QFileInfo::exists(dir.filePath("bench.log.1")));
+}
+
+QTEST_GUILESS_MAIN(TestLogger)
+#include "tst_logger.moc"
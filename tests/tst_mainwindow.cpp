@@ -0,0 +1,132 @@
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QPushButton>
+#include <QThread>
+#include <QTimer>
+#include <QtTest>
+
+#include "faketools.h"
+#include "mainwindow.h"
+
+namespace {
+
+/// Longest gap between ticks of a 10 ms timer on the calling thread, i.e.
+/// the worst stall a user would have seen while it was running.
+class StallMeter : public QObject
+{
+public:
+    StallMeter()
+    {
+        m_timer.setInterval(10);
+        m_timer.setTimerType(Qt::PreciseTimer);
+        QObject::connect(&m_timer, &QTimer::timeout, this, [this] {
+            m_worstMs = qMax(m_worstMs, m_clock.restart() - 10);
+        });
+        m_clock.start();
+        m_timer.start();
+    }
+
+    qint64 worstMs() const { return m_worstMs; }
+
+private:
+    QTimer        m_timer;
+    QElapsedTimer m_clock;
+    qint64        m_worstMs = 0;
+};
+
+} // namespace
+
+class TestMainWindow : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void staysResponsiveWithSlowTools();
+    void destroyingWithoutCloseStopsTools();
+};
+
+void TestMainWindow::staysResponsiveWithSlowTools()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The stand-in tools are shell scripts");
+#else
+    // Every tool takes a second or more. Had any of them run on the UI
+    // thread, the meter would see a stall of that length.
+    FakeTools tools;
+    QVERIFY(tools.isValid());
+    QVERIFY(tools.addConfig("dkt-us", kSampleConfig));
+    QVERIFY(tools.addTool("wg-quick", "sleep 1"));
+    QVERIFY(tools.addTool("wg",
+        "sleep 1.5\n"
+        "printf 'priv\\tpub\\t51820\\toff\\n'\n"
+        "printf 'peer\\t(none)\\t192.0.2.1:51820\\t10.8.0.0/24\\t%s\\t1234\\t5678\\t0\\n' "
+        "\"$(date +%s)\""));
+
+    MainWindow window;
+    auto *button = window.findChild<QPushButton *>("connectBtn");
+    auto *status = window.findChild<QLabel *>("statusLabel");
+    auto *worker = window.findChild<QThread *>("vpn-manager");
+    QVERIFY(button && status && worker);
+    // Duration, Downloaded, Uploaded, Latency
+    const QList<QLabel *> values = window.findChildren<QLabel *>("statValue");
+    QCOMPARE(values.size(), 4);
+    QLabel *received = values.at(1);
+
+    StallMeter meter;
+    button->click();
+    QTRY_COMPARE_WITH_TIMEOUT(status->text(), QStringLiteral("Connected"), 10000);
+    // Stats from the slow `wg show` reach the window; keep polling a while.
+    QTRY_VERIFY_WITH_TIMEOUT(received->text() != QStringLiteral("—"), 10000);
+    QTest::qWait(3500);
+
+    button->click();
+    QTRY_COMPARE_WITH_TIMEOUT(status->text(), QStringLiteral("Disconnected"), 10000);
+
+    // Connect again and close the window while wg-quick is still running:
+    // shutdown kills it on the manager's thread, the UI just waits.
+    button->click();
+    QTest::qWait(200);
+    window.close();
+    QTRY_VERIFY_WITH_TIMEOUT(worker->isFinished(), 10000);
+
+    qInfo("worst UI stall: %lld ms", meter.worstMs());
+    QVERIFY2(meter.worstMs() < 250, qPrintable(QString("UI thread stalled for %1 ms")
+                                                   .arg(meter.worstMs())));
+#endif
+}
+
+void TestMainWindow::destroyingWithoutCloseStopsTools()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The stand-in tools are shell scripts");
+#else
+    // QApplication::quit() destroys the window without a closeEvent. A
+    // wg-quick still running then must not outlive it.
+    FakeTools tools;
+    QVERIFY(tools.isValid());
+    QVERIFY(tools.addConfig("dkt-us", kSampleConfig));
+    const QString pidFile = tools.path() + "/wg-quick.pid";
+    QVERIFY(tools.addTool("wg-quick",
+        "echo $$ > '" + QFile::encodeName(pidFile) + "'\nexec sleep 30"));
+
+    QString pid;
+    {
+        MainWindow window;
+        auto *button = window.findChild<QPushButton *>("connectBtn");
+        QVERIFY(button);
+        button->click();
+        QTRY_VERIFY_WITH_TIMEOUT(QFile::exists(pidFile), 10000);
+        QTest::qWait(100);
+        QFile file(pidFile);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        pid = QString::fromLatin1(file.readAll().trimmed());
+        QVERIFY(!pid.isEmpty());
+        QVERIFY(QFile::exists("/proc/" + pid));
+    }
+    // The destructor waited for the shutdown, which kills and reaps it.
+    QVERIFY2(!QFile::exists("/proc/" + pid), qPrintable("wg-quick " + pid + " still runs"));
+#endif
+}
+
+QTEST_MAIN(TestMainWindow)
+#include "tst_mainwindow.moc"
@@ -0,0 +1,139 @@
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QtTest>
+
+#include "faketools.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "vpnmanager.h"
+
+namespace {
+
+/// Full response to `GET @p path` from 127.0.0.1:@p port. The server runs
+/// on this thread, so the exchange is driven by the event loop.
+QByteArray httpGet(quint16 port, const QByteArray &path)
+{
+    QTcpSocket socket;
+    QByteArray response;
+    QObject::connect(&socket, &QTcpSocket::readyRead, [&] { response += socket.readAll(); });
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    socket.write("GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QTest::qWaitFor([&] { return socket.state() == QAbstractSocket::UnconnectedState; }, 5000);
+    return response + socket.readAll();
+}
+
+} // namespace
+
+class TestMetrics : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void histogramCountsEveryObservation();
+    void bondTotalsAreSeparateFromTunnels();
+    void queueSeriesResetWithNewShaper();
+    void scrapeAfterConnect();
+};
+
+void TestMetrics::histogramCountsEveryObservation()
+{
+    MetricsHistogram histogram({ 0.1, 1.0 });
+    histogram.observe(0.05);
+    histogram.observe(0.5);
+    histogram.observe(5);
+
+    QByteArray out;
+    histogram.format(out, "x", "a=\"b\"");
+    QVERIFY(out.contains("x_bucket{a=\"b\",le=\"0.1\"} 1\n"));
+    QVERIFY(out.contains("x_bucket{a=\"b\",le=\"1\"} 2\n"));
+    QVERIFY(out.contains("x_bucket{a=\"b\",le=\"+Inf\"} 3\n"));
+    QVERIFY(out.contains("x_count{a=\"b\"} 3\n"));
+    QVERIFY(out.contains("x_sum{a=\"b\"} 5.550000\n"));
+}
+
+void TestMetrics::bondTotalsAreSeparateFromTunnels()
+{
+    VpnMetrics metrics;
+    metrics.tunnel("dkt-de")->rxBytes.store(100);
+    metrics.tunnel("dkt-nl")->rxBytes.store(50);
+    metrics.bond("bond-eu")->rxBytes.store(150);
+
+    const QByteArray text = metrics.scrape();
+    QVERIFY(text.contains("dkt_vpn_tunnel_rx_bytes_total{tunnel=\"dkt-de\"} 100\n"));
+    QVERIFY(text.contains("dkt_vpn_bond_rx_bytes_total{bond=\"bond-eu\"} 150\n"));
+    QVERIFY(!text.contains("tunnel=\"bond-eu\""));
+}
+
+void TestMetrics::queueSeriesResetWithNewShaper()
+{
+    // cake reported all four tins; after a reload to fq_codel only
+    // best_effort may be exported.
+    VpnMetrics metrics;
+    TunnelMetrics *t = metrics.tunnel("dkt-de");
+    t->queue[0].sentBytes.store(100);
+    t->queue[1].sentBytes.store(200);
+    t->queueClassMask.store(0xf);
+    t->queueRate.store(2'500'000);
+    QVERIFY(metrics.scrape().contains(
+        "dkt_vpn_queue_sent_bytes_total{tunnel=\"dkt-de\",class=\"bulk\"} 100\n"));
+
+    t->resetQueue();
+    QVERIFY(!metrics.scrape().contains("dkt_vpn_queue_sent_bytes_total{"));
+    t->queue[1].sentBytes.store(7);
+    t->queueClassMask.store(1u << 1);
+    const QByteArray text = metrics.scrape();
+    QVERIFY(text.contains(
+        "dkt_vpn_queue_sent_bytes_total{tunnel=\"dkt-de\",class=\"best_effort\"} 7\n"));
+    QVERIFY(!text.contains("class=\"bulk\""));
+    QVERIFY(text.contains("dkt_vpn_queue_shape_rate_bytes_per_second{tunnel=\"dkt-de\"} 0\n"));
+}
+
+void TestMetrics::scrapeAfterConnect()
+{
+#ifndef Q_OS_UNIX
+    QSKIP("The stand-in tools are shell scripts");
+#else
+    FakeTools tools;
+    QVERIFY(tools.isValid());
+    QVERIFY(tools.addConfig("dkt-test", kSampleConfig));
+    // `wg show <tunnel> dump` with a handshake one second before "now",
+    // i.e. completed while wg-quick was still running.
+    QVERIFY(tools.addTool("wg",
+        "printf 'priv\\tpub\\t51820\\toff\\n'\n"
+        "printf 'peer\\t(none)\\t192.0.2.1:51820\\t10.8.0.0/24\\t%s\\t1234\\t5678\\t0\\n' "
+        "\"$(( $(date +%s) - 1 ))\""));
+
+    VpnManager manager;
+    QSignalSpy stats(&manager, &VpnManager::statsUpdated);
+    manager.connectToServer({ "Test", "xx", {}, "dkt-test" });
+    QVERIFY(stats.wait(5000));
+
+    // Scraped the way Prometheus would, through the endpoint.
+    MetricsServer server(&manager.metrics());
+    QVERIFY(server.listen(0));
+    const QByteArray response = httpGet(server.port(), "/metrics");
+    const qsizetype headerEnd = response.indexOf("\r\n\r\n");
+    QVERIFY(headerEnd > 0);
+    const QByteArray headers = response.left(headerEnd);
+    const QByteArray text = response.mid(headerEnd + 4);
+    QVERIFY(headers.startsWith("HTTP/1.1 200 OK\r\n"));
+    QVERIFY(headers.contains(
+        "\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8"));
+    QVERIFY(headers.contains("\r\nContent-Length: " + QByteArray::number(text.size())));
+    QVERIFY(text.contains("dkt_vpn_tunnel_rx_bytes_total{tunnel=\"dkt-test\"} 1234\n"));
+    QVERIFY(text.contains("dkt_vpn_tunnel_tx_bytes_total{tunnel=\"dkt-test\"} 5678\n"));
+    QVERIFY(text.contains("dkt_vpn_tunnel_connects_total{tunnel=\"dkt-test\"} 1\n"));
+    QVERIFY(text.contains("dkt_vpn_tunnel_handshake_age_seconds{tunnel=\"dkt-test\"} "));
+    QVERIFY(text.contains("dkt_vpn_connect_phase_seconds_count{phase=\"tunnel_up\"} 1\n"));
+    QVERIFY(text.contains("dkt_vpn_connect_phase_seconds_count{phase=\"first_handshake\"} 1\n"));
+    QVERIFY(text.contains("dkt_vpn_connect_phase_seconds_count{phase=\"total\"} 1\n"));
+    QVERIFY(text.endsWith("# EOF\n"));
+
+    const QByteArray notFound = httpGet(server.port(), "/");
+    QVERIFY(notFound.startsWith("HTTP/1.1 404 Not Found\r\n"));
+    QVERIFY(!notFound.contains("dkt_vpn_"));
+#endif
+}
+
+QTEST_GUILESS_MAIN(TestMetrics)
+#include "tst_metrics.moc"
@@ -0,0 +1,551 @@
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QtTest>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "vpnmanager.h"
+
+/*
+ * Scenarios against real WireGuard tunnels. netns/run.sh builds the
+ * namespaces and starts this binary inside the client one with the scenario
+ * name as its only argument; run on its own, every scenario is skipped.
+ */
+
+namespace {
+
+/// Runs @p program to completion in the client namespace.
+bool run(const QString &program, const QStringList &args, QByteArray *output = nullptr)
+{
+    QProcess p;
+    p.setProcessChannelMode(QProcess::MergedChannels);
+    p.start(program, args);
+    if (!p.waitForFinished(30000))
+        return false;
+    if (output)
+        *output = p.readAll();
+    return p.exitStatus() == QProcess::NormalExit && p.exitCode() == 0;
+}
+
+/// Arguments that run @p command in the server namespace through `ip`.
+QStringList inServer(const QStringList &command)
+{
+    return QStringList { "netns", "exec", qEnvironmentVariable("DKT_VPN_NETNS_SERVER") } + command;
+}
+
+/// Value of the sample @p series (name plus labels) in a scrape; -1 if absent.
+double sample(const QByteArray &scrape, const QByteArray &series)
+{
+    for (const QByteArray &line : scrape.split('\n')) {
+        if (line.startsWith(series + ' '))
+            return line.mid(series.size() + 1).toDouble();
+    }
+    return -1;
+}
+
+VpnServer server(const QString &configName)
+{
+    return { configName, "xx", {}, configName };
+}
+
+/// Writes config @p name: a copy of @p base with AllowedIPs set to @p allowed.
+bool writeConfig(const QString &name, const QString &base, const QString &allowed)
+{
+    const QString dir = qEnvironmentVariable("DKT_VPN_CONFIG_DIR");
+    QFile in(dir + '/' + base + ".conf");
+    QFile out(dir + '/' + name + ".conf");
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly))
+        return false;
+    QByteArray text = in.readAll();
+    const qsizetype start = text.indexOf("AllowedIPs = ");
+    const qsizetype end = text.indexOf('\n', start);
+    text.replace(start, end - start, "AllowedIPs = " + allowed.toLatin1());
+    return out.write(text) == text.size();
+}
+
+/// Waits until @p status, a spy on statusChanged, last reported @p wanted.
+bool reached(QSignalSpy &status, VpnStatus wanted, int timeoutMs = 30000)
+{
+    return QTest::qWaitFor([&] {
+        return !status.isEmpty() && status.last().at(0).value<VpnStatus>() == wanted;
+    }, timeoutMs);
+}
+
+/// Output of `ip <args>` in the client namespace; empty on failure.
+QByteArray ip(const QStringList &args)
+{
+    QByteArray out;
+    return run("ip", args, &out) ? out : QByteArray();
+}
+
+/// Bytes the client's interface @p iface has sent, from `wg show`.
+quint64 sentBytes(const QString &iface)
+{
+    QByteArray out;
+    if (!run("wg", { "show", iface, "transfer" }, &out))
+        return 0;
+    quint64 total = 0;
+    for (const QByteArray &line : out.split('\n')) {
+        const QList<QByteArray> fields = line.split('\t');
+        if (fields.size() == 3)
+            total += fields[2].toULongLong();
+    }
+    return total;
+}
+
+/// Bytes the server's interface @p iface has received from its peers.
+quint64 serverReceived(const QString &iface)
+{
+    QByteArray out;
+    if (!run("ip", inServer({ "wg", "show", iface, "transfer" }), &out))
+        return 0;
+    quint64 total = 0;
+    for (const QByteArray &line : out.split('\n')) {
+        const QList<QByteArray> fields = line.split('\t');
+        if (fields.size() == 3)
+            total += fields[1].toULongLong();
+    }
+    return total;
+}
+
+/// @p count UDP flows to the server's traffic sink, one per source port.
+class Flows
+{
+public:
+    Flows(quint16 firstPort, int count)
+    {
+        for (int i = 0; i < count; ++i) {
+            auto socket = std::make_unique<QUdpSocket>();
+            if (socket->bind(QHostAddress::AnyIPv4, quint16(firstPort + i)))
+                m_sockets.push_back(std::move(socket));
+        }
+    }
+
+    int size() const { return int(m_sockets.size()); }
+
+    void send(int packets)
+    {
+        const QByteArray payload(1000, 'x');
+        for (int p = 0; p < packets; ++p) {
+            for (const auto &socket : m_sockets)
+                socket->writeDatagram(payload, QHostAddress("198.18.0.1"), 9);
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<QUdpSocket>> m_sockets;
+};
+
+} // namespace
+
+class TestNetns : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void roaming();
+    void bonding();
+    void bondingThroughput();
+    void probe();
+    void nativeRouting();
+    void connectLatency();
+    void bufferbloat();
+
+private:
+    /// Connects @p target and waits for Connected and a first handshake.
+    bool connectAndWait(VpnManager &manager, const VpnServer &target);
+    bool disconnectAndWait(VpnManager &manager);
+    /// Starts a command that runs until cleanup().
+    void background(const QString &program, const QStringList &args);
+
+    QList<QProcess *> m_background;
+};
+
+void TestNetns::initTestCase()
+{
+    if (qEnvironmentVariableIsEmpty("DKT_VPN_NETNS"))
+        QSKIP("Needs the namespaces set up by tests/netns/run.sh");
+    QStandardPaths::setTestModeEnabled(true);
+    qRegisterMetaType<VpnStatus>();
+    qRegisterMetaType<VpnStats>();
+    qRegisterMetaType<LatencyQuality>();
+}
+
+void TestNetns::cleanup()
+{
+    for (QProcess *p : std::as_const(m_background)) {
+        p->kill();
+        p->waitForFinished(2000);
+    }
+    qDeleteAll(m_background);
+    m_background.clear();
+}
+
+bool TestNetns::connectAndWait(VpnManager &manager, const VpnServer &target)
+{
+    QSignalSpy status(&manager, &VpnManager::statusChanged);
+    QSignalSpy stats(&manager, &VpnManager::statsUpdated);
+    manager.connectToServer(target);
+    const bool connected = QTest::qWaitFor([&] {
+        return !status.isEmpty()
+            && status.last().at(0).value<VpnStatus>() == VpnStatus::Connected;
+    }, 30000);
+    if (!connected) {
+        if (!status.isEmpty())
+            qWarning() << status.last().at(1).toString();
+        return false;
+    }
+    return QTest::qWaitFor([&] {
+        return !stats.isEmpty() && stats.last().at(0).value<VpnStats>().latestHandshake > 0;
+    }, 15000);
+}
+
+bool TestNetns::disconnectAndWait(VpnManager &manager)
+{
+    QSignalSpy status(&manager, &VpnManager::statusChanged);
+    manager.disconnect();
+    return QTest::qWaitFor([&] {
+        return !status.isEmpty()
+            && status.last().at(0).value<VpnStatus>() == VpnStatus::Disconnected;
+    }, 30000);
+}
+
+void TestNetns::background(const QString &program, const QStringList &args)
+{
+    auto *p = new QProcess;
+    p->setStandardOutputFile(QProcess::nullDevice());
+    p->setStandardErrorFile(QProcess::nullDevice());
+    p->start(program, args);
+    m_background << p;
+}
+
+void TestNetns::roaming()
+{
+    // dkt-a's endpoint moves from the c0 uplink to c1 while the server keeps
+    // sending. Recovery is the first poll that sees new traffic; it cannot be
+    // shorter than the time the server took to learn the new address.
+    VpnManager manager;
+    QVERIFY(connectAndWait(manager, server("dkt-a")));
+    background("ip", inServer({ "ping", "-q", "-i", "0.2", "10.8.0.2" }));
+    QTest::qWait(1500);
+
+    const qint64 changedMs = QDateTime::currentMSecsSinceEpoch();
+    QVERIFY(run("ip", { "route", "replace", "203.0.113.1/32", "via", "198.51.100.1", "dev", "c1" }));
+    QVERIFY(run("ip", { "link", "set", "c0", "down" }));
+
+    qint64 learnedMs = 0;
+    QVERIFY(QTest::qWaitFor([&] {
+        QByteArray endpoints;
+        if (!learnedMs && run("ip", inServer({ "wg", "show", "wg0", "endpoints" }), &endpoints)
+            && endpoints.contains("198.51.100.2"))
+            learnedMs = QDateTime::currentMSecsSinceEpoch();
+        return learnedMs
+            && sample(manager.metrics().scrape(), "dkt_vpn_roaming_recovery_seconds_count") >= 1;
+    }, 30000));
+
+    const double recovery = sample(manager.metrics().scrape(), "dkt_vpn_roaming_recovery_seconds_sum");
+    const double learned  = (learnedMs - changedMs) / 1000.0;
+    qInfo("server learned the new endpoint after %.2f s, recovery recorded as %.2f s",
+          learned, recovery);
+    // learnedMs trails the server by at most one `wg show`.
+    QVERIFY(recovery + 0.1 >= learned);
+    QVERIFY(run("ping", { "-c", "3", "-W", "1", "10.8.0.1" }));
+    QVERIFY(disconnectAndWait(manager));
+}
+
+void TestNetns::bonding()
+{
+    // dkt-a and dkt-b bonded: flows spread over both, and once the server
+    // stops answering on dkt-b, new traffic all goes through dkt-a.
+    VpnManager manager;
+    const VpnServer bond { "Netns Bond", "bond", {}, "bond-netns", { "dkt-a", "dkt-b" } };
+    QVERIFY(connectAndWait(manager, bond));
+
+    Flows flows(40000, 64);
+    QCOMPARE(flows.size(), 64);
+    quint64 a = sentBytes("dkt-a"), b = sentBytes("dkt-b");
+    flows.send(20);
+    QTest::qWait(500);
+    const quint64 spreadA = sentBytes("dkt-a") - a, spreadB = sentBytes("dkt-b") - b;
+    qInfo("64 flows: %llu bytes over dkt-a, %llu over dkt-b", spreadA, spreadB);
+    QVERIFY(spreadA > 100000 && spreadB > 100000);
+
+    // The server forgets dkt-b's peer: the client keeps sending but hears
+    // nothing back, which takes the member out after a few polls.
+    QVERIFY(run("ip", inServer({ "sh", "-c", "wg set wg1 peer \"$(wg show wg1 peers)\" remove" })));
+    QVERIFY(QTest::qWaitFor([&] {
+        a = sentBytes("dkt-a");
+        b = sentBytes("dkt-b");
+        flows.send(5);
+        QTest::qWait(300);
+        const quint64 da = sentBytes("dkt-a") - a, db = sentBytes("dkt-b") - b;
+        return da > 100000 && db < 5000;
+    }, 40000));
+
+    const QByteArray scrape = manager.metrics().scrape();
+    QVERIFY(sample(scrape, "dkt_vpn_bond_tx_bytes_total{bond=\"bond-netns\"}") > 0);
+    QVERIFY(!scrape.contains("tunnel=\"bond-netns\""));
+
+    QVERIFY(disconnectAndWait(manager));
+    QVERIFY(!run("nft", { "list", "table", "inet", "dkt_bond" }));
+    QVERIFY(!run("ip", { "link", "show", "dev", "dkt-a" }));
+}
+
+void TestNetns::bondingThroughput()
+{
+    // c0 and c1 are each limited to 20 Mbit/s. 64 UDP flows offer about
+    // 100 Mbit/s to the sink for 5 s, first through dkt-a alone, then
+    // through the bond of dkt-a and dkt-b. Goodput is what the server's
+    // tunnels received.
+    for (const char *dev : { "c0", "c1" })
+        QVERIFY(run("tc", { "qdisc", "add", "dev", dev, "root", "tbf", "rate", "20mbit",
+                            "burst", "32kbit", "latency", "50ms" }));
+    QVERIFY(writeConfig("dkt-one", "dkt-a", "10.8.0.0/24, 198.18.0.1/32"));
+
+    const auto goodput = [] {
+        Flows flows(42000, 64);
+        QTimer load;
+        QObject::connect(&load, &QTimer::timeout, [&flows] { flows.send(2); });
+        load.start(10);
+        QTest::qWait(1000); // past the initial burst and the first rebalance
+        const quint64 before = serverReceived("wg0") + serverReceived("wg1");
+        QElapsedTimer clock;
+        clock.start();
+        QTest::qWait(5000);
+        const quint64 received = serverReceived("wg0") + serverReceived("wg1") - before;
+        const double seconds = clock.nsecsElapsed() / 1e9;
+        load.stop();
+        return received * 8 / seconds / 1e6;
+    };
+
+    VpnManager single;
+    QVERIFY(connectAndWait(single, server("dkt-one")));
+    const double one = goodput();
+    QVERIFY(disconnectAndWait(single));
+
+    VpnManager bonded;
+    const VpnServer bond { "Netns Bond", "bond", {}, "bond-netns", { "dkt-a", "dkt-b" } };
+    QVERIFY(connectAndWait(bonded, bond));
+    const double both = goodput();
+    QVERIFY(disconnectAndWait(bonded));
+    for (const char *dev : { "c0", "c1" })
+        QVERIFY(run("tc", { "qdisc", "del", "dev", dev, "root" }));
+
+    qInfo("goodput: one member %.1f Mbit/s, bond of two %.1f Mbit/s (%.2fx)",
+          one, both, both / one);
+    QVERIFY(one > 10);
+    QVERIFY(both > 1.5 * one);
+}
+
+void TestNetns::probe()
+{
+    // dkt-a's default probe target is the server's 10.8.0.1. While it drops
+    // echo requests the tunnel is fine; nothing may be reported as loss.
+    const auto ignoreEcho = [](bool ignore) {
+        return run("ip", inServer({ "sysctl", "-qw",
+                                    QString("net.ipv4.icmp_echo_ignore_all=%1").arg(int(ignore)) }));
+    };
+    QVERIFY(ignoreEcho(true));
+    VpnManager manager;
+    QSignalSpy quality(&manager, &VpnManager::qualityUpdated);
+    QVERIFY(connectAndWait(manager, server("dkt-a")));
+
+    QVERIFY(QTest::qWaitFor([&] { return !quality.isEmpty(); }, 20000));
+    QVERIFY(!quality.last().at(0).value<LatencyQuality>().responding);
+    QByteArray scrape = manager.metrics().scrape();
+    QVERIFY(sample(scrape, "dkt_vpn_tunnel_probes_sent_total{tunnel=\"dkt-a\"}") >= 5);
+    QCOMPARE(sample(scrape, "dkt_vpn_tunnel_probes_lost_total{tunnel=\"dkt-a\"}"), 0.0);
+    QCOMPARE(sample(scrape, "dkt_vpn_tunnel_probe_responding{tunnel=\"dkt-a\"}"), 0.0);
+
+    // Once it answers, RTT is reported, and from then on silence is loss.
+    QVERIFY(ignoreEcho(false));
+    QVERIFY(QTest::qWaitFor([&] {
+        if (quality.isEmpty())
+            return false;
+        const LatencyQuality q = quality.last().at(0).value<LatencyQuality>();
+        return q.responding && q.srttMs > 0;
+    }, 20000));
+    QCOMPARE(sample(manager.metrics().scrape(),
+                    "dkt_vpn_tunnel_probe_responding{tunnel=\"dkt-a\"}"), 1.0);
+
+    QVERIFY(ignoreEcho(true));
+    QVERIFY(QTest::qWaitFor([&] {
+        return sample(manager.metrics().scrape(),
+                      "dkt_vpn_tunnel_probes_lost_total{tunnel=\"dkt-a\"}") > 0;
+    }, 30000));
+    QVERIFY(ignoreEcho(false));
+    QVERIFY(disconnectAndWait(manager));
+}
+
+void TestNetns::nativeRouting()
+{
+    // Run with the native backend. Two tunnels with a default route each:
+    // the second takes the next free table, and taking it down leaves the
+    // first one's table and rules alone.
+    QVERIFY(writeConfig("dkt-x", "dkt-a", "0.0.0.0/0"));
+    QVERIFY(writeConfig("dkt-y", "dkt-b", "0.0.0.0/0"));
+    VpnManager first;
+    QVERIFY(connectAndWait(first, server("dkt-x")));
+    QVERIFY(ip({ "route", "show", "table", "51820" }).contains("dev dkt-x"));
+    QVERIFY(run("ping", { "-c", "2", "-W", "1", "10.8.0.1" }));
+
+    // Two default routes fight over every packet, so only the bookkeeping
+    // is checked while both are up.
+    VpnManager second;
+    QSignalSpy secondStatus(&second, &VpnManager::statusChanged);
+    second.connectToServer(server("dkt-y"));
+    QVERIFY(reached(secondStatus, VpnStatus::Connected));
+    QVERIFY(ip({ "route", "show", "table", "51821" }).contains("dev dkt-y"));
+    QVERIFY(ip({ "route", "show", "table", "51820" }).contains("dev dkt-x"));
+    QVERIFY(disconnectAndWait(second));
+
+    const QByteArray rules = ip({ "-4", "rule", "show" });
+    QVERIFY2(rules.contains("not from all fwmark 0xca6c lookup 51820"), rules.constData());
+    QVERIFY2(rules.contains("lookup main suppress_prefixlength 0"), rules.constData());
+    QVERIFY(!rules.contains("51821"));
+    QVERIFY(ip({ "route", "show", "table", "51820" }).contains("dev dkt-x"));
+    QVERIFY(run("ping", { "-c", "2", "-W", "1", "10.8.0.1" }));
+    QVERIFY(disconnectAndWait(first));
+    QVERIFY(!ip({ "-4", "rule", "show" }).contains("suppress_prefixlength"));
+
+    // A prefix that already has a route, here the c0 link, is not taken
+    // over: the connect fails and c0's route is still there afterwards.
+    QVERIFY(writeConfig("dkt-lan", "dkt-a", "10.8.0.0/24, 192.0.2.0/24"));
+    VpnManager lan;
+    QSignalSpy lanStatus(&lan, &VpnManager::statusChanged);
+    lan.connectToServer(server("dkt-lan"));
+    QVERIFY(reached(lanStatus, VpnStatus::Error));
+    QVERIFY(ip({ "route", "show", "exact", "192.0.2.0/24" }).contains("dev c0"));
+    QVERIFY(!run("ip", { "link", "show", "dev", "dkt-lan" }));
+}
+
+void TestNetns::connectLatency()
+{
+    // Connect and disconnect dkt-a with each backend. The native runs get a
+    // wg-quick that always fails, so a silent fallback shows up as an error
+    // instead of as a wg-quick timing.
+    constexpr int kRounds = 7;
+    QTemporaryDir stubs;
+    QVERIFY(stubs.isValid());
+    QFile stub(stubs.filePath("wg-quick"));
+    QVERIFY(stub.open(QIODevice::WriteOnly));
+    stub.write("#!/bin/sh\nexit 1\n");
+    stub.close();
+    stub.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    const auto median = [](QList<double> v) {
+        std::sort(v.begin(), v.end());
+        return v.at(v.size() / 2);
+    };
+    double connectMs[2] = {};
+    for (const bool native : { false, true }) {
+        qputenv("DKT_VPN_BACKEND", native ? "native" : "wg-quick");
+        if (native)
+            qputenv("DKT_VPN_TOOL_DIR", stubs.path().toLocal8Bit());
+        else
+            qunsetenv("DKT_VPN_TOOL_DIR");
+
+        VpnManager manager;
+        QList<double> up, down;
+        for (int round = 0; round < kRounds; ++round) {
+            QSignalSpy status(&manager, &VpnManager::statusChanged);
+            QElapsedTimer clock;
+            clock.start();
+            manager.connectToServer(server("dkt-a"));
+            QVERIFY(reached(status, VpnStatus::Connected));
+            up << clock.nsecsElapsed() / 1e6;
+            clock.restart();
+            manager.disconnect();
+            QVERIFY(reached(status, VpnStatus::Disconnected));
+            down << clock.nsecsElapsed() / 1e6;
+        }
+        connectMs[native] = median(up);
+        qInfo("%-8s connect p50 %6.1f ms (min %6.1f), disconnect p50 %6.1f ms (min %6.1f)",
+              native ? "native" : "wg-quick", median(up),
+              *std::min_element(up.cbegin(), up.cend()), median(down),
+              *std::min_element(down.cbegin(), down.cend()));
+    }
+    qunsetenv("DKT_VPN_TOOL_DIR");
+    qInfo("native connects in %.0f %% of the wg-quick time", 100 * connectMs[1] / connectMs[0]);
+}
+
+void TestNetns::bufferbloat()
+{
+    // c0 becomes a 20 Mbit/s uplink with a deep buffer. Pings through dkt-a
+    // are timed while UDP flows through the same tunnel keep it saturated,
+    // once with the kernel's default qdisc and once with cake shaping the
+    // tunnel just below the uplink.
+    if (!run("tc", { "qdisc", "add", "dev", "c1", "root", "cake" }))
+        QSKIP("Needs the sch_cake kernel module");
+    QVERIFY(run("tc", { "qdisc", "del", "dev", "c1", "root" }));
+    QVERIFY(run("tc", { "qdisc", "add", "dev", "c0", "root", "tbf", "rate", "20mbit",
+                        "burst", "32kbit", "latency", "400ms" }));
+    QVERIFY(writeConfig("dkt-bloat", "dkt-a", "10.8.0.0/24, 198.18.0.1/32"));
+    QVERIFY(writeConfig("dkt-cake", "dkt-a", "10.8.0.0/24, 198.18.0.1/32"));
+    {
+        QFile config(qEnvironmentVariable("DKT_VPN_CONFIG_DIR") + "/dkt-cake.conf");
+        QVERIFY(config.open(QIODevice::Append));
+        config.write("\n[DKT]\nQueueDiscipline = cake\nShapeRate = 18mbit\n");
+    }
+
+    const auto percentile = [](QList<double> v, double p) {
+        std::sort(v.begin(), v.end());
+        return v.at(qMin(v.size() - 1, qsizetype(p * v.size())));
+    };
+    // In-tunnel RTTs while about 25 Mbit/s of UDP is offered to the tunnel.
+    const auto rttsUnderLoad = [] {
+        Flows flows(41000, 4);
+        QTimer load;
+        QObject::connect(&load, &QTimer::timeout, [&flows] { flows.send(8); });
+        load.start(10);
+        QTest::qWait(2000); // let the standing queue build up
+
+        QProcess ping;
+        ping.start("ping", { "-n", "-c", "100", "-i", "0.1", "-W", "2", "10.8.0.1" });
+        QTest::qWaitFor([&] { return ping.state() == QProcess::NotRunning; }, 30000);
+        load.stop();
+
+        QList<double> rtts;
+        static const QRegularExpression time("time=([0-9.]+) ms");
+        auto it = time.globalMatch(QString::fromLatin1(ping.readAllStandardOutput()));
+        while (it.hasNext())
+            rtts << it.next().captured(1).toDouble();
+        return rtts;
+    };
+
+    double p99[2] = {};
+    for (const bool shaped : { false, true }) {
+        VpnManager manager;
+        const QString name = shaped ? "dkt-cake" : "dkt-bloat";
+        QVERIFY(connectAndWait(manager, server(name)));
+        if (shaped) {
+            QByteArray qdisc;
+            QVERIFY(run("tc", { "qdisc", "show", "dev", name }, &qdisc));
+            QVERIFY2(qdisc.contains("cake"), qdisc.constData());
+        }
+        const QList<double> rtts = rttsUnderLoad();
+        QVERIFY2(rtts.size() >= 50, qPrintable(QString("only %1 replies").arg(rtts.size())));
+        p99[shaped] = percentile(rtts, 0.99);
+        qInfo("%-9s RTT under load p50 %6.1f ms, p99 %6.1f ms, %lld/100 replies",
+              shaped ? "cake" : "unshaped", percentile(rtts, 0.5), p99[shaped],
+              qint64(rtts.size()));
+        QVERIFY(disconnectAndWait(manager));
+    }
+    QVERIFY(run("tc", { "qdisc", "del", "dev", "c0", "root" }));
+    // The tbf buffer alone holds up to 400 ms; cake keeps it nearly empty.
+    QVERIFY(p99[1] < p99[0] / 2);
+}
+
+QTEST_GUILESS_MAIN(TestNetns)
+#include "tst_netns.moc"
@@ -0,0 +1,380 @@
+#include <QtTest>
+
+#include "queueshaper.h"
+
+namespace {
+
+/// A tunnel config with @p dkt as its [DKT] section.
+TunnelConfig withOptions(const QString &dkt, const QString &endpoint = "192.0.2.1:51820")
+{
+    return TunnelConfig::parse(
+        "[Interface]\n"
+        "PrivateKey = cHJpdmF0ZQ==\n"
+        "Address = 10.8.0.2/24\n"
+        "\n"
+        "[Peer]\n"
+        "PublicKey = cGVlckE=\n"
+        "Endpoint = " + endpoint + "\n"
+        "AllowedIPs = 0.0.0.0/0\n"
+        "\n"
+        "[DKT]\n" + dkt + '\n');
+}
+
+std::unique_ptr<QueueShaper> shaper(const QString &dkt, const QString &endpoint = "192.0.2.1:51820")
+{
+    QString error;
+    auto s = QueueShaper::fromConfig("dkt-us", withOptions(dkt, endpoint), &error);
+    if (!error.isEmpty())
+        qWarning("%s", qPrintable(error));
+    return s;
+}
+
+// `tc -s -j qdisc show dev <tunnel>` output, iproute2 6.1, trimmed to one line each.
+
+/// cake bandwidth 40mbit diffserv4 overhead 60, after an upload with
+/// some voice traffic.
+const char kCakeDiffserv4[] =
+    R"([{"kind":"cake","handle":"8001:","root":true,"refcnt":2,)"
+    R"("options":{"bandwidth":5000000,"diffserv":"diffserv4","flowmode":"triple-isolate",)"
+    R"("nat":false,"wash":false,"ingress":false,"ack-filter":"disabled","split_gso":true,)"
+    R"("rtt":100000,"raw":false,"overhead":60,"fwmark":"0"},)"
+    R"("bytes":48211634,"packets":33102,"drops":41,"overlimits":28140,"requeues":0,)"
+    R"("backlog":4542,"qlen":3,"memory_used":612864,"memory_limit":4194304,)"
+    R"("capacity_estimate":5000000,"min_network_size":88,"max_network_size":1480,)"
+    R"("min_adj_size":148,"max_adj_size":1540,"avg_hdr_offset":0,"tins":[)"
+    R"({"threshold_rate":312500,"sent_bytes":0,"backlog_bytes":0,"target_us":15000,)"
+    R"("interval_us":110000,"peak_delay_us":0,"avg_delay_us":0,"base_delay_us":0,)"
+    R"("sent_packets":0,"way_indirect_hits":0,"way_misses":0,"way_collisions":0,)"
+    R"("drops":0,"ecn_mark":0,"ack_drops":0,"sparse_flows":0,"bulk_flows":0,)"
+    R"("unresponsive_flows":0,"max_pkt_len":0,"flow_quantum":1514},)"
+    R"({"threshold_rate":5000000,"sent_bytes":48126210,"backlog_bytes":4542,"target_us":5000,)"
+    R"("interval_us":100000,"peak_delay_us":9876,"avg_delay_us":4321,"base_delay_us":112,)"
+    R"("sent_packets":32780,"way_indirect_hits":0,"way_misses":9,"way_collisions":0,)"
+    R"("drops":41,"ecn_mark":17,"ack_drops":0,"sparse_flows":1,"bulk_flows":1,)"
+    R"("unresponsive_flows":0,"max_pkt_len":1480,"flow_quantum":1514},)"
+    R"({"threshold_rate":2500000,"sent_bytes":0,"backlog_bytes":0,"target_us":5000,)"
+    R"("interval_us":100000,"peak_delay_us":0,"avg_delay_us":0,"base_delay_us":0,)"
+    R"("sent_packets":0,"way_indirect_hits":0,"way_misses":0,"way_collisions":0,)"
+    R"("drops":0,"ecn_mark":0,"ack_drops":0,"sparse_flows":0,"bulk_flows":0,)"
+    R"("unresponsive_flows":0,"max_pkt_len":0,"flow_quantum":1514},)"
+    R"({"threshold_rate":1250000,"sent_bytes":85424,"backlog_bytes":0,"target_us":5000,)"
+    R"("interval_us":100000,"peak_delay_us":240,"avg_delay_us":61,"base_delay_us":14,)"
+    R"("sent_packets":322,"way_indirect_hits":0,"way_misses":1,"way_collisions":0,)"
+    R"("drops":0,"ecn_mark":0,"ack_drops":0,"sparse_flows":1,"bulk_flows":0,)"
+    R"("unresponsive_flows":0,"max_pkt_len":296,"flow_quantum":1514}]}])";
+
+/// cake bandwidth unlimited besteffort overhead 80.
+const char kCakeBesteffort[] =
+    R"([{"kind":"cake","handle":"8002:","root":true,"refcnt":2,)"
+    R"("options":{"bandwidth":"unlimited","diffserv":"besteffort","flowmode":"triple-isolate",)"
+    R"("nat":false,"wash":false,"ingress":false,"ack-filter":"disabled","split_gso":true,)"
+    R"("rtt":100000,"raw":false,"overhead":80,"fwmark":"0"},)"
+    R"("bytes":912004,"packets":1530,"drops":0,"overlimits":0,"requeues":0,)"
+    R"("backlog":0,"qlen":0,"memory_used":24576,"memory_limit":4194304,)"
+    R"("capacity_estimate":0,"min_network_size":108,"max_network_size":1500,)"
+    R"("min_adj_size":188,"max_adj_size":1580,"avg_hdr_offset":0,"tins":[)"
+    R"({"threshold_rate":0,"sent_bytes":912004,"backlog_bytes":0,"target_us":5000,)"
+    R"("interval_us":100000,"peak_delay_us":88,"avg_delay_us":12,"base_delay_us":3,)"
+    R"("sent_packets":1530,"way_indirect_hits":0,"way_misses":4,"way_collisions":0,)"
+    R"("drops":0,"ecn_mark":0,"ack_drops":0,"sparse_flows":0,"bulk_flows":0,)"
+    R"("unresponsive_flows":0,"max_pkt_len":1500,"flow_quantum":1514}]}])";
+
+const char kFqCodel[] =
+    R"([{"kind":"fq_codel","handle":"0:","root":true,"refcnt":2,)"
+    R"("options":{"limit":10240,"flows":1024,"quantum":1514,"target":4999,"interval":99999,)"
+    R"("memory_limit":33554432,"ecn":true,"drop_batch":64},)"
+    R"("bytes":7340210,"packets":5012,"drops":6,"overlimits":0,"requeues":0,)"
+    R"("backlog":1480,"qlen":1,"maxpacket":1480,"drop_overlimit":0,)"
+    R"("new_flow_count":38,"ecn_mark":3,"new_flows_len":0,"old_flows_len":1}])";
+
+/// What a fresh wg interface has before anything is installed.
+const char kNoqueue[] =
+    R"([{"kind":"noqueue","handle":"0:","root":true,"refcnt":2,"options":{},)"
+    R"("bytes":0,"packets":0,"drops":0,"overlimits":0,"requeues":0,"backlog":0,"qlen":0}])";
+
+} // namespace
+
+class TestQueueShaper : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fromConfig_data();
+    void fromConfig();
+    void offOrUnset();
+    void tcArguments_data();
+    void tcArguments();
+    void unshapedUntilBloat();
+    void aimd();
+    void counterReset();
+    void parseCakeDiffserv4();
+    void parseCakeBesteffort();
+    void parseFqCodel();
+    void parseNotOurs();
+};
+
+void TestQueueShaper::fromConfig_data()
+{
+    QTest::addColumn<QString>("options");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<int>("discipline");
+    QTest::addColumn<bool>("adaptive");
+    QTest::addColumn<qint64>("rate");
+
+    QTest::newRow("fq_codel")        << "QueueDiscipline = fq_codel" << true << int(QueueShaper::FqCodel) << false << qint64(0);
+    QTest::newRow("fq_codel + rate") << "QueueDiscipline = fq_codel\nShapeRate = 40mbit" << false << 0 << false << qint64(0);
+    QTest::newRow("fq_codel + auto") << "QueueDiscipline = fq_codel\nShapeRate = auto" << false << 0 << false << qint64(0);
+    QTest::newRow("fq_codel + dscp") << "QueueDiscipline = fq_codel\nDscpClassify = yes" << false << 0 << false << qint64(0);
+    QTest::newRow("fq_codel, dscp no") << "QueueDiscipline = fq_codel\nDscpClassify = no" << true << int(QueueShaper::FqCodel) << false << qint64(0);
+    QTest::newRow("unknown")         << "QueueDiscipline = pfifo" << false << 0 << false << qint64(0);
+    QTest::newRow("cake")            << "QueueDiscipline = cake" << true << int(QueueShaper::Cake) << false << qint64(0);
+    QTest::newRow("cake, case")      << "QueueDiscipline = CAKE\nShapeRate = 40 Mbit" << true << int(QueueShaper::Cake) << false << qint64(5000000);
+    QTest::newRow("cake auto")       << "QueueDiscipline = cake\nShapeRate = auto" << true << int(QueueShaper::Cake) << true << qint64(0);
+    QTest::newRow("cake rate off")   << "QueueDiscipline = cake\nShapeRate = off" << true << int(QueueShaper::Cake) << false << qint64(0);
+    QTest::newRow("fractional")      << "QueueDiscipline = cake\nShapeRate = 1.5gbit" << true << int(QueueShaper::Cake) << false << qint64(187500000);
+    QTest::newRow("at the floor")    << "QueueDiscipline = cake\nShapeRate = 1mbit" << true << int(QueueShaper::Cake) << false << qint64(QueueShaper::kMinRate);
+    QTest::newRow("below the floor") << "QueueDiscipline = cake\nShapeRate = 999kbit" << false << 0 << false << qint64(0);
+    QTest::newRow("bits")            << "QueueDiscipline = cake\nShapeRate = 8000000bit" << true << int(QueueShaper::Cake) << false << qint64(1000000);
+    QTest::newRow("no unit")         << "QueueDiscipline = cake\nShapeRate = 40" << false << 0 << false << qint64(0);
+    QTest::newRow("bytes")           << "QueueDiscipline = cake\nShapeRate = 5mbps" << false << 0 << false << qint64(0);
+    QTest::newRow("garbage")         << "QueueDiscipline = cake\nShapeRate = fast" << false << 0 << false << qint64(0);
+}
+
+void TestQueueShaper::fromConfig()
+{
+    QFETCH(QString, options);
+    QFETCH(bool, valid);
+
+    QString error;
+    const auto s = QueueShaper::fromConfig("dkt-us", withOptions(options), &error);
+    QCOMPARE(bool(s), valid);
+    QCOMPARE(error.isEmpty(), valid);
+    if (!valid)
+        return;
+    QTEST(int(s->discipline()), "discipline");
+    QTEST(s->isAdaptive(), "adaptive");
+    QTEST(qint64(s->rate()), "rate");
+}
+
+void TestQueueShaper::offOrUnset()
+{
+    // No shaper and no error: the kernel's default qdisc stays.
+    for (const char *options : { "", "QueueDiscipline = off", "QueueDiscipline =" }) {
+        QString error;
+        QVERIFY(!QueueShaper::fromConfig("dkt-us", withOptions(options), &error));
+        QVERIFY2(error.isEmpty(), options);
+    }
+}
+
+void TestQueueShaper::tcArguments_data()
+{
+    QTest::addColumn<QString>("options");
+    QTest::addColumn<QString>("endpoint");
+    QTest::addColumn<QString>("install");
+    QTest::addColumn<QString>("change");
+    QTest::addColumn<QString>("postUp");
+
+    QTest::newRow("fq_codel")
+        << "QueueDiscipline = fq_codel" << "192.0.2.1:51820"
+        << "qdisc replace dev dkt-us root fq_codel"
+        << "qdisc change dev dkt-us root fq_codel"
+        << "tc qdisc replace dev %i root fq_codel || true";
+    QTest::newRow("cake diffserv4, shaped")
+        << "QueueDiscipline = cake\nShapeRate = 40mbit\nDscpClassify = true" << "192.0.2.1:51820"
+        << "qdisc replace dev dkt-us root cake bandwidth 40000000bit diffserv4 overhead 60"
+        << "qdisc change dev dkt-us root cake bandwidth 40000000bit"
+        << "tc qdisc replace dev %i root cake bandwidth 40000000bit diffserv4 overhead 60 || true";
+    QTest::newRow("cake besteffort, unshaped, IPv6 endpoint")
+        << "QueueDiscipline = cake" << "[2001:db8::1]:51820"
+        << "qdisc replace dev dkt-us root cake bandwidth unlimited besteffort overhead 80"
+        << "qdisc change dev dkt-us root cake bandwidth unlimited"
+        << "tc qdisc replace dev %i root cake bandwidth unlimited besteffort overhead 80 || true";
+    QTest::newRow("cake auto starts unlimited")
+        << "QueueDiscipline = cake\nShapeRate = auto\nDscpClassify = off" << "vpn.example.com:51820"
+        << "qdisc replace dev dkt-us root cake bandwidth unlimited besteffort overhead 60"
+        << "qdisc change dev dkt-us root cake bandwidth unlimited"
+        << "tc qdisc replace dev %i root cake bandwidth unlimited besteffort overhead 60 || true";
+}
+
+void TestQueueShaper::tcArguments()
+{
+    QFETCH(QString, options);
+    QFETCH(QString, endpoint);
+
+    const auto s = shaper(options, endpoint);
+    QVERIFY(s);
+    QTEST(s->installArguments().join(' '), "install");
+    QTEST(s->rateArguments().join(' '), "change");
+    QTEST(s->postUpCommand(), "postUp");
+}
+
+void TestQueueShaper::unshapedUntilBloat()
+{
+    const auto s = shaper("QueueDiscipline = cake\nShapeRate = auto");
+    QVERIFY(s);
+
+    // Without RTT samples (no probe responder) nothing moves.
+    QVERIFY(!s->updateSample(0, 1000));
+    QVERIFY(!s->updateSample(5000000, 2000));
+    QCOMPARE(s->rate(), quint64(0));
+
+    // Saturated but the RTT stays at its baseline: no queue, stay unshaped.
+    s->setRtt(20);
+    QVERIFY(!s->updateSample(10000000, 3000));
+    QCOMPARE(s->rate(), quint64(0));
+
+    // The RTT rises more than kBloatMs: 90 % of the 5 MB/s that got through.
+    s->setRtt(20 + QueueShaper::kBloatMs + 5);
+    QVERIFY(s->updateSample(15000000, 4000));
+    QCOMPARE(s->rate(), quint64(4500000));
+    QCOMPARE(s->rateArguments().join(' '),
+             QStringLiteral("qdisc change dev dkt-us root cake bandwidth 36000000bit"));
+
+    // A fixed rate is never adapted.
+    const auto fixed = shaper("QueueDiscipline = cake\nShapeRate = 40mbit");
+    QVERIFY(fixed);
+    fixed->setRtt(20);
+    QVERIFY(!fixed->updateSample(0, 1000));
+    fixed->setRtt(60);
+    QVERIFY(!fixed->updateSample(5000000, 2000));
+    QCOMPARE(fixed->rate(), quint64(5000000));
+}
+
+void TestQueueShaper::aimd()
+{
+    const auto s = shaper("QueueDiscipline = cake\nShapeRate = auto");
+    QVERIFY(s);
+    quint64 tx = 0;
+    qint64  now = 1000;
+    // One second at @p bytesPerSecond.
+    const auto sample = [&](quint64 bytesPerSecond) {
+        tx += bytesPerSecond;
+        now += 1000;
+        return s->updateSample(tx, now);
+    };
+
+    s->setRtt(20);
+    QVERIFY(!s->updateSample(tx, now));
+    s->setRtt(40);
+    QVERIFY(sample(5000000));
+    QCOMPARE(s->rate(), quint64(4500000));
+
+    // Clean and saturated: one kRateStep per sample. The first step is
+    // under 5 % of the applied 4.5 MB/s, so it only accumulates.
+    s->setRtt(20);
+    QVERIFY(!sample(4000000));
+    QCOMPARE(s->rate(), quint64(4500000) + QueueShaper::kRateStep);
+    QVERIFY(sample(4000000));
+    QCOMPARE(s->rate(), quint64(4500000) + 2 * QueueShaper::kRateStep);
+
+    // Clean but not saturated (under 80 % of the rate): nothing to learn.
+    QVERIFY(!sample(1000000));
+    QCOMPARE(s->rate(), quint64(4750000));
+
+    // Bloated again: ×0.9 of what got through, not of the old rate.
+    s->setRtt(40);
+    QVERIFY(sample(4000000));
+    QCOMPARE(s->rate(), quint64(3600000));
+
+    // Bloated while the link is nearly idle: the queue is not ours.
+    QVERIFY(!sample(500000));
+    QCOMPARE(s->rate(), quint64(3600000));
+}
+
+void TestQueueShaper::counterReset()
+{
+    const auto s = shaper("QueueDiscipline = cake\nShapeRate = auto");
+    QVERIFY(s);
+    s->setRtt(20);
+    QVERIFY(!s->updateSample(50000000, 1000));
+    s->setRtt(40);
+    QVERIFY(s->updateSample(55000000, 2000));
+    QCOMPARE(s->rate(), quint64(4500000));
+
+    // The interface was recreated and its counter starts over. That sample
+    // only sets a new starting point; it is not read as a huge rate.
+    QVERIFY(!s->updateSample(1000, 3000));
+    QCOMPARE(s->rate(), quint64(4500000));
+
+    QVERIFY(s->updateSample(1000 + 4000000, 4000));
+    QCOMPARE(s->rate(), quint64(3600000));
+}
+
+void TestQueueShaper::parseCakeDiffserv4()
+{
+    QueueStats stats;
+    QVERIFY(QueueShaper::parseStats("dkt-us", kCakeDiffserv4, &stats));
+    QCOMPARE(stats.tunnel, QStringLiteral("dkt-us"));
+    QCOMPARE(stats.kind, QStringLiteral("cake"));
+    QCOMPARE(stats.shapeRate, quint64(5000000));
+    QVERIFY(stats.sampledAtMs > 0);
+    QCOMPARE(stats.classes.size(), 4);
+
+    const QStringList names = { "bulk", "best_effort", "video", "voice" };
+    for (int i = 0; i < 4; ++i)
+        QCOMPARE(stats.classes.at(i).name, names.at(i));
+
+    const QueueClassStats &be = stats.classes.at(1);
+    QCOMPARE(be.sentBytes, quint64(48126210));
+    QCOMPARE(be.sentPackets, quint64(32780));
+    QCOMPARE(be.drops, quint64(41));
+    QCOMPARE(be.ecnMarks, quint64(17));
+    QCOMPARE(be.backlogBytes, quint64(4542));
+    QCOMPARE(be.avgDelayUs, quint64(4321));
+    QCOMPARE(be.peakDelayUs, quint64(9876));
+
+    const QueueClassStats &voice = stats.classes.at(3);
+    QCOMPARE(voice.sentBytes, quint64(85424));
+    QCOMPARE(voice.sentPackets, quint64(322));
+    QCOMPARE(voice.avgDelayUs, quint64(61));
+    QCOMPARE(stats.classes.at(0).sentBytes, quint64(0));
+}
+
+void TestQueueShaper::parseCakeBesteffort()
+{
+    QueueStats stats;
+    QVERIFY(QueueShaper::parseStats("dkt-us", kCakeBesteffort, &stats));
+    QCOMPARE(stats.kind, QStringLiteral("cake"));
+    QCOMPARE(stats.shapeRate, quint64(0)); // "unlimited"
+    QCOMPARE(stats.classes.size(), 1);
+    const QueueClassStats &c = stats.classes.first();
+    QCOMPARE(c.name, QStringLiteral("best_effort"));
+    QCOMPARE(c.sentBytes, quint64(912004));
+    QCOMPARE(c.sentPackets, quint64(1530));
+    QCOMPARE(c.peakDelayUs, quint64(88));
+}
+
+void TestQueueShaper::parseFqCodel()
+{
+    QueueStats stats;
+    QVERIFY(QueueShaper::parseStats("dkt-us", kFqCodel, &stats));
+    QCOMPARE(stats.kind, QStringLiteral("fq_codel"));
+    QCOMPARE(stats.shapeRate, quint64(0));
+    QCOMPARE(stats.classes.size(), 1);
+    const QueueClassStats &c = stats.classes.first();
+    QCOMPARE(c.name, QStringLiteral("best_effort"));
+    QCOMPARE(c.sentBytes, quint64(7340210));
+    QCOMPARE(c.sentPackets, quint64(5012));
+    QCOMPARE(c.drops, quint64(6));
+    QCOMPARE(c.ecnMarks, quint64(3));
+    QCOMPARE(c.backlogBytes, quint64(1480));
+    QCOMPARE(c.avgDelayUs, quint64(0));
+
+    // Stale classes from an earlier sample do not survive.
+    QVERIFY(QueueShaper::parseStats("dkt-us", kCakeDiffserv4, &stats));
+    QVERIFY(QueueShaper::parseStats("dkt-us", kFqCodel, &stats));
+    QCOMPARE(stats.classes.size(), 1);
+}
+
+void TestQueueShaper::parseNotOurs()
+{
+    QueueStats stats;
+    QVERIFY(!QueueShaper::parseStats("dkt-us", kNoqueue, &stats));
+    QCOMPARE(stats.kind, QStringLiteral("noqueue"));
+    QVERIFY(stats.classes.isEmpty());
+    QVERIFY(!QueueShaper::parseStats("dkt-us", "[]", &stats));
+    QVERIFY(!QueueShaper::parseStats("dkt-us", "Cannot find device \"dkt-us\"\n", &stats));
+}
+
+QTEST_MAIN(TestQueueShaper)
+#include "tst_queueshaper.moc"
@@ -0,0 +1,194 @@
+#include <QElapsedTimer>
+#include <QImage>
+#include <QtTest>
+#include <cmath>
+
+#include "throughputchart.h"
+
+namespace {
+
+constexpr qint64 kStartMs = 1'700'000'000'000;
+constexpr qint64 kMinute  = 60 * 1000;
+constexpr qint64 kHour    = 60 * kMinute;
+
+/// Feeds @p samples traffic samples @p intervalMs apart, a slow wave
+/// between 0 and 2 MB/s. @p t and @p rx end at the last sample's values.
+void feed(ThroughputChart &chart, int samples, qint64 intervalMs, qint64 &t, quint64 &rx)
+{
+    t = kStartMs;
+    rx = 0;
+    chart.addTrafficSample(t, rx, rx / 4);
+    for (int i = 1; i < samples; ++i) {
+        const double rate = 1e6 * (1 + std::sin(i / 50.0));
+        t += intervalMs;
+        rx += quint64(rate * double(intervalMs) / 1000);
+        chart.addTrafficSample(t, rx, rx / 4);
+    }
+}
+
+/// One display update: a new sample at 1 MB/s, then a full repaint.
+void frame(ThroughputChart &chart, QImage &image, qint64 intervalMs, qint64 &t, quint64 &rx)
+{
+    t += intervalMs;
+    rx += 1000 * quint64(intervalMs);
+    chart.addTrafficSample(t, rx, rx / 4);
+    chart.render(&image);
+}
+
+} // namespace
+
+class TestThroughputChart : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void levelForPicksFinestCoveringLevel();
+    void levelForSkipsTruncatedLevels();
+    void collectIncludesPendingTail();
+    void spikeSurvivesDownsampling();
+    void frameCostDoesNotGrowWithHistory();
+    void benchmarkFrame_data();
+    void benchmarkFrame();
+};
+
+void TestThroughputChart::levelForPicksFinestCoveringLevel()
+{
+    // 100 points: level 1 holds 25 means, level 2 six plus a pending one,
+    // level 3 one plus a pending one.
+    ChartSeries series;
+    for (int i = 0; i < 100; ++i)
+        series.append(i * 1000, i);
+    QCOMPARE(series.levelFor(0, 1000), 0);
+    QCOMPARE(series.levelFor(0, 100), 0);
+    QCOMPARE(series.levelFor(0, 99), 1);
+    QCOMPARE(series.levelFor(0, 25), 1);
+    QCOMPARE(series.levelFor(0, 7), 2);
+    QCOMPARE(series.levelFor(0, 1), ChartSeries::kLevels - 1); // nothing fits: coarsest
+    // A later start needs fewer points.
+    QCOMPARE(series.levelFor(90 * 1000, 10), 0);
+}
+
+void TestThroughputChart::levelForSkipsTruncatedLevels()
+{
+    // Level 0 has dropped its first 100 points, so it can no longer serve
+    // a window that starts at 0 however many points are allowed.
+    ChartSeries series;
+    for (int i = 0; i < ChartSeries::kLevelCapacity + 100; ++i)
+        series.append(i * 1000, 1);
+    QCOMPARE(series.levelFor(0, 1 << 20), 1);
+    QCOMPARE(series.levelFor(200 * 1000, 1 << 20), 0);
+}
+
+void TestThroughputChart::collectIncludesPendingTail()
+{
+    ChartSeries series;
+    for (int i = 0; i < 10; ++i)
+        series.append(i * 1000, i);
+
+    QList<ChartSeries::Point> points;
+    series.collect(1, 0, points);
+    QCOMPARE(points.size(), 3);
+    QCOMPARE(points[0].t, qint64(1500));
+    QCOMPARE(points[0].v, 1.5);
+    QCOMPARE(points[1].t, qint64(5500));
+    QCOMPARE(points[1].v, 5.5);
+    QCOMPARE(points[2].t, qint64(8500)); // mean of the two points not yet aggregated
+    QCOMPARE(points[2].v, 8.5);
+
+    points.clear();
+    series.collect(1, 5000, points);
+    QCOMPARE(points.size(), 2);
+    QCOMPARE(points[0].t, qint64(5500));
+
+    points.clear();
+    series.collect(0, 7000, points);
+    QCOMPARE(points.size(), 3);
+    QCOMPARE(points.first().v, 7.0);
+}
+
+void TestThroughputChart::spikeSurvivesDownsampling()
+{
+    // 2400 raw samples in a 10 min window, two or three per bucket. One
+    // sample is a 10 000x spike; a mean would flatten it, LTTB keeps it.
+    ThroughputChart chart;
+    chart.resize(1000, 110);
+    chart.setTimeSpan(10 * kMinute);
+    quint64 rx = 0;
+    qint64 t = kStartMs;
+    chart.addTrafficSample(t, 0, 0);
+    for (int i = 1; i <= 2400; ++i) {
+        t += 250;
+        rx += i == 1200 ? 250000 : 25; // 1 MB/s once, 100 B/s otherwise
+        chart.addTrafficSample(t, rx, 0);
+    }
+
+    const QList<ThroughputChart::Bucket> &buckets = chart.m_rx.buckets;
+    QVERIFY(buckets.size() < 2400 / 2); // one per pixel column, not per sample
+    int spikes = 0;
+    for (const ThroughputChart::Bucket &b : buckets) {
+        QVERIFY2(b.pick.y() == 100 || b.pick.y() == 1e6,
+                 qPrintable(QString("pick %1 is not a sample").arg(b.pick.y())));
+        spikes += b.pick.y() == 1e6;
+    }
+    QCOMPARE(spikes, 1);
+}
+
+void TestThroughputChart::frameCostDoesNotGrowWithHistory()
+{
+    // Same 24 h window, 1 000 and 1 000 000 samples behind it.
+    const auto frameMs = [](int samples) {
+        ThroughputChart chart;
+        chart.resize(600, 110);
+        chart.setTimeSpan(24 * kHour);
+        const qint64 interval = std::max<qint64>(1, 24 * kHour / samples);
+        qint64 t;
+        quint64 rx;
+        feed(chart, samples, interval, t, rx);
+        QImage image(chart.size(), QImage::Format_ARGB32_Premultiplied);
+        frame(chart, image, interval, t, rx); // background, first rebuild
+        QElapsedTimer clock;
+        clock.start();
+        for (int i = 0; i < 200; ++i)
+            frame(chart, image, interval, t, rx);
+        return clock.nsecsElapsed() / 1e6 / 200;
+    };
+    const double small = frameMs(1000);
+    const double large = frameMs(1000000);
+    qInfo("frame with 1k samples %.3f ms, with 1M samples %.3f ms", small, large);
+    QVERIFY(large < 3 * small + 0.5);
+}
+
+void TestThroughputChart::benchmarkFrame_data()
+{
+    QTest::addColumn<int>("samples");
+    QTest::addColumn<qint64>("span");
+
+    for (int samples : { 1000, 100000, 1000000 }) {
+        for (qint64 span : { kMinute, kHour, 24 * kHour })
+            QTest::addRow("%d samples, %lld min", samples, span / kMinute) << samples << span;
+    }
+}
+
+void TestThroughputChart::benchmarkFrame()
+{
+    // Samples are spread over the span where they fit, 1 ms apart otherwise.
+    QFETCH(int, samples);
+    QFETCH(qint64, span);
+    ThroughputChart chart;
+    chart.resize(600, 110);
+    chart.setTimeSpan(span);
+    const qint64 interval = std::max<qint64>(1, span / samples);
+    qint64 t;
+    quint64 rx;
+    feed(chart, samples, interval, t, rx);
+    chart.addLatencySample(t, 20);
+    QImage image(chart.size(), QImage::Format_ARGB32_Premultiplied);
+    frame(chart, image, interval, t, rx);
+
+    QBENCHMARK {
+        frame(chart, image, interval, t, rx);
+    }
+}
+
+QTEST_MAIN(TestThroughputChart)
+#include "tst_throughputchart.moc"
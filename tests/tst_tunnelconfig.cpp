@@ -0,0 +1,166 @@
+#include <QtTest>
+
+#include "tunnelconfig.h"
+
+namespace {
+
+const char kBase[] =
+    "[Interface]\n"
+    "PrivateKey = cHJpdmF0ZQ==\n"
+    "Address = 10.8.0.2/24\n"
+    "ListenPort = 51820\n"
+    "\n"
+    "[Peer]\n"
+    "PublicKey = cGVlckE=\n"
+    "Endpoint = 192.0.2.1:51820\n"
+    "AllowedIPs = 10.8.0.0/24, 10.9.0.0/16\n"
+    "\n"
+    "[Peer]\n"
+    "PublicKey = cGVlckI=\n"
+    "Endpoint = 192.0.2.2:51820\n"
+    "AllowedIPs = 10.10.0.0/16\n";
+
+/// kBase with every occurrence of @p from replaced by @p to.
+TunnelConfig edited(const QString &from, const QString &to)
+{
+    QString text = QString::fromLatin1(kBase);
+    text.replace(from, to);
+    return TunnelConfig::parse(text);
+}
+
+} // namespace
+
+class TestTunnelConfig : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sameConfigIsEmpty();
+    void peersByPublicKey();
+    void routeDelta();
+    void routesFollowTableOff();
+    void interfaceKeys_data();
+    void interfaceKeys();
+    void fwMarkWithDefaultRoute_data();
+    void fwMarkWithDefaultRoute();
+};
+
+void TestTunnelConfig::sameConfigIsEmpty()
+{
+    // Comments, spacing and key case are not changes.
+    const TunnelConfig a = TunnelConfig::parse(kBase);
+    QString text = QString::fromLatin1(kBase);
+    text.replace("ListenPort = 51820", "listenport=51820   # fixed");
+    const TunnelConfig::Diff d = TunnelConfig::diff(a, TunnelConfig::parse(text));
+    QVERIFY(d.isEmpty());
+    QVERIFY(d.isLive());
+}
+
+void TestTunnelConfig::peersByPublicKey()
+{
+    // Peer A moves, peer B is swapped for C.
+    QString text = QString::fromLatin1(kBase);
+    text.replace("192.0.2.1:51820", "192.0.2.9:51820").replace("cGVlckI=", "cGVlckM=");
+
+    const TunnelConfig::Diff d = TunnelConfig::diff(TunnelConfig::parse(kBase),
+                                                    TunnelConfig::parse(text));
+    QCOMPARE(d.peersUpdated, QStringList { "cGVlckE=" });
+    QCOMPARE(d.peersAdded,   QStringList { "cGVlckM=" });
+    QCOMPARE(d.peersRemoved, QStringList { "cGVlckI=" });
+    QVERIFY(d.interfaceKeys.isEmpty());
+    QVERIFY(d.routesAdded.isEmpty() && d.routesRemoved.isEmpty());
+    QVERIFY(d.isLive());
+}
+
+void TestTunnelConfig::routeDelta()
+{
+    const TunnelConfig::Diff d = TunnelConfig::diff(
+        TunnelConfig::parse(kBase), edited("10.8.0.0/24, 10.9.0.0/16", "10.8.0.0/24, 10.11.0.1"));
+    QCOMPARE(d.routesAdded,   QStringList { "10.11.0.1/32" });
+    QCOMPARE(d.routesRemoved, QStringList { "10.9.0.0/16" });
+    QCOMPARE(d.peersUpdated,  QStringList { "cGVlckE=" });
+    QVERIFY(!d.defaultRouteChanged);
+    QVERIFY(d.isLive());
+
+    // A /0 is never a plain route: wg-quick sets up policy routing for it.
+    const TunnelConfig::Diff full = TunnelConfig::diff(
+        TunnelConfig::parse(kBase), edited("10.10.0.0/16", "10.10.0.0/16, 0.0.0.0/0"));
+    QVERIFY(full.routesAdded.isEmpty());
+    QVERIFY(full.defaultRouteChanged);
+    QVERIFY(full.defaultRouted);
+    QVERIFY(!full.isLive());
+}
+
+void TestTunnelConfig::routesFollowTableOff()
+{
+    // With Table = off wg-quick adds no routes, so there is no delta either.
+    const TunnelConfig a = edited("ListenPort = 51820", "ListenPort = 51820\nTable = off");
+    const TunnelConfig b = TunnelConfig::parse(
+        a.toString().replace("10.10.0.0/16", "10.12.0.0/16, ::/0"));
+    const TunnelConfig::Diff d = TunnelConfig::diff(a, b);
+    QCOMPARE(d.peersUpdated, QStringList { "cGVlckI=" });
+    QVERIFY(d.routesAdded.isEmpty() && d.routesRemoved.isEmpty());
+    QVERIFY(!d.defaultRouteChanged);
+    QVERIFY(!d.defaultRouted);
+    QVERIFY(d.isLive());
+}
+
+void TestTunnelConfig::interfaceKeys_data()
+{
+    QTest::addColumn<QString>("from");
+    QTest::addColumn<QString>("to");
+    QTest::addColumn<QString>("key");
+    QTest::addColumn<bool>("live");
+
+    QTest::newRow("ListenPort") << "ListenPort = 51820" << "ListenPort = 51821" << "listenport" << true;
+    QTest::newRow("PrivateKey") << "cHJpdmF0ZQ==" << "b3RoZXI=" << "privatekey" << true;
+    QTest::newRow("Address")    << "10.8.0.2/24" << "10.8.0.3/24" << "address" << false;
+    QTest::newRow("MTU added")  << "ListenPort = 51820" << "ListenPort = 51820\nMTU = 1380"
+                                << "mtu" << false;
+    QTest::newRow("DNS added")  << "ListenPort = 51820" << "ListenPort = 51820\nDNS = 10.8.0.1"
+                                << "dns" << false;
+}
+
+void TestTunnelConfig::interfaceKeys()
+{
+    QFETCH(QString, from);
+    QFETCH(QString, to);
+    QFETCH(QString, key);
+    QFETCH(bool, live);
+
+    const TunnelConfig::Diff d = TunnelConfig::diff(TunnelConfig::parse(kBase), edited(from, to));
+    QCOMPARE(d.interfaceKeys, QStringList { key });
+    QVERIFY(d.peersAdded.isEmpty() && d.peersRemoved.isEmpty() && d.peersUpdated.isEmpty());
+    QCOMPARE(d.isLive(), live);
+}
+
+void TestTunnelConfig::fwMarkWithDefaultRoute_data()
+{
+    QTest::addColumn<QString>("allowed");
+    QTest::addColumn<bool>("live");
+
+    QTest::newRow("no /0") << "10.10.0.0/16" << true;
+    QTest::newRow("v4 /0") << "0.0.0.0/0" << false;
+    QTest::newRow("v6 /0") << "10.10.0.0/16, ::/0" << false;
+}
+
+void TestTunnelConfig::fwMarkWithDefaultRoute()
+{
+    // With a /0 routed, wg-quick's "not fwmark <old>" rule stays behind when
+    // `wg syncconf` sets a new mark; only recreating the interface fixes it.
+    QFETCH(QString, allowed);
+    QFETCH(bool, live);
+
+    QString text = QString::fromLatin1(kBase).replace("10.10.0.0/16", allowed);
+    const TunnelConfig a = TunnelConfig::parse(QString(text).replace("ListenPort = 51820",
+                                                                     "FwMark = 0x1234"));
+    const TunnelConfig b = TunnelConfig::parse(QString(text).replace("ListenPort = 51820",
+                                                                     "FwMark = 0x4321"));
+    const TunnelConfig::Diff d = TunnelConfig::diff(a, b);
+    QCOMPARE(d.interfaceKeys, QStringList { "fwmark" });
+    QVERIFY(!d.defaultRouteChanged);
+    QCOMPARE(d.isLive(), live);
+}
+
+QTEST_GUILESS_MAIN(TestTunnelConfig)
+#include "tst_tunnelconfig.moc"